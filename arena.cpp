@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <new>
+#include "arena.h"
+
+/* Start a chunk big enough for size bytes at align, twice the size of
+ * the last so that a tree of any size takes few of them */
+void *Arena::grow(size_t size, size_t align)
+{
+    size_t chunk_size = m_chunks ? m_chunks->size * 2 : FIRST_CHUNK_SIZE;
+    while (chunk_size < sizeof(Chunk) + size + align)
+        chunk_size *= 2;
+    Chunk *chunk = (Chunk *)malloc(chunk_size);
+    if (chunk == nullptr)
+        throw std::bad_alloc();
+    chunk->next = m_chunks;
+    chunk->size = chunk_size;
+    m_chunks = chunk;
+    m_reserved += chunk_size;
+    m_chunk_count++;
+
+    m_next = (char *)(chunk + 1);
+    m_end = (char *)chunk + chunk_size;
+    return allocate(size, align);
+}
+
+void Arena::reset()
+{
+    if (m_chunks == nullptr)
+        return;
+    Chunk *chunk = m_chunks->next;
+    while (chunk) {
+        Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    m_chunks->next = nullptr;
+    m_next = (char *)(m_chunks + 1);
+    m_end = (char *)m_chunks + m_chunks->size;
+    m_used = 0;
+    m_allocations = 0;
+    m_reserved = m_chunks->size;
+    m_chunk_count = 1;
+}
+
+Arena::~Arena()
+{
+    reset();
+    free(m_chunks);
+}
@@ -0,0 +1,148 @@
+/***********************************************************************
+ * arena.h
+ *
+ * Bump allocator for the AST of one compile. The nodes, their types and
+ * the lists of their children are carved one after another out of a few
+ * large chunks, in the order the parser builds them, so a tree costs a
+ * handful of calls to malloc and lies close together for the passes
+ * that walk it.
+ *
+ * Nothing in an arena is freed on its own. The whole tree goes at once
+ * with reset, or with the arena, without a node being visited; so what
+ * is placed in an arena must not own memory outside it. Nodes hold
+ * views and NodeLists rather than strings and vectors for that reason.
+ **********************************************************************/
+
+#ifndef ARENA_H_
+#define ARENA_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+#include <type_traits>
+
+class Arena
+{
+  private:
+    struct Chunk
+    {
+        Chunk *next;    /* The chunk before, an arena grows at the front */
+        size_t size;    /* Including this header */
+    };
+
+    Chunk *m_chunks = nullptr;
+    char *m_next = nullptr;    /* Free space of the newest chunk */
+    char *m_end = nullptr;
+    size_t m_used = 0;         /* Bytes handed out since the last reset */
+    size_t m_allocations = 0;  /* And the number of pieces they went in */
+    size_t m_reserved = 0;     /* Bytes of the chunks */
+    long m_chunk_count = 0;
+
+    void *grow(size_t size, size_t align);
+
+  public:
+    static const size_t FIRST_CHUNK_SIZE = 16 * 1024;
+
+    Arena() {}
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /* size bytes aligned to align, a power of two */
+    void *allocate(size_t size, size_t align = alignof(void *)) {
+        uintptr_t begin = ((uintptr_t)m_next + align - 1) & ~(uintptr_t)(align - 1);
+        if (begin + size > (uintptr_t)m_end || m_next == nullptr)
+            return grow(size, align);
+        m_next = (char *)(begin + size);
+        m_used += size;
+        m_allocations++;
+        return (void *)begin;
+    }
+
+    /* A copy of text that lives as long as the arena's contents */
+    std::string_view copy(std::string_view text) {
+        if (text.empty())
+            return std::string_view();
+        char *copy = (char *)allocate(text.size(), 1);
+        memcpy(copy, text.data(), text.size());
+        return std::string_view(copy, text.size());
+    }
+
+    /* Release everything allocated. The newest chunk, which is the
+     * largest, is kept for what comes next; the cost is one free per
+     * other chunk, however much was allocated. */
+    void reset();
+
+    size_t get_used() const {return m_used;}
+    /* At least the number of nodes in the arena */
+    size_t get_allocation_count() const {return m_allocations;}
+    size_t get_reserved() const {return m_reserved;}
+    long get_chunk_count() const {return m_chunk_count;}
+};
+
+/***********************************************************************
+ * A growing list kept in an arena, for the children of a node. Only
+ * items that need no destructor can be held, and the storage the list
+ * outgrows stays in the arena until it is reset, so a list is best
+ * built by appending.
+ **********************************************************************/
+template <class T>
+class NodeList
+{
+    static_assert(std::is_trivially_destructible<T>::value, "a NodeList is never destroyed");
+
+  private:
+    Arena *m_arena;
+    T *m_items = nullptr;
+    uint32_t m_size = 0;
+    uint32_t m_capacity = 0;
+
+    void make_room(size_t count) {
+        if (m_size + count <= m_capacity)
+            return;
+        size_t capacity = m_capacity ? m_capacity * 2 : 4;
+        while (capacity < m_size + count)
+            capacity *= 2;
+        T *items = (T *)m_arena->allocate(capacity * sizeof(T), alignof(T));
+        if (m_size)
+            memcpy((void *)items, (const void *)m_items, m_size * sizeof(T));
+        m_items = items;
+        m_capacity = capacity;
+    }
+
+  public:
+    explicit NodeList(Arena *arena) : m_arena(arena) {}
+
+    size_t size() const {return m_size;}
+    bool empty() const {return m_size == 0;}
+    T *begin() const {return m_items;}
+    T *end() const {return m_items + m_size;}
+    T &operator[](size_t index) const {return m_items[index];}
+
+    void push_back(T item) {
+        make_room(1);
+        m_items[m_size++] = item;
+    }
+
+    /* Put count items in before the one at index */
+    void insert(size_t index, const T *items, size_t count) {
+        if (count == 0)
+            return;
+        make_room(count);
+        memmove((void *)(m_items + index + count), (const void *)(m_items + index), (m_size - index) * sizeof(T));
+        memcpy((void *)(m_items + index), (const void *)items, count * sizeof(T));
+        m_size += count;
+    }
+
+    /* Take out count items from index on */
+    void erase(size_t index, size_t count) {
+        if (count == 0)
+            return;
+        memmove((void *)(m_items + index), (const void *)(m_items + index + count),
+                (m_size - index - count) * sizeof(T));
+        m_size -= count;
+    }
+};
+
+#endif /* ARENA_H_ */
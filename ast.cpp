@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <string>
 #include <iostream>
+#include <type_traits>
 #include "ast.h"
 #include "common.h"
 #include "parser.tab.h"
@@ -32,9 +33,19 @@ std::string convert_op_to_string(int operator_type){
     return ret;
 }
 
-node *ast = NULL;
+/* An arena releases nodes without running a destructor */
+template <class... Nodes> struct ReleasedWithArena
+{
+    static const bool value = (std::is_trivially_destructible<Nodes>::value && ...);
+};
+static_assert(ReleasedWithArena<Scope, Declarations, Declaration, Type, Statements, AssignStatement, IfStatement,
+                                NestedScope, EmptyStatement, ConstructorExpression, FloatLiteralExpression,
+                                IntLiteralExpression, BoolLiteralExpression, Constructor, UnaryExpression,
+                                BinaryExpression, VariableExpression, FunctionExpression, Function, IdentifierNode,
+                                VectorVariable, Arguments>::value,
+              "an AST node owns memory outside its arena");
 
-node *ast_allocate(NodeKind type, ...)
+node *ast_allocate(Arena *arena, NodeKind type, ...)
 {
 
     va_list args;
@@ -46,7 +57,7 @@ node *ast_allocate(NodeKind type, ...)
 
     case SCOPE_NODE:
     {
-        Scope *scope = new Scope();
+        Scope *scope = new (arena) Scope();
         Declarations *d = va_arg(args, Declarations *);
         assert(d);
         scope->declarations = d;
@@ -55,6 +66,9 @@ node *ast_allocate(NodeKind type, ...)
         assert(statements);
         scope->statements = statements;
 
+        YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
+        scope->set_span(*rule_loc);
+
         ret_node = scope;
         break;
     }
@@ -64,7 +78,7 @@ node *ast_allocate(NodeKind type, ...)
         Declarations *declarations = va_arg(args, Declarations *);
         if (declarations == nullptr)
         {
-            declarations = new Declarations();
+            declarations = new (arena) Declarations(arena);
         }
         Declaration *declaration = va_arg(args, Declaration *);
         if (declaration != nullptr)
@@ -79,16 +93,16 @@ node *ast_allocate(NodeKind type, ...)
     case DECLARATION_NODE:
     {
         Type *type = va_arg(args, Type *);
-        string id(va_arg(args, char *));
+        const char *id_text = va_arg(args, const char *);
+        std::string_view id(id_text, va_arg(args, int));
+        SymbolId symbol = va_arg(args, SymbolId);
         Expression *expression = va_arg(args, Expression *);
         bool is_const = static_cast<bool>(va_arg(args, int));
 
-        Declaration *declaration = new Declaration(type, id, expression, is_const);
+        Declaration *declaration = new (arena) Declaration(type, id, symbol, expression, is_const);
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        declaration->set_node_location(rule_location);
+        declaration->set_span(*rule_loc);
 
         ret_node = declaration;
         break;
@@ -99,19 +113,11 @@ node *ast_allocate(NodeKind type, ...)
         int type_index = va_arg(args, int);
         int dimen_index = va_arg(args, int);
 
-        /* Here, we get the corresponding type from the given indices
-         * and create a Type node based off that */
-        string type_list[3][4] = {{"int", "ivec2", "ivec3", "ivec4"},
-                                  {"bool", "bvec2", "bvec3", "bvec4"},
-                                  {"float", "vec2", "vec3", "vec4"}};
-        if (type_index > 2 || dimen_index > 3)
-        {
-            assert(true && "Index for type, please check for bugs\n");
-        }
+        /* The indices are the base, int, bool or float, and the
+         * dimension, which goes from 1 to 4 */
+        assert(type_index <= 2 && dimen_index >= 1 && dimen_index <= 4);
 
-        string type = type_list[type_index][dimen_index - 1]; /* dim goes from 1 to 4 */
-
-        ret_node = new Type(type);
+        ret_node = new (arena) Type(TypeDesc((TypeDesc::Base)type_index, dimen_index));
         break;
     }
 
@@ -122,7 +128,7 @@ node *ast_allocate(NodeKind type, ...)
         Statements *statements = va_arg(args, Statements *);
         if (statements == nullptr)
         {
-            statements = new Statements();
+            statements = new (arena) Statements(arena);
         }
         Statement *statement = va_arg(args, Statement *);
 
@@ -137,15 +143,13 @@ node *ast_allocate(NodeKind type, ...)
 
     case IF_STATEMENT_NODE:
     {
-        IfStatement *if_statement = new IfStatement();
+        IfStatement *if_statement = new (arena) IfStatement();
         if_statement->expression = va_arg(args, Expression *);
         if_statement->statement = va_arg(args, Statement *);
         if_statement->else_statement = va_arg(args, Statement *);
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        if_statement->set_node_location(rule_location);
+        if_statement->set_span(*rule_loc);
 
         ret_node = if_statement;
         break;
@@ -153,14 +157,12 @@ node *ast_allocate(NodeKind type, ...)
 
     case ASSIGNMENT_NODE:
     {
-        AssignStatement *assign_statement = new AssignStatement();
+        AssignStatement *assign_statement = new (arena) AssignStatement();
         assign_statement->variable = va_arg(args, IdentifierNode *);
         assign_statement->expression = va_arg(args, Expression *);
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        assign_statement->set_node_location(rule_location);
+        assign_statement->set_span(*rule_loc);
 
         ret_node = assign_statement;
         break;
@@ -169,13 +171,16 @@ node *ast_allocate(NodeKind type, ...)
     case NESTED_SCOPE_NODE:
     {
         Scope *scope = va_arg(args, Scope*);
-        ret_node = new NestedScope(scope);
+        ret_node = new (arena) NestedScope(scope);
+        ret_node->set_span(scope->get_span());
         break;
     }
 
     case EMPTY_STATEMENT_NODE:
     {
-        ret_node = new EmptyStatement();
+        ret_node = new (arena) EmptyStatement();
+        YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -192,47 +197,45 @@ node *ast_allocate(NodeKind type, ...)
         case CONSTRUCTOR_EXPRESSION:
         {
             Constructor *ct = va_arg(args, Constructor *);
-            ret_node = new ConstructorExpression(ct);
+            ret_node = new (arena) ConstructorExpression(ct);
             break;
         }
         case FUNCTION:
         {
             Function *func = va_arg(args, Function *);
-            ret_node = new FunctionExpression(func);
+            ret_node = new (arena) FunctionExpression(func);
             break;
         }
         case VARIABLE:
         {
             IdentifierNode *id_node = va_arg(args, IdentifierNode*);
-            ret_node = new VariableExpression(id_node);
+            ret_node = new (arena) VariableExpression(id_node);
             break;
         }
 
         case BOOL_EXPRESSION:
         {
             bool bool_literal = static_cast<bool>(va_arg(args, int));
-            ret_node = new BoolLiteralExpression(bool_literal);
+            ret_node = new (arena) BoolLiteralExpression(bool_literal);
 
             break;
         }
         case INT_LITERAL:
         {
             int int_literal = va_arg(args, int);
-            ret_node = new IntLiteralExpression(int_literal);
+            ret_node = new (arena) IntLiteralExpression(int_literal);
             break;
         }
         case FLOAT_LITERAL:
         {
             float float_literal = static_cast<float>(va_arg(args, double));
-            ret_node = new FloatLiteralExpression(float_literal);
+            ret_node = new (arena) FloatLiteralExpression(float_literal);
             break;
         }
         }
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -241,15 +244,13 @@ node *ast_allocate(NodeKind type, ...)
         int operator_type = va_arg(args, int);
         Expression *expression = va_arg(args, Expression*);
 
-        UnaryExpression* unary_expr = new UnaryExpression(operator_type, expression);
+        UnaryExpression* unary_expr = new (arena) UnaryExpression(operator_type, expression);
         /* Below is done before the semantic analysis, the type value will be filled
          * in, once semantic analysis is complete */
         ret_node = unary_expr;
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -259,15 +260,13 @@ node *ast_allocate(NodeKind type, ...)
         int operator_type  = va_arg(args, int);
         Expression *rhs_expr = va_arg(args, Expression *);
 
-        BinaryExpression *bin_expr = new BinaryExpression(operator_type, rhs_expr, lhs_expr);
+        BinaryExpression *bin_expr = new (arena) BinaryExpression(operator_type, rhs_expr, lhs_expr);
         /* Below is done before the semantic analysis, the type value will be filled
          * in, once semantic analysis is complete */
         ret_node = bin_expr;
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -275,32 +274,30 @@ node *ast_allocate(NodeKind type, ...)
     case VECTOR_NODE:
     {
         /* Need to think about types from identifier node */
-        string id_node(va_arg(args, char*));
+        const char *id_text = va_arg(args, const char *);
+        std::string_view id_node(id_text, va_arg(args, int));
+        SymbolId symbol = va_arg(args, SymbolId);
         int int_literal = va_arg(args, int);
 
-        VectorVariable *vec_var = new VectorVariable(id_node, int_literal);
+        VectorVariable *vec_var = new (arena) VectorVariable(id_node, symbol, int_literal);
 
         ret_node = vec_var;
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
     case FUNCTION_NODE:
     {
         /* Need to think about arguments null or non-null case */
-        char *func_name = va_arg(args, char*);
-        string function_name(func_name); /* The func name can not be null, thus directly cast */
+        const char *func_name = va_arg(args, const char *);
+        std::string_view function_name(func_name, va_arg(args, int)); /* Views the source, not copied */
         Arguments *arguments = va_arg(args, Arguments*);
-        ret_node = new Function(function_name, arguments);
+        ret_node = new (arena) Function(function_name, arguments);
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -309,12 +306,10 @@ node *ast_allocate(NodeKind type, ...)
         Type *type = va_arg(args, Type*);
         Arguments *arguments = va_arg(args, Arguments*);
 
-        ret_node = new Constructor(type, arguments);
+        ret_node = new (arena) Constructor(type, arguments);
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -322,7 +317,7 @@ node *ast_allocate(NodeKind type, ...)
     {
         Arguments *arguments = va_arg(args, Arguments*);
         if (arguments == nullptr){
-            arguments = new Arguments();
+            arguments = new (arena) Arguments(arena);
         }
         Expression *expression = va_arg(args, Expression*); /* Expression can not be null */
         arguments->push_back_expression(expression);
@@ -330,23 +325,21 @@ node *ast_allocate(NodeKind type, ...)
         ret_node = arguments;
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
     case IDENTIFIER_NODE:
     {
-        string id = static_cast<string>(va_arg(args, char *));
-        IdentifierNode *id_node = new IdentifierNode(id);
+        const char *id_text = va_arg(args, const char *);
+        std::string_view id(id_text, va_arg(args, int));
+        SymbolId symbol = va_arg(args, SymbolId);
+        IdentifierNode *id_node = new (arena) IdentifierNode(id, symbol);
 
         ret_node = id_node;
 
         YYLTYPE *rule_loc = va_arg(args, YYLTYPE *);
-        NodeLocation *rule_location = new NodeLocation(rule_loc->first_line, rule_loc->last_line,
-                                                        rule_loc->first_column, rule_loc->last_column);
-        ret_node->set_node_location(rule_location);
+        ret_node->set_span(*rule_loc);
         break;
     }
 
@@ -470,194 +463,270 @@ void Visitor::visit(IdentifierNode *var) {
     ;
 }
 void Visitor::visit(VectorVariable *vec_var) {
-    vec_var->get_id_type()->visit(*this);
+    ;
 }
 
 
-void ast_print(node *root)
+/* Counts every node reachable from the root, for the -Tt report */
+class NodeCountVisitor : public TreeWalker<NodeCountVisitor>
 {
-    PrintVisitor visitor;
-    root->visit(visitor);
-}
+  public:
+    int m_count = 0;
 
-void ast_free(node *ast_root)
+    template <class T> bool enter(T *node) {m_count++; return true;}
+};
+
+int ast_count_nodes(node *ast_root)
 {
-    delete ast_root;
+    NodeCountVisitor visitor;
+    visitor.walk(ast_root);
+    return visitor.m_count;
 }
 
 /*===============================================VISITORS=====================================*/
-void PrintVisitor::visit(Scope *scope)
+/* Writes a node's opening in enter and its closing in leave, with the
+ * spaces between children in after_child */
+class PrintVisitor : public TreeWalker<PrintVisitor>
+{
+  private:
+    FILE *m_dump_file;
+  public:
+    PrintVisitor(FILE *dump_file) : m_dump_file(dump_file) {}
+    using TreeWalker<PrintVisitor>::enter;
+    using TreeWalker<PrintVisitor>::leave;
+
+    void after_child(Node *parent, Node *child);
+
+    bool enter(Scope *scope);
+    void leave(Scope *scope);
+    bool enter(Declarations *decls);
+    void leave(Declarations *decls);
+    bool enter(Declaration *decl);
+    void leave(Declaration *decl);
+    bool enter(Type *type);
+
+    bool enter(Statements *stmts);
+    void leave(Statements *stmts);
+    bool enter(AssignStatement *as_stmt);
+    void leave(AssignStatement *as_stmt);
+    bool enter(IfStatement *if_statement);
+    void leave(IfStatement *if_statement);
+
+    bool enter(ConstructorExpression *ce);
+    void leave(ConstructorExpression *ce);
+    bool enter(FloatLiteralExpression *fle);
+    bool enter(BoolLiteralExpression *ble);
+    bool enter(IntLiteralExpression *ile);
+    bool enter(UnaryExpression *ue);
+    void leave(UnaryExpression *ue);
+    bool enter(BinaryExpression *be);
+    void leave(BinaryExpression *be);
+
+    bool enter(Function *f);
+    void leave(Function *f);
+    bool enter(IdentifierNode *var);
+    bool enter(VectorVariable *vec_var);
+};
+
+void ast_print(node *root, FILE *dump_file)
+{
+    PrintVisitor visitor(dump_file);
+    visitor.walk(root);
+}
+
+void PrintVisitor::after_child(Node *parent, Node *child)
+{
+    switch (parent->get_tag()) {
+    case DECLARATION_TAG: {
+        Declaration *decl = static_cast<Declaration *>(parent);
+        if (child == decl->type && decl->initial_val != nullptr)
+            fprintf(m_dump_file, " ");
+        break;
+    }
+    case ASSIGN_STATEMENT_TAG:
+        if (child == static_cast<AssignStatement *>(parent)->variable)
+            fprintf(m_dump_file, " ");
+        break;
+    case IF_STATEMENT_TAG: {
+        IfStatement *if_statement = static_cast<IfStatement *>(parent);
+        if (child == if_statement->expression ||
+            (child == if_statement->statement && if_statement->else_statement))
+            fprintf(m_dump_file, " ");
+        break;
+    }
+    case BINARY_EXPRESSION_TAG:
+        if (child == static_cast<BinaryExpression *>(parent)->left_expression)
+            fprintf(m_dump_file, " ");
+        break;
+    case ARGUMENTS_TAG:
+        fprintf(m_dump_file, " ");
+        break;
+    default:
+        break;
+    }
+}
+
+bool PrintVisitor::enter(Scope *scope)
 {
-    printf("(SCOPE \n");
-    scope->declarations->visit(*this);
+    fprintf(m_dump_file, "(SCOPE \n");
     assert(scope->statements);
-    scope->statements->visit(*this);
-    printf(")\n");
+    return true;
 }
 
-void PrintVisitor::visit(Declarations *decl)
+void PrintVisitor::leave(Scope *scope)
 {
-    printf("\t(DECLARATIONS\n");
-    for (Declaration *declaration : decl->declaration_list)
-    {
-        assert (declaration != nullptr);
-        declaration->visit(*this);
-    }
-    printf("\t)\n");
+    fprintf(m_dump_file, ")\n");
 }
-void PrintVisitor::visit(Declaration *decl)
+
+bool PrintVisitor::enter(Declarations *decl)
 {
-    printf("\t\t(DECLARATION ");
-    assert(decl->type);
-    printf(" %s ", decl->id.c_str());
-    decl->type->visit(*this);
-    if (decl->initial_val != nullptr) {
-        printf(" ");
-        decl->initial_val->visit(*this);
-    }
-    printf(")\n");
+    fprintf(m_dump_file, "\t(DECLARATIONS\n");
+    return true;
 }
 
-void PrintVisitor::visit(Type *type)
+void PrintVisitor::leave(Declarations *decl)
 {
-    cout << type->type_name;
+    fprintf(m_dump_file, "\t)\n");
 }
 
-void PrintVisitor::visit(Statements *stmts)
+bool PrintVisitor::enter(Declaration *decl)
 {
-    printf("\t(STATEMENTS\n");
-    for (Statement *stmt : stmts->get_statement_list())
-    {
-        assert(stmt != nullptr);
-        stmt->visit(*this);
-    }
-    printf("\t)\n");
+    fprintf(m_dump_file, "\t\t(DECLARATION ");
+    assert(decl->type);
+    fprintf(m_dump_file, " %.*s ", (int)decl->id.size(), decl->id.data());
+    fprintf(m_dump_file, "%s", decl->get_type().get_name().c_str());
+    return true;
 }
 
-void PrintVisitor::visit(Statement *stmt) {
-    assert(0);
+void PrintVisitor::leave(Declaration *decl)
+{
+    fprintf(m_dump_file, ")\n");
 }
 
-void PrintVisitor::visit(AssignStatement *assign_stmt)
+/* Declarations and constructors write their types themselves */
+bool PrintVisitor::enter(Type *type)
 {
-    printf("\t\t(ASSIGN ");
-    printf("%s ", assign_stmt->variable->get_id_type() ? assign_stmt->variable->get_id_type()->type_name.c_str() : "ANY_TYPE");
-    assign_stmt->variable->visit(*this);
-    printf(" ");
-    assign_stmt->expression->visit(*this);
-    printf(")\n");
+    return false;
 }
 
-void PrintVisitor::visit(IfStatement *if_statement)
+bool PrintVisitor::enter(Statements *stmts)
 {
-    printf("\t(IF ");
-    if_statement->expression->visit(*this);
-    printf(" ");
-    if_statement->statement->visit(*this);
-    if (if_statement->else_statement){
-        printf(" ");
-        if_statement->else_statement->visit(*this);
-    }
-    printf("\t)\n");
+    fprintf(m_dump_file, "\t(STATEMENTS\n");
+    return true;
 }
 
-void PrintVisitor::visit(NestedScope *ns)
+void PrintVisitor::leave(Statements *stmts)
 {
-    ns->scope->visit(*this);
+    fprintf(m_dump_file, "\t)\n");
 }
 
-void PrintVisitor::visit(EmptyStatement *es)
+bool PrintVisitor::enter(AssignStatement *assign_stmt)
 {
-    ;
+    fprintf(m_dump_file, "\t\t(ASSIGN ");
+    fprintf(m_dump_file, "%s ", assign_stmt->variable->get_id_type().get_name().c_str());
+    return true;
 }
 
-void PrintVisitor::visit(FunctionExpression *fe)
+void PrintVisitor::leave(AssignStatement *assign_stmt)
 {
-    fe->function->visit(*this);
+    fprintf(m_dump_file, ")\n");
 }
-void PrintVisitor::visit(VariableExpression *ve)
+
+bool PrintVisitor::enter(IfStatement *if_statement)
 {
-    ve->id_node->visit(*this);
+    fprintf(m_dump_file, "\t(IF ");
+    return true;
 }
 
-void PrintVisitor::visit(ConstructorExpression *ce)
+void PrintVisitor::leave(IfStatement *if_statement)
 {
-    printf("(CALL ");
-    printf("%s ", ce->get_expression_type().c_str());
-    ce->constructor->visit(*this);
-    printf(")");
+    fprintf(m_dump_file, "\t)\n");
 }
-void PrintVisitor::visit(IntLiteralExpression *ile)
+
+bool PrintVisitor::enter(ConstructorExpression *ce)
 {
-    printf("%d", ile->int_literal);
+    fprintf(m_dump_file, "(CALL ");
+    fprintf(m_dump_file, "%s ", ce->get_expression_type().get_name().c_str());
+    return true;
 }
 
-void PrintVisitor::visit(BoolLiteralExpression *ble)
+void PrintVisitor::leave(ConstructorExpression *ce)
 {
-    printf("%s", (ble->bool_literal? "true" : "false"));
+    fprintf(m_dump_file, ")");
 }
 
-void PrintVisitor::visit(FloatLiteralExpression *fle)
+bool PrintVisitor::enter(IntLiteralExpression *ile)
 {
-    printf("%f", fle->float_literal);
+    fprintf(m_dump_file, "%d", ile->int_literal);
+    return true;
 }
 
-void PrintVisitor::visit(UnaryExpression *ue)
+bool PrintVisitor::enter(BoolLiteralExpression *ble)
 {
-    printf("(UNARY ");
-    printf("%s", ue->get_expression_type().c_str());
-    printf(" %s ", convert_op_to_string(ue->operator_type).c_str()); /*Fill in operator information */
-    ue->right_expression->visit(*this);
-    printf(")");
+    fprintf(m_dump_file, "%s", (ble->bool_literal? "true" : "false"));
+    return true;
 }
 
-void PrintVisitor::visit(BinaryExpression *be)
+bool PrintVisitor::enter(FloatLiteralExpression *fle)
 {
-    printf("(BINARY ");
-    printf("%s",be->get_expression_type().c_str());
-    printf(" %s ", convert_op_to_string(be->operator_type).c_str()); /*Fill in operator information */
-    be->left_expression->visit(*this);
-    printf(" ");
-    be->right_expression->visit(*this);
-    printf(")");
+    fprintf(m_dump_file, "%f", fle->float_literal);
+    return true;
 }
 
+bool PrintVisitor::enter(UnaryExpression *ue)
+{
+    fprintf(m_dump_file, "(UNARY ");
+    fprintf(m_dump_file, "%s", ue->get_expression_type().get_name().c_str());
+    fprintf(m_dump_file, " %s ", convert_op_to_string(ue->operator_type).c_str()); /*Fill in operator information */
+    return true;
+}
 
-void PrintVisitor::visit(Function *func)
+void PrintVisitor::leave(UnaryExpression *ue)
 {
-    printf("(CALL");
-    printf(" %s ", func->function_name.c_str());
-    func->arguments->visit(*this);
-    printf(")");
+    fprintf(m_dump_file, ")");
+}
 
+bool PrintVisitor::enter(BinaryExpression *be)
+{
+    fprintf(m_dump_file, "(BINARY ");
+    fprintf(m_dump_file, "%s",be->get_expression_type().get_name().c_str());
+    fprintf(m_dump_file, " %s ", convert_op_to_string(be->operator_type).c_str()); /*Fill in operator information */
+    return true;
 }
-void PrintVisitor::visit(Constructor *ct)
+
+void PrintVisitor::leave(BinaryExpression *be)
 {
-    ct->args->visit(*this);
+    fprintf(m_dump_file, ")");
 }
 
-void PrintVisitor::visit(Arguments *args)
+
+bool PrintVisitor::enter(Function *func)
 {
-    for (Expression *expr : args->get_expression_list()){
-        assert(expr != nullptr);
-        expr->visit(*this);
-        printf(" ");
-    }
+    fprintf(m_dump_file, "(CALL");
+    fprintf(m_dump_file, " %.*s ", (int)func->function_name.size(), func->function_name.data());
+    return true;
+}
+
+void PrintVisitor::leave(Function *func)
+{
+    fprintf(m_dump_file, ")");
 }
 
-void PrintVisitor::visit(IdentifierNode *ident)
+bool PrintVisitor::enter(IdentifierNode *ident)
 {
-    printf("%s", ident->id.c_str());
+    fprintf(m_dump_file, "%.*s", (int)ident->id.size(), ident->id.data());
+    return true;
 }
 
-void PrintVisitor::visit(VectorVariable *vec_var)
+bool PrintVisitor::enter(VectorVariable *vec_var)
 {
-    printf("(INDEX ");
-    if (vec_var->get_id_type() == nullptr)
-        printf(" ANY_TYPE");
+    fprintf(m_dump_file, "(INDEX ");
+    if (!vec_var->has_id_type())
+        fprintf(m_dump_file, " ANY_TYPE");
     else
-        vec_var->get_id_type()->visit(*this);
-    printf(" %s ", vec_var->id.c_str());
-    printf("%d", vec_var->vector_index);
-    printf(")");
+        fprintf(m_dump_file, "%s", vec_var->get_id_type().get_name().c_str());
+    fprintf(m_dump_file, " %.*s ", (int)vec_var->id.size(), vec_var->id.data());
+    fprintf(m_dump_file, "%d", vec_var->vector_index);
+    fprintf(m_dump_file, ")");
+    return true;
 }
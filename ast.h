@@ -1,17 +1,21 @@
 #ifndef AST_H_
 #define AST_H_ 1
+#include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cassert>
 #include <ostream>
+#include "arena.h"
+#include "intern.h"
+#include "location.h"
+#include "types.h"
 
 /**************************************************************************
  *                              FORWARD DECLARATIONS                      *
  *                                                                        *
  *************************************************************************/
-class PrintVisitor;
-class NodeLocation;
 class Scope;
 class Declaration;
 class Declarations;
@@ -45,8 +49,6 @@ class Arguments;
 
 typedef Node node;
 
-extern node *ast;
-
 typedef enum
 {
     UNKNOWN = 0,
@@ -76,6 +78,35 @@ typedef enum
 
 } NodeKind;
 
+/* The class a node was made as, set by its constructor; see TreeWalker */
+enum NodeTag : uint8_t
+{
+    SCOPE_TAG,
+    DECLARATIONS_TAG,
+    DECLARATION_TAG,
+    TYPE_TAG,
+    STATEMENTS_TAG,
+    ASSIGN_STATEMENT_TAG,
+    IF_STATEMENT_TAG,
+    NESTED_SCOPE_TAG,
+    EMPTY_STATEMENT_TAG,
+
+    CONSTRUCTOR_EXPRESSION_TAG,
+    FLOAT_LITERAL_TAG,
+    BOOL_LITERAL_TAG,
+    INT_LITERAL_TAG,
+    UNARY_EXPRESSION_TAG,
+    BINARY_EXPRESSION_TAG,
+    VARIABLE_EXPRESSION_TAG,
+    FUNCTION_EXPRESSION_TAG,
+
+    FUNCTION_TAG,
+    CONSTRUCTOR_TAG,
+    ARGUMENTS_TAG,
+    IDENTIFIER_TAG,
+    VECTOR_VARIABLE_TAG,
+};
+
 typedef enum
 {
     BOOL_EXPRESSION,
@@ -84,8 +115,6 @@ typedef enum
     CONSTRUCTOR_EXPRESSION,
     VARIABLE,
     FUNCTION,
-    TEMP_ID_EXPRESSION,
-    TEMP_VECTOR_EXPRESSION,
 } ExpressionType;
 
 typedef enum
@@ -131,86 +160,35 @@ class Visitor
     virtual void visit(VectorVariable *vec_var);
 };
 
-class PrintVisitor : public Visitor {
-  public:
-    virtual void visit(Scope *scope);
-    virtual void visit(Declaration *decl);
-    virtual void visit(Declarations *decls);
-    virtual void visit(Type *type);
-
-    virtual void visit(Statement *stmt);
-    virtual void visit(Statements *stmts);
-    virtual void visit(AssignStatement *as_stmt);
-    virtual void visit(IfStatement *if_statement);
-    virtual void visit(NestedScope *ns);
-    virtual void visit(EmptyStatement *es);
-
-    virtual void visit(ConstructorExpression *ce);
-    virtual void visit(FloatLiteralExpression *fle);
-    virtual void visit(BoolLiteralExpression *ble);
-    virtual void visit(IntLiteralExpression *ile);
-    virtual void visit(UnaryExpression *ue);
-    virtual void visit(BinaryExpression *be);
-    virtual void visit(VariableExpression *ve);
-    virtual void visit(FunctionExpression *fe);
-
-    virtual void visit(Function *f);
-    virtual void visit(Constructor *c);
-    virtual void visit(Arguments *args);
-    virtual void visit(IdentifierNode *var);
-    virtual void visit(VectorVariable *vec_var);
-};
-
-class NodeLocation
-{
-  private:
-    int m_first_line = 0;
-    int m_last_line  = 0;
-    int m_first_col = 0;
-    int m_last_col = 0;
-  public:
-    NodeLocation(int first_line, int last_line, int first_col, int last_col) :
-      m_first_line(first_line), m_last_line(last_line), m_first_col(first_col), m_last_col(last_col) {}
-
-    int get_first_line() const {return m_first_line;}
-    int get_last_line() const {return m_last_line;}
-    int get_first_col() const {return m_first_col;}
-    int get_last_col() const {return m_last_col;}
-
-};
-
-inline std::ostream& operator<<(std::ostream &out, NodeLocation const& data) {
-      out << "at line ";
-      out << data.get_first_line() << ':';
-      out << data.get_first_col();
-      out << " to " << data.get_last_line() << ':';
-      out << data.get_last_col();
-
-      return out;
-}
-
+/* Nodes are made in the Arena of their compile, new (arena) Scope(), and
+ * released with it; none is ever deleted, so none has a destructor */
 class Node
 {
   private:
-    NodeLocation *m_node_location_in_file = nullptr;
+    SourceSpan m_span = {0, 0};
+    NodeTag m_tag;
+  protected:
+    explicit Node(NodeTag tag) : m_tag(tag) {}
   public:
     virtual void visit(Visitor &vistor) = 0;
-    virtual ~Node() {delete m_node_location_in_file;}
+    NodeTag get_tag() const {return m_tag;}
+
+    static void *operator new(size_t size, Arena *arena) {return arena->allocate(size);}
+    static void operator delete(void *, Arena *) {}
+    static void *operator new(size_t size) = delete;
+    static void operator delete(void *) = delete;
 
-  public: /* The fields below are used to track the location for different nodes */
-    NodeLocation *get_node_location () const {return m_node_location_in_file;}
-    void set_node_location (NodeLocation *node_location) {m_node_location_in_file = node_location;}
+  public: /* Where the node is in the source, see LineTable for its lines */
+    SourceSpan get_span () const {return m_span;}
+    void set_span (SourceSpan span) {m_span = span;}
 };
 
 class Type : public Node
 {
   public:
-    std::string type_name;
+    TypeDesc desc;
 
-    Type(const std::string &type)
-    {
-        this->type_name = type;
-    }
+    Type(TypeDesc type) : Node(TYPE_TAG), desc(type) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
@@ -220,20 +198,23 @@ class Type : public Node
 class Expression : public Node
 {
   private:
-    std::string type = "ANY_TYPE";
+    TypeDesc type;
     bool m_is_const = false;
-    std::string result_register_name = "";
+    std::string_view result_register_name;    /* Kept by the code generator, see set_result_register_name */
+  protected:
+    explicit Expression(NodeTag tag) : Node(tag) {}
   public:
-    virtual std::string get_expression_type() const {return type;}
-    virtual void set_expression_type(std::string type_str) {type = type_str;}
+    TypeDesc get_expression_type() const {return type;}
+    void set_expression_type(TypeDesc expression_type) {type = expression_type;}
     virtual bool get_is_const() const { return m_is_const; }
     void set_is_const( bool is_const) { m_is_const = is_const;}
 
-    virtual std::string get_result_register_name() const {return result_register_name;}
-    virtual void set_result_register_name(std::string register_name) {result_register_name = register_name;}
-
-  public:
-    virtual ~Expression() {}
+    virtual std::string get_result_register_name() const {return std::string(result_register_name);}
+    /* The name is copied into names, which has to last while it is used */
+    void set_result_register_name(Arena *names, std::string_view register_name) {
+        result_register_name = names->copy(register_name);
+    }
+    void clear_result_register_name() {result_register_name = std::string_view();}
 };
 
 class Declaration : public Node
@@ -242,16 +223,21 @@ class Declaration : public Node
     bool is_const = false;
     bool is_read_only = false;
     bool is_write_only = false;
+    bool is_predefined = false;
+    bool is_redeclared = false;
   public:
     Type *type = nullptr;
-    std::string id;
+    std::string_view id;    /* Views the source text, or a literal for predefined variables */
+    SymbolId symbol;        /* Interned id, what the symbol table is keyed by */
     Expression *initial_val = nullptr;
 
   public:
-    Declaration(Type *type, const std::string &id, Expression *init_val, bool is_const)
+    Declaration(Type *type, std::string_view id, SymbolId symbol, Expression *init_val, bool is_const) :
+        Node(DECLARATION_TAG)
     {
         this->type = type;
         this->id = id;
+        this->symbol = symbol;
         this->initial_val = init_val;
         this->is_const = is_const;
     }
@@ -267,59 +253,62 @@ class Declaration : public Node
     void set_is_read_only(const bool &read_only_val) { is_read_only = read_only_val;}
     bool get_is_write_only() const {return is_write_only;}
     void set_is_write_only(const bool &write_only_val) { is_write_only = write_only_val;}
+    bool get_is_predefined() const {return is_predefined;}
+    void set_is_predefined(const bool &predefined_val) { is_predefined = predefined_val;}
+    bool get_is_redeclared() const {return is_redeclared;}
+    void set_is_redeclared(const bool &redeclared_val) { is_redeclared = redeclared_val;}
 
-  public: /* Place to put destructor function calls */
-    ~Declaration() {
-        delete type;
-        delete initial_val;
-    }
+    /* The type the checks go by, ANY_TYPE for a redeclaration */
+    TypeDesc get_type() const {return is_redeclared ? TypeDesc() : type->desc;}
 };
 
 class Declarations : public Node
 {
   public:
-    std::vector<Declaration *> declaration_list;
+    NodeList<Declaration *> declaration_list;
 
   public:
+    explicit Declarations(Arena *arena) : Node(DECLARATIONS_TAG), declaration_list(arena) {}
+
     virtual void push_back_declaration(Declaration *decl) { declaration_list.push_back(decl); }
-    virtual void push_front_declaration(Declaration *decl) { declaration_list.insert(declaration_list.begin(), decl);}
+    virtual void push_front_declaration(Declaration *decl) { declaration_list.insert(0, &decl, 1);}
+    /* Take out count declarations from first on and put replacement in their place */
+    void replace_declarations(size_t first, size_t count, const std::vector<Declaration *> &replacement) {
+        declaration_list.erase(first, count);
+        declaration_list.insert(first, replacement.data(), replacement.size());
+    }
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     }
-  public:
-    ~Declarations() {
-        for (Declaration *decl : declaration_list)
-            delete decl; /* We don't have nullptr in the list, so safe to loop all of them :) */
-    }
 };
 
 class Statement : public Node
 {
+  protected:
+    explicit Statement(NodeTag tag) : Node(tag) {}
   public:
     virtual void visit(Visitor &visitor) = 0;
-
-  public:
-    virtual ~Statement() {}
 };
 
 class Statements : public Node
 {
   private:
-    std::vector<Statement *> statement_list;
+    NodeList<Statement *> statement_list;
   public:
+    explicit Statements(Arena *arena) : Node(STATEMENTS_TAG), statement_list(arena) {}
 
-    const std::vector<Statement *> &get_statement_list() const {return statement_list;}
+    const NodeList<Statement *> &get_statement_list() const {return statement_list;}
     virtual void push_back_statement(Statement *stmt) { statement_list.push_back(stmt); }
+    /* Take out count statements from first on and put replacement in their place */
+    void replace_statements(size_t first, size_t count, const std::vector<Statement *> &replacement) {
+        statement_list.erase(first, count);
+        statement_list.insert(first, replacement.data(), replacement.size());
+    }
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~Statements() {
-        for (Statement *statement : statement_list)
-            delete statement;
-    }
 };
 
 class Scope : public Node
@@ -327,15 +316,12 @@ class Scope : public Node
   public:
     Declarations *declarations = nullptr;
     Statements *statements = nullptr;
+
+    Scope() : Node(SCOPE_TAG) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     }
-  public:
-    ~Scope() {
-        delete declarations;
-        delete statements;
-    }
 };
 
 /**********************************************Identifier Classes*********************************************************/
@@ -345,47 +331,52 @@ class IdentifierNode : public Node
     Declaration *declaration = nullptr;
 
   public:
-    virtual Type *get_id_type() const {return declaration ? declaration->type : NULL;}
+    /* ANY_TYPE until the identifier has a declaration */
+    virtual TypeDesc get_id_type() const {return declaration ? declaration->get_type() : TypeDesc();}
+    virtual bool has_id_type() const {return declaration != nullptr;}
     void set_declaration(Declaration *decl) {declaration = decl;}
     virtual Declaration *get_declaration() const {return declaration;}
-    virtual void set_id_type(Type *type) {}
+    virtual void set_id_type(TypeDesc type) {}
 
   public:
-    std::string id;
+    std::string_view id;    /* Views the source text */
+    SymbolId symbol;        /* Interned id of id */
 
-    IdentifierNode(const std::string &identifier) : id(identifier) {}
+    IdentifierNode(std::string_view identifier, SymbolId symbol) : Node(IDENTIFIER_TAG), id(identifier), symbol(symbol) {}
+  protected:
+    IdentifierNode(NodeTag tag, std::string_view identifier, SymbolId symbol) : Node(tag), id(identifier), symbol(symbol) {}
+  public:
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    virtual ~IdentifierNode () {} /* We don't delete declaration, because they are handled in the earlier stages, but have to say.. this might
-                                   be a design flaw. It is a virtual destructor due to inheritance */
 };
 
 class VectorVariable : public IdentifierNode
 {
   private:
-    Type *type = nullptr;
+    TypeDesc m_type;    /* Of the element, once checked */
+    bool m_has_type = false;
   public:
     int vector_index;
 
-    VectorVariable(std::string id_node, int v_index) :
-        IdentifierNode(id_node), vector_index(v_index) {}
+    VectorVariable(std::string_view id_node, SymbolId symbol, int v_index) :
+        IdentifierNode(VECTOR_VARIABLE_TAG, id_node, symbol), vector_index(v_index) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
 
-    Type *get_id_type() const{
-        return type ?: IdentifierNode::get_id_type();
+    TypeDesc get_id_type() const{
+        return m_has_type ? m_type : IdentifierNode::get_id_type();
     }
+    bool has_id_type() const {return m_has_type || IdentifierNode::has_id_type();}
 
-    void set_id_type(Type *t) {
-        type = t;
+    void set_id_type(TypeDesc t) {
+        m_type = t;
+        m_has_type = true;
     }
-  public:
-    ~VectorVariable() { if (type != nullptr) delete type;}
+    void clear_id_type() {m_has_type = false;}
 };
 /**********************************************END Identifier Classes*********************************************************/
 
@@ -395,16 +386,13 @@ class AssignStatement : public Statement
   public:
     IdentifierNode *variable = nullptr;
     Expression *expression = nullptr;
+
+    AssignStatement() : Statement(ASSIGN_STATEMENT_TAG) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-   public:
-    ~AssignStatement() {
-        delete variable;
-        delete expression;
-    }
-};
+ };
 
 class IfStatement : public Statement
 {
@@ -413,16 +401,11 @@ class IfStatement : public Statement
     Statement *statement = nullptr;
     Statement *else_statement = nullptr;
 
+    IfStatement() : Statement(IF_STATEMENT_TAG) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~IfStatement() {
-        delete expression;
-        delete statement;
-        if (else_statement) delete else_statement;
-    }
 };
 
 class NestedScope : public Statement
@@ -430,23 +413,20 @@ class NestedScope : public Statement
   public:
     Scope *scope;
 
-    NestedScope(Scope *s) : scope(s) {}
+    NestedScope(Scope *s) : Statement(NESTED_SCOPE_TAG), scope(s) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~NestedScope() {delete scope;}
 };
 
 class EmptyStatement: public Statement
 {
   public:
+    EmptyStatement() : Statement(EMPTY_STATEMENT_TAG) {}
     virtual void visit(Visitor &visitor) {
         visitor.visit(this);
     }
-  public:
-    ~EmptyStatement() {}
 };
 
 /*================END OF STATEMENT CLASS================*/
@@ -455,10 +435,11 @@ class EmptyStatement: public Statement
 class Arguments : public Node
 {
   private:
-    std::vector<Expression *> m_expression_list;
+    NodeList<Expression *> m_expression_list;
   public:
+    explicit Arguments(Arena *arena) : Node(ARGUMENTS_TAG), m_expression_list(arena) {}
 
-    const std::vector<Expression *> &get_expression_list() const { return m_expression_list; }
+    const NodeList<Expression *> &get_expression_list() const { return m_expression_list; }
 
     virtual void visit(Visitor &visitor)
     {
@@ -466,12 +447,6 @@ class Arguments : public Node
     };
 
     virtual void push_back_expression(Expression *expression) {m_expression_list.push_back(expression);}
-
-  public:
-    ~Arguments() {
-        for (Expression *expression : m_expression_list)
-            delete expression;
-    }
 };
 
 class Constructor : public Node
@@ -480,16 +455,11 @@ class Constructor : public Node
     Type *type;
     Arguments *args;
 
-    Constructor (Type *t, Arguments *arguments) : type(t), args(arguments) {}
+    Constructor (Type *t, Arguments *arguments) : Node(CONSTRUCTOR_TAG), type(t), args(arguments) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~Constructor() {
-        delete type;
-        delete args;
-    }
 };
 
 class ConstructorExpression : public Expression
@@ -497,28 +467,24 @@ class ConstructorExpression : public Expression
   public:
     Constructor *constructor;
 
-    ConstructorExpression(Constructor *ct) : constructor(ct) {}
+    ConstructorExpression(Constructor *ct) : Expression(CONSTRUCTOR_EXPRESSION_TAG), constructor(ct) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~ConstructorExpression() {delete constructor;}
 };
 
 class Function : public Node
 {
   public:
-    std::string function_name;
+    std::string_view function_name;
     Arguments *arguments;
-    Function(std::string func_name, Arguments *args) : function_name(func_name), arguments(args) {}
+    Function(std::string_view func_name, Arguments *args) : Node(FUNCTION_TAG), function_name(func_name), arguments(args) {}
 
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~Function() {delete arguments;}
 };
 
 class FunctionExpression : public Expression
@@ -526,13 +492,11 @@ class FunctionExpression : public Expression
   public:
     Function *function;
 
-    FunctionExpression(Function *func) : function(func) {}
+    FunctionExpression(Function *func) : Expression(FUNCTION_EXPRESSION_TAG), function(func) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~FunctionExpression() {delete function; }
 };
 /*****************************************END Consturctors and Functions Definitions**********************/
 
@@ -541,14 +505,11 @@ class VariableExpression : public Expression
   public:
     IdentifierNode *id_node;
 
-    VariableExpression(IdentifierNode *id) : id_node(id) {}
+    VariableExpression(IdentifierNode *id) : Expression(VARIABLE_EXPRESSION_TAG), id_node(id) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-
-  public:
-    ~VariableExpression() {delete id_node;}
 };
 
 class IntLiteralExpression : public Expression
@@ -556,7 +517,7 @@ class IntLiteralExpression : public Expression
   public:
     int int_literal;
 
-    IntLiteralExpression(int int_val) : int_literal(int_val) {}
+    IntLiteralExpression(int int_val) : Expression(INT_LITERAL_TAG), int_literal(int_val) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
@@ -571,7 +532,7 @@ class BoolLiteralExpression : public Expression
   public:
     bool bool_literal;
 
-    BoolLiteralExpression(bool bool_val) : bool_literal(bool_val) {}
+    BoolLiteralExpression(bool bool_val) : Expression(BOOL_LITERAL_TAG), bool_literal(bool_val) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
@@ -588,7 +549,7 @@ class FloatLiteralExpression : public Expression
   public:
     float float_literal;
 
-    FloatLiteralExpression(float float_val) : float_literal(float_val) {}
+    FloatLiteralExpression(float float_val) : Expression(FLOAT_LITERAL_TAG), float_literal(float_val) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
@@ -606,14 +567,16 @@ class UnaryExpression : public Expression
 
   public:
 
-    UnaryExpression(int op, Expression *rhs_expression) : operator_type(op), right_expression(rhs_expression) {}
+    UnaryExpression(int op, Expression *rhs_expression) :
+        Expression(UNARY_EXPRESSION_TAG), operator_type(op), right_expression(rhs_expression) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
 
-  public:
-    ~UnaryExpression() {delete right_expression;}
+  protected:
+    UnaryExpression(NodeTag tag, int op, Expression *rhs_expression) :
+        Expression(tag), operator_type(op), right_expression(rhs_expression) {}
 };
 
 class BinaryExpression : public UnaryExpression
@@ -624,65 +587,441 @@ class BinaryExpression : public UnaryExpression
   public:
 
     BinaryExpression(int op, Expression *rhs_expression, Expression *lhs_expression) :
-        UnaryExpression(op, rhs_expression), left_expression(lhs_expression) {}
+        UnaryExpression(BINARY_EXPRESSION_TAG, op, rhs_expression), left_expression(lhs_expression) {}
     virtual void visit(Visitor &visitor)
     {
         visitor.visit(this);
     };
-  public:
-    ~BinaryExpression() {delete left_expression;}
 };
 
 
-/* Use of Expression visitor to get the type of the expression */
-class ExpressionVisitor : public Visitor
+/* A walk over every node of a tree, for the passes that go through all of
+ * them. Derived declares hooks for the classes it handles, without virtual,
+ *
+ *   bool enter(X *node)    before the children of node; false skips
+ *                          them and the leave of node
+ *   void leave(X *node)    after the children of node
+ *   void after_child(Node *parent, Node *child)
+ *                          after each child, entered or not
+ *
+ * and takes the rest from here with using TreeWalker<Derived>::enter and
+ * ::leave. Children are walked in the order Visitor visits them, and a
+ * null argument is skipped. A hook can walk() a subtree itself, to
+ * translate it again or to leave some of it out.
+ *
+ * The first MAX_NATIVE_DEPTH levels below the root are walked with calls,
+ * a function for each class, so that a child whose class is known from
+ * its parent's is a direct call, and an expression or a statement is
+ * told apart by a switch on its tag inlined where it is walked: each site
+ * has branches of its own to predict, as the virtual calls of Visitor
+ * did, and one shared switch is slower than those. The subtrees below
+ * that, such as the rest of a left-deep chain a + b + c + ... a hundred
+ * thousand terms long, are walked by a loop that keeps the path on a
+ * stack of its own, so a walk takes a bounded amount of the native stack
+ * however deep the tree is. */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+template <class Derived>
+class TreeWalker
 {
-    private:
-        int expression_instance_type = -1;
-    public:
-        int get_expression_instance_type() const {return expression_instance_type;}
-        void set_expression_instance_type(int type) {expression_instance_type = type;}
-
-        /* Empty visiting statements, as we only need to retrieve the current level type */
-        virtual void visit(Scope *scope) {}
-        virtual void visit(Declaration *decl) {}
-        virtual void visit (Declarations *decls) {}
-        virtual void visit(Type *type) {}
-
-        virtual void visit(Statement *stmt) {}
-        virtual void visit(Statements *stmts) {}
-        virtual void visit(AssignStatement *as_stmt) {}
-        virtual void visit(IfStatement *if_statement) {}
-        virtual void visit(NestedScope *ns) {}
-        virtual void visit(EmptyStatement *es) {}
-
-        virtual void visit(ConstructorExpression *ce) {set_expression_instance_type(CONSTRUCTOR_EXPRESSION);}
-        virtual void visit(FloatLiteralExpression *fle) {set_expression_instance_type(FLOAT_LITERAL);}
-        virtual void visit(BoolLiteralExpression *ble) {set_expression_instance_type(BOOL_EXPRESSION); }
-        virtual void visit(IntLiteralExpression *ile) {set_expression_instance_type(INT_LITERAL);}
-        virtual void visit(UnaryExpression *ue) {}
-        virtual void visit(BinaryExpression *be) {}
-        virtual void visit(VariableExpression *ve) {set_expression_instance_type(VARIABLE);}
-        virtual void visit(FunctionExpression *fe) {set_expression_instance_type(FUNCTION);}
-
-
-        virtual void visit(Function *f) {}
-        virtual void visit(Constructor *c) {}
-
-        virtual void visit(IdentifierNode *var) {set_expression_instance_type(TEMP_ID_EXPRESSION);}
-        virtual void visit(VectorVariable *vec_var) {set_expression_instance_type(TEMP_VECTOR_EXPRESSION);}
+  public:
+    /* Each level takes a few frames of the native stack */
+    static const int MAX_NATIVE_DEPTH = 1000;
 
-};
+  private:
+    int m_depth = 0;
+
+    struct Frame
+    {
+        Node *node;
+        uint32_t next;    /* Where the next child of node is looked for */
+    };
+    std::vector<Frame> m_stack;
+
+    Derived *self() {return static_cast<Derived *>(this);}
+
+    /*------------------------- The walk with calls -------------------------*/
+    template <class T> ALWAYS_INLINE void child(Node *parent, T *node) {
+        if (m_depth < MAX_NATIVE_DEPTH) {
+            m_depth++;
+            dispatch(node);
+            m_depth--;
+        }
+        else
+            walk_deep(node);
+        self()->after_child(parent, node);
+    }
+
+    template <class T> ALWAYS_INLINE void dispatch(T *node) {descend(node);}
+    ALWAYS_INLINE void dispatch(Expression *expr) {
+        switch (expr->get_tag()) {
+        case CONSTRUCTOR_EXPRESSION_TAG: descend(static_cast<ConstructorExpression *>(expr)); break;
+        case FLOAT_LITERAL_TAG: descend(static_cast<FloatLiteralExpression *>(expr)); break;
+        case BOOL_LITERAL_TAG: descend(static_cast<BoolLiteralExpression *>(expr)); break;
+        case INT_LITERAL_TAG: descend(static_cast<IntLiteralExpression *>(expr)); break;
+        case UNARY_EXPRESSION_TAG: descend(static_cast<UnaryExpression *>(expr)); break;
+        case BINARY_EXPRESSION_TAG: descend(static_cast<BinaryExpression *>(expr)); break;
+        case VARIABLE_EXPRESSION_TAG: descend(static_cast<VariableExpression *>(expr)); break;
+        case FUNCTION_EXPRESSION_TAG: descend(static_cast<FunctionExpression *>(expr)); break;
+        default: assert(0);
+        }
+    }
+    ALWAYS_INLINE void dispatch(Statement *stmt) {
+        switch (stmt->get_tag()) {
+        case ASSIGN_STATEMENT_TAG: descend(static_cast<AssignStatement *>(stmt)); break;
+        case IF_STATEMENT_TAG: descend(static_cast<IfStatement *>(stmt)); break;
+        case NESTED_SCOPE_TAG: descend(static_cast<NestedScope *>(stmt)); break;
+        case EMPTY_STATEMENT_TAG: descend(static_cast<EmptyStatement *>(stmt)); break;
+        default: assert(0);
+        }
+    }
+    ALWAYS_INLINE void dispatch(IdentifierNode *var) {
+        if (var->get_tag() == VECTOR_VARIABLE_TAG)
+            descend(static_cast<VectorVariable *>(var));
+        else
+            descend(var);
+    }
+
+    void descend(Scope *scope) {
+        if (!self()->enter(scope))
+            return;
+        child(scope, scope->declarations);
+        child(scope, scope->statements);
+        self()->leave(scope);
+    }
+    void descend(Declarations *decls) {
+        if (!self()->enter(decls))
+            return;
+        for (Declaration *declaration : decls->declaration_list)
+            child(decls, declaration);
+        self()->leave(decls);
+    }
+    void descend(Declaration *decl) {
+        if (!self()->enter(decl))
+            return;
+        child(decl, decl->type);
+        if (decl->initial_val != nullptr)
+            child(decl, decl->initial_val);
+        self()->leave(decl);
+    }
+    void descend(Type *type) {
+        if (self()->enter(type))
+            self()->leave(type);
+    }
+
+    void descend(Statements *stmts) {
+        if (!self()->enter(stmts))
+            return;
+        for (Statement *stmt : stmts->get_statement_list())
+            child(stmts, stmt);
+        self()->leave(stmts);
+    }
+    void descend(AssignStatement *assign_stmt) {
+        if (!self()->enter(assign_stmt))
+            return;
+        child(assign_stmt, assign_stmt->variable);
+        child(assign_stmt, assign_stmt->expression);
+        self()->leave(assign_stmt);
+    }
+    void descend(IfStatement *if_statement) {
+        if (!self()->enter(if_statement))
+            return;
+        child(if_statement, if_statement->expression);
+        child(if_statement, if_statement->statement);
+        if (if_statement->else_statement)
+            child(if_statement, if_statement->else_statement);
+        self()->leave(if_statement);
+    }
+    void descend(NestedScope *ns) {
+        if (!self()->enter(ns))
+            return;
+        child(ns, ns->scope);
+        self()->leave(ns);
+    }
+    void descend(EmptyStatement *es) {
+        if (self()->enter(es))
+            self()->leave(es);
+    }
+
+    void descend(ConstructorExpression *ce) {
+        if (!self()->enter(ce))
+            return;
+        child(ce, ce->constructor);
+        self()->leave(ce);
+    }
+    void descend(FloatLiteralExpression *fle) {
+        if (self()->enter(fle))
+            self()->leave(fle);
+    }
+    void descend(BoolLiteralExpression *ble) {
+        if (self()->enter(ble))
+            self()->leave(ble);
+    }
+    void descend(IntLiteralExpression *ile) {
+        if (self()->enter(ile))
+            self()->leave(ile);
+    }
+    void descend(UnaryExpression *ue) {
+        if (!self()->enter(ue))
+            return;
+        child(ue, ue->right_expression);
+        self()->leave(ue);
+    }
+    void descend(BinaryExpression *be) {
+        if (!self()->enter(be))
+            return;
+        child(be, be->left_expression);
+        child(be, be->right_expression);
+        self()->leave(be);
+    }
+    void descend(VariableExpression *ve) {
+        if (!self()->enter(ve))
+            return;
+        child(ve, ve->id_node);
+        self()->leave(ve);
+    }
+    void descend(FunctionExpression *fe) {
+        if (!self()->enter(fe))
+            return;
+        child(fe, fe->function);
+        self()->leave(fe);
+    }
+
+    void descend(Function *func) {
+        if (!self()->enter(func))
+            return;
+        child(func, func->arguments);
+        self()->leave(func);
+    }
+    void descend(Constructor *ct) {
+        if (!self()->enter(ct))
+            return;
+        child(ct, ct->type);
+        child(ct, ct->args);
+        self()->leave(ct);
+    }
+    /* A call without arguments has a null one */
+    void descend(Arguments *args) {
+        if (!self()->enter(args))
+            return;
+        for (Expression *expr : args->get_expression_list())
+            if (expr != nullptr)
+                child(args, expr);
+        self()->leave(args);
+    }
+    void descend(IdentifierNode *var) {
+        if (self()->enter(var))
+            self()->leave(var);
+    }
+    void descend(VectorVariable *vec_var) {
+        if (self()->enter(vec_var))
+            self()->leave(vec_var);
+    }
 
+    /*---------------------- The walk with a stack of its own ----------------------*/
+    /* The child of node at next or after it, null past the last; next is
+     * moved past the child. The children are those descend() walks. */
+    static ALWAYS_INLINE Node *next_child(Node *node, uint32_t &next) {
+        switch (node->get_tag()) {
+        case SCOPE_TAG: {
+            Scope *scope = static_cast<Scope *>(node);
+            switch (next++) {
+            case 0: return scope->declarations;
+            case 1: return scope->statements;
+            }
+            return nullptr;
+        }
+        case DECLARATIONS_TAG: {
+            const NodeList<Declaration *> &list = static_cast<Declarations *>(node)->declaration_list;
+            return next < list.size() ? list[next++] : nullptr;
+        }
+        case DECLARATION_TAG: {
+            Declaration *decl = static_cast<Declaration *>(node);
+            switch (next++) {
+            case 0: return decl->type;
+            case 1: return decl->initial_val;
+            }
+            return nullptr;
+        }
+        case STATEMENTS_TAG: {
+            const NodeList<Statement *> &list = static_cast<Statements *>(node)->get_statement_list();
+            return next < list.size() ? list[next++] : nullptr;
+        }
+        case ASSIGN_STATEMENT_TAG: {
+            AssignStatement *assign_stmt = static_cast<AssignStatement *>(node);
+            switch (next++) {
+            case 0: return assign_stmt->variable;
+            case 1: return assign_stmt->expression;
+            }
+            return nullptr;
+        }
+        case IF_STATEMENT_TAG: {
+            IfStatement *if_statement = static_cast<IfStatement *>(node);
+            switch (next++) {
+            case 0: return if_statement->expression;
+            case 1: return if_statement->statement;
+            case 2: return if_statement->else_statement;
+            }
+            return nullptr;
+        }
+        case NESTED_SCOPE_TAG:
+            return next++ == 0 ? static_cast<NestedScope *>(node)->scope : nullptr;
+        case CONSTRUCTOR_EXPRESSION_TAG:
+            return next++ == 0 ? static_cast<ConstructorExpression *>(node)->constructor : nullptr;
+        case UNARY_EXPRESSION_TAG:
+            return next++ == 0 ? static_cast<UnaryExpression *>(node)->right_expression : nullptr;
+        case BINARY_EXPRESSION_TAG: {
+            BinaryExpression *be = static_cast<BinaryExpression *>(node);
+            switch (next++) {
+            case 0: return be->left_expression;
+            case 1: return be->right_expression;
+            }
+            return nullptr;
+        }
+        case VARIABLE_EXPRESSION_TAG:
+            return next++ == 0 ? static_cast<VariableExpression *>(node)->id_node : nullptr;
+        case FUNCTION_EXPRESSION_TAG:
+            return next++ == 0 ? static_cast<FunctionExpression *>(node)->function : nullptr;
+        case FUNCTION_TAG:
+            return next++ == 0 ? static_cast<Function *>(node)->arguments : nullptr;
+        case CONSTRUCTOR_TAG: {
+            Constructor *ct = static_cast<Constructor *>(node);
+            switch (next++) {
+            case 0: return ct->type;
+            case 1: return ct->args;
+            }
+            return nullptr;
+        }
+        case ARGUMENTS_TAG: {
+            const NodeList<Expression *> &list = static_cast<Arguments *>(node)->get_expression_list();
+            while (next < list.size())
+                if (Expression *expr = list[next++])
+                    return expr;
+            return nullptr;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    ALWAYS_INLINE bool enter_node(Node *node) {
+        switch (node->get_tag()) {
+        case SCOPE_TAG: return self()->enter(static_cast<Scope *>(node));
+        case DECLARATIONS_TAG: return self()->enter(static_cast<Declarations *>(node));
+        case DECLARATION_TAG: return self()->enter(static_cast<Declaration *>(node));
+        case TYPE_TAG: return self()->enter(static_cast<Type *>(node));
+        case STATEMENTS_TAG: return self()->enter(static_cast<Statements *>(node));
+        case ASSIGN_STATEMENT_TAG: return self()->enter(static_cast<AssignStatement *>(node));
+        case IF_STATEMENT_TAG: return self()->enter(static_cast<IfStatement *>(node));
+        case NESTED_SCOPE_TAG: return self()->enter(static_cast<NestedScope *>(node));
+        case EMPTY_STATEMENT_TAG: return self()->enter(static_cast<EmptyStatement *>(node));
+        case CONSTRUCTOR_EXPRESSION_TAG: return self()->enter(static_cast<ConstructorExpression *>(node));
+        case FLOAT_LITERAL_TAG: return self()->enter(static_cast<FloatLiteralExpression *>(node));
+        case BOOL_LITERAL_TAG: return self()->enter(static_cast<BoolLiteralExpression *>(node));
+        case INT_LITERAL_TAG: return self()->enter(static_cast<IntLiteralExpression *>(node));
+        case UNARY_EXPRESSION_TAG: return self()->enter(static_cast<UnaryExpression *>(node));
+        case BINARY_EXPRESSION_TAG: return self()->enter(static_cast<BinaryExpression *>(node));
+        case VARIABLE_EXPRESSION_TAG: return self()->enter(static_cast<VariableExpression *>(node));
+        case FUNCTION_EXPRESSION_TAG: return self()->enter(static_cast<FunctionExpression *>(node));
+        case FUNCTION_TAG: return self()->enter(static_cast<Function *>(node));
+        case CONSTRUCTOR_TAG: return self()->enter(static_cast<Constructor *>(node));
+        case ARGUMENTS_TAG: return self()->enter(static_cast<Arguments *>(node));
+        case IDENTIFIER_TAG: return self()->enter(static_cast<IdentifierNode *>(node));
+        case VECTOR_VARIABLE_TAG: return self()->enter(static_cast<VectorVariable *>(node));
+        }
+        assert(0);
+        return false;
+    }
 
-node *ast_allocate(NodeKind type, ...);
-void ast_print(node *ast_root);
-void ast_free(node *ast_root);
+    ALWAYS_INLINE void leave_node(Node *node) {
+        switch (node->get_tag()) {
+        case SCOPE_TAG: self()->leave(static_cast<Scope *>(node)); break;
+        case DECLARATIONS_TAG: self()->leave(static_cast<Declarations *>(node)); break;
+        case DECLARATION_TAG: self()->leave(static_cast<Declaration *>(node)); break;
+        case TYPE_TAG: self()->leave(static_cast<Type *>(node)); break;
+        case STATEMENTS_TAG: self()->leave(static_cast<Statements *>(node)); break;
+        case ASSIGN_STATEMENT_TAG: self()->leave(static_cast<AssignStatement *>(node)); break;
+        case IF_STATEMENT_TAG: self()->leave(static_cast<IfStatement *>(node)); break;
+        case NESTED_SCOPE_TAG: self()->leave(static_cast<NestedScope *>(node)); break;
+        case EMPTY_STATEMENT_TAG: self()->leave(static_cast<EmptyStatement *>(node)); break;
+        case CONSTRUCTOR_EXPRESSION_TAG: self()->leave(static_cast<ConstructorExpression *>(node)); break;
+        case FLOAT_LITERAL_TAG: self()->leave(static_cast<FloatLiteralExpression *>(node)); break;
+        case BOOL_LITERAL_TAG: self()->leave(static_cast<BoolLiteralExpression *>(node)); break;
+        case INT_LITERAL_TAG: self()->leave(static_cast<IntLiteralExpression *>(node)); break;
+        case UNARY_EXPRESSION_TAG: self()->leave(static_cast<UnaryExpression *>(node)); break;
+        case BINARY_EXPRESSION_TAG: self()->leave(static_cast<BinaryExpression *>(node)); break;
+        case VARIABLE_EXPRESSION_TAG: self()->leave(static_cast<VariableExpression *>(node)); break;
+        case FUNCTION_EXPRESSION_TAG: self()->leave(static_cast<FunctionExpression *>(node)); break;
+        case FUNCTION_TAG: self()->leave(static_cast<Function *>(node)); break;
+        case CONSTRUCTOR_TAG: self()->leave(static_cast<Constructor *>(node)); break;
+        case ARGUMENTS_TAG: self()->leave(static_cast<Arguments *>(node)); break;
+        case IDENTIFIER_TAG: self()->leave(static_cast<IdentifierNode *>(node)); break;
+        case VECTOR_VARIABLE_TAG: self()->leave(static_cast<VectorVariable *>(node)); break;
+        }
+    }
 
-int get_type_dimension (const std::string &type);
+    void walk_deep(Node *root) {
+        size_t base = m_stack.size();
+        if (!enter_node(root))
+            return;
+        m_stack.push_back({root, 0});
+        while (m_stack.size() > base) {
+            /* A hook can walk on the stack as well, so the top is only
+             * used before the hooks are called */
+            Node *parent = m_stack.back().node;
+            Node *node = next_child(parent, m_stack.back().next);
+            if (node) {
+                if (enter_node(node)) {
+                    m_stack.push_back({node, 0});
+                    continue;
+                }
+                self()->after_child(parent, node);
+            }
+            else {
+                m_stack.pop_back();
+                leave_node(parent);
+                if (m_stack.size() > base)
+                    self()->after_child(m_stack.back().node, parent);
+            }
+        }
+    }
 
+  public:
+    template <class T> bool enter(T *node) {return true;}
+    template <class T> void leave(T *node) {}
+    void after_child(Node *parent, Node *child) {}
+
+    /* Walk the tree under root, which can be any node */
+    void walk(Node *root) {
+        switch (root->get_tag()) {
+        case SCOPE_TAG: descend(static_cast<Scope *>(root)); break;
+        case DECLARATIONS_TAG: descend(static_cast<Declarations *>(root)); break;
+        case DECLARATION_TAG: descend(static_cast<Declaration *>(root)); break;
+        case TYPE_TAG: descend(static_cast<Type *>(root)); break;
+        case STATEMENTS_TAG: descend(static_cast<Statements *>(root)); break;
+        case FUNCTION_TAG: descend(static_cast<Function *>(root)); break;
+        case CONSTRUCTOR_TAG: descend(static_cast<Constructor *>(root)); break;
+        case ARGUMENTS_TAG: descend(static_cast<Arguments *>(root)); break;
+        case ASSIGN_STATEMENT_TAG: case IF_STATEMENT_TAG: case NESTED_SCOPE_TAG: case EMPTY_STATEMENT_TAG:
+            dispatch(static_cast<Statement *>(root));
+            break;
+        case IDENTIFIER_TAG: case VECTOR_VARIABLE_TAG:
+            dispatch(static_cast<IdentifierNode *>(root));
+            break;
+        default:
+            dispatch(static_cast<Expression *>(root));
+        }
+    }
+};
 
-std::string get_base_type (const std::string type);
 
+/* A node from arena, which the tree is released with */
+node *ast_allocate(Arena *arena, NodeKind type, ...);
+void ast_print(node *ast_root, FILE *dump_file);
+int  ast_count_nodes(node *ast_root);
 
 #endif /* AST_H_ */
@@ -0,0 +1,52 @@
+"""Measure how batch compilation scales with -j.
+
+Generates a batch of shaders of uneven sizes, then compiles it with
+`compiler467 -j T` for T = 1 .. max threads and reports the best wall
+time of several runs and the speedup over one job.
+
+usage: python3 batch_scaling.py [--compiler PATH] [--sources N]
+                                [--threads T] [--repeat R]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import shadergen
+
+
+def run_batch(compiler, response, jobs):
+    start = time.perf_counter()
+    subprocess.run([compiler, "-j", str(jobs), "@" + response],
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                   check=True)
+    return time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "compiler467"))
+    parser.add_argument("--sources", type=int, default=256)
+    parser.add_argument("--threads", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        response = shadergen.write_batch(directory, args.sources)
+        print("%d sources, best of %d runs" % (args.sources, args.repeat))
+        print("%7s %10s %8s" % ("threads", "seconds", "speedup"))
+        baseline = None
+        for jobs in range(1, args.threads + 1):
+            best = min(run_batch(args.compiler, response, jobs)
+                       for _ in range(args.repeat))
+            baseline = baseline or best
+            print("%7d %10.3f %7.2fx" % (jobs, best, baseline / best))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
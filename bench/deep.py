@@ -0,0 +1,74 @@
+"""Time the phases of compiles of very deep expressions.
+
+Generates shaders whose one expression sums a growing number of terms,
+a left-deep tree as many levels deep, and compiles each with
+`compiler467 -X -Tt`: as it is, with -P for the hand written parser and
+with -L for code generation over a FlatTree. Parse, check (symbol table
+and type check), code generation (the translation over the tree, or
+flattening and translation) and the release of the tree are reported,
+from the best of several runs; a compile that crashes stops the run.
+
+usage: python3 deep.py [--compiler PATH] [--terms N,N,...] [--repeat R]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+import shadergen
+
+
+def phase_times(compiler, options, source):
+    """Return {phase: wall ms} of one compile of source."""
+    result = subprocess.run([compiler, "-X", "-Tt"] + options + [source],
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            universal_newlines=True)
+    if result.returncode != 0:
+        sys.exit("%s %s failed on %s (exit status %d)"
+                 % (compiler, " ".join(options), os.path.basename(source), result.returncode))
+    times = {}
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if fields[:1] == ["TIMING"] and fields[1] != "phase":
+            times[fields[1]] = float(fields[2])
+    if "free" not in times:
+        sys.exit("%s printed no -Tt report" % compiler)
+    return times
+
+
+def best(compiler, options, source, repeat):
+    """Return (parse, check, codegen, free) ms, each the best of repeat runs."""
+    runs = [phase_times(compiler, options, source) for _ in range(repeat)]
+    return (min(run["parse"] for run in runs),
+            min(run["symbol"] + run["typecheck"] for run in runs),
+            min(run["flatten"] + run["codegen"] for run in runs),
+            min(run["free"] for run in runs))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "compiler467"))
+    parser.add_argument("--terms", default="1000,10000,100000")
+    parser.add_argument("--repeat", type=int, default=5)
+    args = parser.parse_args()
+
+    print("best of %d runs, times in ms" % args.repeat)
+    print("%7s %8s %9s %9s %9s %9s %9s" % ("terms", "options", "parse", "check", "codegen", "free", "total"))
+    with tempfile.TemporaryDirectory() as directory:
+        for terms in [int(t) for t in args.terms.split(",")]:
+            source = os.path.join(directory, "chain%d.frag" % terms)
+            with open(source, "w") as f:
+                f.write(shadergen.chain(terms))
+
+            for options in ([], ["-P"], ["-L"]):
+                times = best(args.compiler, options, source, args.repeat)
+                print("%7d %8s %9.3f %9.3f %9.3f %9.3f %9.3f"
+                      % ((terms, " ".join(options) or "-") + times + (sum(times),)))
+                sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
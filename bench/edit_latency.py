@@ -0,0 +1,113 @@
+"""Compare the latency of compiling an edit (-W) with a full compile.
+
+A generated shader of each size is edited the way an artist tweaks one:
+a constant changed, a statement added to a lighting block, one taken
+out again. The edits go to the compiler as one -W file, and -Tt gives
+the time from each edit to its program, along with how much of the
+source it parsed and checked again. The full compile is the wall time
+of compiling the source from scratch without -Tt, less that of
+compiling an empty shader, which is the cost of starting the compiler;
+each is the best of several runs.
+
+usage: python3 edit_latency.py --compiler PATH [--lines N,N,...]
+                               [--edits E] [--repeat R]
+"""
+
+import argparse
+import os
+import random
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import shadergen
+
+EDIT_PATTERN = re.compile(r"EDIT \d+: ([\d.]+) ms, (\d+) bytes parsed( \(all\))?, "
+                          r"(\d+) of (\d+) parts checked")
+ADDED = "\n         shade = shade * tint;"
+
+
+def make_edits(text, count, rng):
+    """Return count (offset, removed, inserted) edits, each of the text
+    the ones before it left"""
+    edits = []
+    for i in range(count):
+        if i % 3 == 0:
+            numbers = list(re.finditer(r"gain = (\d+\.\d+)", text))
+            match = rng.choice(numbers)
+            edit = (match.start(1), len(match.group(1)), "%.2f" % rng.random())
+        elif i % 3 == 1:
+            ends = [m.end() for m in re.finditer(r"coeff = lit\(coeff\);", text)]
+            edit = (rng.choice(ends), 0, ADDED)
+        else:
+            offset = text.find(ADDED)
+            edit = (offset, len(ADDED), "")
+        offset, removed, inserted = edit
+        text = text[:offset] + inserted + text[offset + removed:]
+        edits.append(edit)
+    return edits
+
+
+def wall_ms(compiler, source, repeat):
+    """Best wall time of compiling source from scratch"""
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        subprocess.run([compiler, "-X", source], stdin=subprocess.DEVNULL,
+                       stdout=subprocess.DEVNULL, check=True)
+        elapsed = (time.perf_counter() - start) * 1000
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", required=True, help="compiler467 to run")
+    parser.add_argument("--lines", default="1000,10000,50000")
+    parser.add_argument("--edits", type=int, default=30)
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    rng = random.Random(467)
+    lines_per_block = shadergen.BLOCK.count("\n")
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "shader.frag")
+        edit_file = os.path.join(directory, "edits")
+        trace_file = os.path.join(directory, "trace")
+        empty = os.path.join(directory, "empty.frag")
+        with open(empty, "w") as f:
+            f.write("{\n}\n")
+        startup = wall_ms(args.compiler, empty, args.repeat)
+        print("%8s %10s %10s %8s %12s %14s" % ("lines", "full ms", "edit ms",
+                                               "speedup", "parsed bytes",
+                                               "checked parts"))
+        for lines in args.lines.split(","):
+            text = shadergen.shader(max(1, int(lines) // lines_per_block))
+            with open(source, "w") as f:
+                f.write(text)
+            with open(edit_file, "w") as f:
+                for offset, removed, inserted in make_edits(text, args.edits, rng):
+                    f.write("%d %d %d\n%s" % (offset, removed, len(inserted), inserted))
+
+            full = wall_ms(args.compiler, source, args.repeat) - startup
+            subprocess.run([args.compiler, "-X", "-W", edit_file, "-Tt", "-R", trace_file, source],
+                           stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL, check=True)
+            with open(trace_file) as f:
+                edits = [EDIT_PATTERN.match(line) for line in f if line.startswith("EDIT")]
+            if len(edits) != args.edits or any(edit is None or edit.group(3) for edit in edits):
+                sys.exit("%s did not compile every edit in part" % args.compiler)
+            print("%8d %10.3f %10.3f %7.1fx %12d %9d/%d"
+                  % (text.count("\n"), full,
+                     statistics.median(float(edit.group(1)) for edit in edits),
+                     full / statistics.median(float(edit.group(1)) for edit in edits),
+                     statistics.median(int(edit.group(2)) for edit in edits),
+                     statistics.median(int(edit.group(4)) for edit in edits),
+                     int(edits[-1].group(5))))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+"""Compare a normal compile with a fast one (-F) in time and memory.
+
+The compiler is run over generated shaders of several megabytes, once as
+it is and once with -F. For each the wall time of the whole run and the
+peak resident set size of the process are reported; the best of several
+runs is kept.
+
+usage: python3 fast_compile.py --compiler PATH
+                               [--sizes MB,MB,...] [--repeat R]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import shadergen
+
+
+def run(compiler, options, source):
+    """Return (wall seconds, peak KiB) of one compile of source."""
+    start = time.perf_counter()
+    process = subprocess.Popen([compiler, "-X"] + options + [source],
+                               stdin=subprocess.DEVNULL,
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+    _, status, usage = os.wait4(process.pid, 0)
+    seconds = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode:
+        sys.exit("%s failed on %s" % (compiler, source))
+    return seconds, usage.ru_maxrss
+
+
+def write_shader(directory, megabytes):
+    """Write a shader of about `megabytes` MiB, return its path."""
+    per_block = len(shadergen.shader(11)) - len(shadergen.shader(10))
+    blocks = int(megabytes * 1024 * 1024 / per_block)
+    path = os.path.join(directory, "shader%gmb.frag" % megabytes)
+    with open(path, "w") as f:
+        f.write(shadergen.shader(blocks))
+    return path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", required=True, help="compiler467 to run")
+    parser.add_argument("--sizes", default="1,4,16")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        print("best of %d runs" % args.repeat)
+        print("%6s %10s %10s %8s %12s %12s" % ("MiB", "normal s", "fast s",
+                                               "speedup", "normal KiB",
+                                               "fast KiB"))
+        for size in args.sizes.split(","):
+            source = write_shader(directory, float(size))
+            results = []
+            for options in ([], ["-F"]):
+                runs = [run(args.compiler, options, source)
+                        for _ in range(args.repeat)]
+                results.append((min(seconds for seconds, _ in runs),
+                                min(peak for _, peak in runs)))
+            (normal, normal_peak), (fast, fast_peak) = results
+            print("%6s %10.3f %10.3f %7.2fx %12d %12d"
+                  % (size, normal, fast, normal / fast, normal_peak,
+                     fast_peak))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+"""Measure what sharing a header through #include costs a batch.
+
+Generates a large header of declarations and a batch of shaders that
+each include it, and the same batch with the header pasted into every
+shader. Both are compiled with `compiler467 -j T -Tc` and the best wall
+time of several runs is reported, with how often the header was scanned
+and how often the include cache reused it.
+
+usage: python3 include_cache.py [--compiler PATH] [--sources N]
+                                [--header-lines L] [--threads T]
+                                [--repeat R]
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+import shadergen
+
+
+def header(lines):
+    """Return the text of a header of `lines` declarations."""
+    return "".join("   const vec4 lib%d = vec4(%d.0,0.5,0.25,1.0);\n" % (i, i % 100)
+                   for i in range(lines))
+
+
+def write_batch(directory, count, text, include):
+    """Write `count` shaders that include the header or paste `text` in,
+    and a response file listing them. Returns the response file."""
+    os.makedirs(directory, exist_ok=True)
+    names = []
+    for i in range(count):
+        shader = shadergen.shader(2, seed=i)
+        shared = '#include "../lib.h"\n' if include else text
+        name = os.path.join(directory, "shader%04d.frag" % i)
+        with open(name, "w") as f:
+            f.write(shader.replace("{\n", "{\n" + shared, 1))
+        names.append(name)
+    response = os.path.join(directory, "batch.txt")
+    with open(response, "w") as f:
+        f.write("\n".join(names) + "\n")
+    return response
+
+
+def run_batch(compiler, response, jobs):
+    start = time.perf_counter()
+    result = subprocess.run([compiler, "-j", str(jobs), "-Tc", "@" + response],
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            universal_newlines=True, check=True)
+    elapsed = time.perf_counter() - start
+    match = re.search(r"INCLUDES: (\d+) scanned, (\d+) reused", result.stdout)
+    return elapsed, match.groups() if match else ("-", "-")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "compiler467"))
+    parser.add_argument("--sources", type=int, default=256)
+    parser.add_argument("--header-lines", type=int, default=2000)
+    parser.add_argument("--threads", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        text = header(args.header_lines)
+        with open(os.path.join(directory, "lib.h"), "w") as f:
+            f.write(text)
+        batches = [("pasted", write_batch(os.path.join(directory, "pasted"),
+                                          args.sources, text, False)),
+                   ("included", write_batch(os.path.join(directory, "included"),
+                                            args.sources, text, True))]
+
+        print("%d sources, %d header lines, best of %d runs"
+              % (args.sources, args.header_lines, args.repeat))
+        print("%8s %7s %10s %8s %8s" % ("batch", "threads", "seconds", "scanned", "reused"))
+        for jobs in sorted({1, args.threads}):
+            for label, response in batches:
+                runs = [run_batch(args.compiler, response, jobs) for _ in range(args.repeat)]
+                best, counts = min(runs)
+                print("%8s %7d %10.3f %8s %8s" % (label, jobs, best, counts[0], counts[1]))
+                sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,77 @@
+"""Compare the scanning speed of the flex and hand written lexers.
+
+Build the compiler twice, once as usual and once with `make LEXER=hand`,
+and pass both binaries. Each is run with -Tt over generated shaders of
+several megabytes. -Tt times the scanner alone, in a pass over the
+source ahead of the parse with no clock read per token, so its scan
+phase time and the token count it reports give tokens per second. The
+best of several runs is kept.
+
+usage: python3 lexer_throughput.py --flex PATH --hand PATH
+                                   [--sizes MB,MB,...] [--repeat R]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+import shadergen
+
+
+def scan_rate(compiler, source):
+    """Return (tokens, scan seconds) of one compile of source."""
+    result = subprocess.run([compiler, "-X", "-Tt", source], stdout=subprocess.PIPE,
+                            stderr=subprocess.DEVNULL, check=True,
+                            universal_newlines=True)
+    tokens = seconds = None
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if fields[:2] == ["TIMING", "scan"]:
+            seconds = float(fields[2]) / 1000
+        elif fields[:1] == ["COUNTS"]:
+            tokens = int(fields[1])
+    if tokens is None or seconds is None:
+        sys.exit("%s printed no -Tt report" % compiler)
+    return tokens, seconds
+
+
+def write_shader(directory, megabytes):
+    """Write a shader of about `megabytes` MiB, return its path."""
+    per_block = len(shadergen.shader(11)) - len(shadergen.shader(10))
+    blocks = int(megabytes * 1024 * 1024 / per_block)
+    path = os.path.join(directory, "shader%gmb.frag" % megabytes)
+    with open(path, "w") as f:
+        f.write(shadergen.shader(blocks))
+    return path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--flex", required=True,
+                        help="compiler467 built with the flex scanner")
+    parser.add_argument("--hand", required=True,
+                        help="compiler467 built with make LEXER=hand")
+    parser.add_argument("--sizes", default="1,4,16")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        print("best of %d runs" % args.repeat)
+        print("%6s %10s %14s %14s %8s" % ("MiB", "tokens", "flex tok/s",
+                                          "hand tok/s", "speedup"))
+        for size in args.sizes.split(","):
+            source = write_shader(directory, float(size))
+            rates = []
+            for compiler in (args.flex, args.hand):
+                runs = [scan_rate(compiler, source) for _ in range(args.repeat)]
+                tokens = runs[0][0]
+                rates.append(tokens / min(seconds for _, seconds in runs))
+            print("%6s %10d %14.0f %14.0f %7.2fx"
+                  % (size, tokens, rates[0], rates[1], rates[1] / rates[0]))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
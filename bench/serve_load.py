@@ -0,0 +1,169 @@
+"""Load generator for the compile server.
+
+Starts `compiler467 --serve`, opens several client connections that each
+send a stream of small compile requests, and reports request latency
+percentiles and throughput. It does so once for plain sources and once
+for sources that each include a shared header, which the server reads
+once and keeps. For comparison it also times spawning one compiler467
+process per source.
+
+usage: python3 serve_load.py [--compiler PATH] [--clients C]
+                             [--requests N] [--header-lines L]
+                             [--spawns S]
+"""
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+
+import shadergen
+
+U32 = struct.Struct("=I")
+
+
+def read_exact(sock, length):
+    data = bytearray()
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        data += chunk
+    return bytes(data)
+
+
+def read_u32(sock):
+    return U32.unpack(read_exact(sock, U32.size))[0]
+
+
+def compile_remote(sock, source):
+    """Send one request, return (success, program, diagnostic count)."""
+    sock.sendall(U32.pack(len(source)) + source)
+    success = read_u32(sock)
+    program = read_exact(sock, read_u32(sock))
+    count = read_u32(sock)
+    for _ in range(count):
+        read_exact(sock, 3 * U32.size)  # phase, line, column
+        read_exact(sock, read_u32(sock))
+    return success, program, count
+
+
+def wait_for_socket(path, timeout=5.0):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            sock.connect(path)
+            return sock
+        except OSError:
+            sock.close()
+            time.sleep(0.01)
+    raise RuntimeError("server did not start")
+
+
+def client(path, sources, latencies, errors):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    for source in sources:
+        start = time.perf_counter()
+        success, _, _ = compile_remote(sock, source)
+        latencies.append(time.perf_counter() - start)
+        if not success:
+            errors.append(source)
+    sock.close()
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def header(lines):
+    """Return the text of a header of `lines` declarations."""
+    return "".join("   const vec4 lib%d = vec4(%d.0,0.5,0.25,1.0);\n" % (i, i % 100)
+                   for i in range(lines))
+
+
+def run_load(path, sources, clients, requests):
+    """Send `requests` sources on each of `clients` connections at once.
+    Returns (latencies, errors, elapsed)."""
+    latencies, errors, threads = [], [], []
+    start = time.perf_counter()
+    for c in range(clients):
+        stream = [sources[(c + i) % len(sources)] for i in range(requests)]
+        threads.append(threading.Thread(
+            target=client, args=(path, stream, latencies, errors)))
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return latencies, errors, time.perf_counter() - start
+
+
+def report(label, clients, requests, load):
+    latencies, errors, elapsed = load
+    print("%s: %d clients x %d requests, %d failed"
+          % (label, clients, requests, len(errors)))
+    print("  latency p50 %8.1f us  p99 %8.1f us"
+          % (percentile(latencies, 0.50) * 1e6,
+             percentile(latencies, 0.99) * 1e6))
+    print("  throughput %10.0f compiles/s" % (len(latencies) / elapsed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "compiler467"))
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--requests", type=int, default=5000,
+                        help="requests per client")
+    parser.add_argument("--header-lines", type=int, default=1000,
+                        help="declarations in the included header")
+    parser.add_argument("--spawns", type=int, default=200,
+                        help="process spawns for the comparison")
+    args = parser.parse_args()
+
+    sources = [shadergen.shader(1, seed=i).encode() for i in range(64)]
+
+    with tempfile.TemporaryDirectory() as directory:
+        # The server resolves includes from its own working directory,
+        # so the sources name the header by its absolute path
+        lib = os.path.join(directory, "lib.h")
+        with open(lib, "w") as f:
+            f.write(header(args.header_lines))
+        line = '#include "%s"\n' % lib
+        including = [shadergen.shader(1, seed=i).replace("{\n", "{\n" + line, 1).encode()
+                     for i in range(64)]
+
+        path = os.path.join(directory, "compiler467.sock")
+        server = subprocess.Popen([args.compiler, "--serve", path])
+        try:
+            wait_for_socket(path).close()
+            plain = run_load(path, sources, args.clients, args.requests)
+            included = run_load(path, including, args.clients, args.requests)
+        finally:
+            server.terminate()
+            server.wait()
+
+        report("server", args.clients, args.requests, plain)
+        report("server, %d line include" % args.header_lines,
+               args.clients, args.requests, included)
+
+        name = os.path.join(directory, "shader.frag")
+        with open(name, "wb") as f:
+            f.write(sources[0])
+        start = time.perf_counter()
+        for _ in range(args.spawns):
+            subprocess.run([args.compiler, name], stdout=subprocess.DEVNULL,
+                           stderr=subprocess.DEVNULL, check=True)
+        per_spawn = (time.perf_counter() - start) / args.spawns
+        print("spawn:  %d processes" % args.spawns)
+        print("  latency mean %7.1f us" % (per_spawn * 1e6))
+
+
+if __name__ == "__main__":
+    main()
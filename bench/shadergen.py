@@ -0,0 +1,102 @@
+"""Generate MiniGLSL shaders for the benchmarks.
+
+A shader is a variation of the Demo2 phong shader: a prologue of
+declarations followed by `blocks` lighting blocks, each in its own scope
+so declarations never clash; or, from chain(), the other kind of shader
+generators emit, a single expression of many terms. The text only
+depends on the arguments, so runs are comparable across builds.
+"""
+
+import os
+import random
+
+PROLOGUE = """{
+   vec4 fCol = gl_Color;
+   vec4 fTex = gl_TexCoord;
+   vec4 eyeNorm;
+   vec4 coeff;
+   vec4 shade;
+   const vec4 lVec = env1;
+   const vec4 lHalf = gl_Light_Half;
+   eyeNorm = fTex;
+   eyeNorm[3] = dp3(eyeNorm,eyeNorm);
+   eyeNorm[3] = rsq(eyeNorm[3]);
+   eyeNorm = eyeNorm * eyeNorm[3];
+   shade = gl_Light_Ambient * fCol;
+"""
+
+BLOCK = """   {{
+      vec4 tint = vec4({r},{g},{b},1.0);
+      float gain = {gain};
+      coeff[0] = dp3(lVec,eyeNorm);
+      coeff[1] = dp3(lHalf,eyeNorm);
+      coeff[3] = gl_Material_Shininess[0];
+      coeff = lit(coeff);
+      if (coeff[1] > gain) {{
+         shade = shade + coeff[1] * fCol * tint;
+      }} else {{
+         shade = shade + coeff[2] * fCol - tint * gain;
+      }}
+   }}
+"""
+
+EPILOGUE = """   gl_FragColor = shade;
+}
+"""
+
+
+def shader(blocks, seed=0):
+    """Return the text of a shader with `blocks` lighting blocks."""
+    rng = random.Random(seed)
+    parts = [PROLOGUE]
+    for _ in range(blocks):
+        parts.append(BLOCK.format(r=_number(rng), g=_number(rng),
+                                  b=_number(rng), gain=_number(rng)))
+    parts.append(EPILOGUE)
+    return "".join(parts)
+
+
+def chain(terms, seed=0):
+    """Return the text of a shader that sums `terms` terms in one
+    expression, a + b + c + ..., which parses to a left-deep tree
+    `terms` levels deep."""
+    rng = random.Random(seed)
+    choices = ["fCol", "fTex", "fCol * gain", None]
+    parts = []
+    for _ in range(terms):
+        term = rng.choice(choices)
+        parts.append(term if term else "fTex * " + _number(rng))
+    return ("{\n"
+            "   vec4 fCol = gl_Color;\n"
+            "   vec4 fTex = gl_TexCoord;\n"
+            "   float gain = 0.5;\n"
+            "   vec4 shade;\n"
+            "   shade = " + " + ".join(parts) + ";\n"
+            "   gl_FragColor = shade;\n"
+            "}\n")
+
+
+def write_batch(directory, count, small_blocks=2, large_blocks=400,
+                large_every=8):
+    """Write `count` shaders into `directory` and a response file listing
+    them. Every `large_every`-th shader is large, the others small, so
+    the batch has the uneven job sizes of a real shader library.
+
+    Returns the path of the response file.
+    """
+    os.makedirs(directory, exist_ok=True)
+    names = []
+    for i in range(count):
+        blocks = large_blocks if i % large_every == 0 else small_blocks
+        name = os.path.join(directory, "shader%04d.frag" % i)
+        with open(name, "w") as f:
+            f.write(shader(blocks, seed=i))
+        names.append(name)
+    response = os.path.join(directory, "batch.txt")
+    with open(response, "w") as f:
+        f.write("\n".join(names) + "\n")
+    return response
+
+
+def _number(rng):
+    return "%.2f" % rng.uniform(0.0, 1.0)
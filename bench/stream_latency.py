@@ -0,0 +1,80 @@
+"""Measure what parsing a piped source as it arrives saves.
+
+A generated shader is gzipped, then compiled two ways: decompressed to a
+file first and compiled from there, and decompressed straight into the
+compiler through a pipe, which the compiler parses piece by piece while
+gzip is still writing. Both times cover decompression and compilation.
+The best of several runs is kept.
+
+usage: python3 stream_latency.py --compiler PATH [--sizes MB,MB,...]
+                                 [--repeat R]
+"""
+
+import argparse
+import gzip
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import shadergen
+
+
+def write_shader(directory, megabytes):
+    """Write a gzipped shader of about `megabytes` MiB, return its path."""
+    per_block = len(shadergen.shader(11)) - len(shadergen.shader(10))
+    blocks = int(megabytes * 1024 * 1024 / per_block)
+    path = os.path.join(directory, "shader%gmb.frag.gz" % megabytes)
+    with gzip.open(path, "wt") as f:
+        f.write(shadergen.shader(blocks))
+    return path
+
+
+def whole(compiler, packed, directory):
+    """Seconds to decompress packed to a file and then compile it."""
+    source = os.path.join(directory, "whole.frag")
+    start = time.perf_counter()
+    with open(source, "wb") as out:
+        subprocess.run(["gzip", "-dc", packed], stdout=out, check=True)
+    subprocess.run([compiler, source], stdout=subprocess.DEVNULL, check=True)
+    return time.perf_counter() - start
+
+
+def streamed(compiler, packed):
+    """Seconds to decompress packed into the compiler through a pipe."""
+    start = time.perf_counter()
+    gunzip = subprocess.Popen(["gzip", "-dc", packed], stdout=subprocess.PIPE)
+    subprocess.run([compiler], stdin=gunzip.stdout, stdout=subprocess.DEVNULL,
+                   check=True)
+    gunzip.stdout.close()
+    if gunzip.wait() != 0:
+        sys.exit("gzip failed on %s" % packed)
+    return time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", required=True, help="compiler467 to run")
+    parser.add_argument("--sizes", default="1,4,16")
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        print("best of %d runs" % args.repeat)
+        print("%6s %10s %10s %8s" % ("MiB", "whole ms", "stream ms",
+                                     "speedup"))
+        for size in args.sizes.split(","):
+            packed = write_shader(directory, float(size))
+            best_whole = min(whole(args.compiler, packed, directory)
+                             for _ in range(args.repeat))
+            best_stream = min(streamed(args.compiler, packed)
+                              for _ in range(args.repeat))
+            print("%6s %10.1f %10.1f %7.2fx"
+                  % (size, best_whole * 1000, best_stream * 1000,
+                     best_whole / best_stream))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
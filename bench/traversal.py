@@ -0,0 +1,68 @@
+"""Compare code generation over the flattened AST with the node tree.
+
+Generates shaders of a growing number of lighting blocks and compiles
+each with `compiler467 -X -Tt`, once as it is, which visits the nodes
+of the checked tree, and once with -L, which lays the tree out in a
+FlatTree and translates that. The flatten and codegen phase times of
+the best of several runs are reported, with the number of AST nodes.
+
+usage: python3 traversal.py [--compiler PATH] [--blocks N,N,...]
+                            [--repeat R]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+import shadergen
+
+
+def phase_times(compiler, options, source):
+    """Return (nodes, flatten ms, codegen ms) of one compile of source."""
+    result = subprocess.run([compiler, "-X", "-Tt"] + options + [source],
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            check=True, universal_newlines=True)
+    nodes = flatten = codegen = None
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if fields[:2] == ["TIMING", "flatten"]:
+            flatten = float(fields[2])
+        elif fields[:2] == ["TIMING", "codegen"]:
+            codegen = float(fields[2])
+        elif fields[:1] == ["COUNTS"]:
+            nodes = int(fields[3])
+    if None in (nodes, flatten, codegen):
+        sys.exit("%s printed no -Tt report" % compiler)
+    return nodes, flatten, codegen
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "compiler467"))
+    parser.add_argument("--blocks", default="100,1000,10000")
+    parser.add_argument("--repeat", type=int, default=5)
+    args = parser.parse_args()
+
+    print("best of %d runs, times in ms" % args.repeat)
+    print("%7s %9s %10s %10s %10s %10s" % ("blocks", "nodes", "tree", "flatten", "flat", "flat+lay"))
+    with tempfile.TemporaryDirectory() as directory:
+        for blocks in [int(b) for b in args.blocks.split(",")]:
+            source = os.path.join(directory, "shader%d.frag" % blocks)
+            with open(source, "w") as f:
+                f.write(shadergen.shader(blocks))
+
+            tree = min(phase_times(args.compiler, [], source)[2] for _ in range(args.repeat))
+            runs = [phase_times(args.compiler, ["-L"], source) for _ in range(args.repeat)]
+            nodes = runs[0][0]
+            flatten = min(run[1] for run in runs)
+            flat = min(run[2] for run in runs)
+            total = min(run[1] + run[2] for run in runs)
+            print("%7d %9d %10.3f %10.3f %10.3f %10.3f" % (blocks, nodes, tree, flatten, flat, total))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "cache.h"
+#include "common.h"
+
+static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME  = 0x100000001b3ULL;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* MurmurHash64A, a second independent lane so the key is 128 bits */
+static uint64_t murmur64(const void *data, size_t length, uint64_t seed)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = seed ^ (length * m);
+
+    size_t blocks = length / 8;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t k;
+        memcpy(&k, bytes + i * 8, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        hash ^= k;
+        hash *= m;
+    }
+
+    const unsigned char *tail = bytes + blocks * 8;
+    switch (length & 7) {
+        case 7: hash ^= uint64_t(tail[6]) << 48; /* fall through */
+        case 6: hash ^= uint64_t(tail[5]) << 40; /* fall through */
+        case 5: hash ^= uint64_t(tail[4]) << 32; /* fall through */
+        case 4: hash ^= uint64_t(tail[3]) << 24; /* fall through */
+        case 3: hash ^= uint64_t(tail[2]) << 16; /* fall through */
+        case 2: hash ^= uint64_t(tail[1]) << 8;  /* fall through */
+        case 1: hash ^= uint64_t(tail[0]);
+                hash *= m;
+    }
+
+    hash ^= hash >> r;
+    hash *= m;
+    hash ^= hash >> r;
+    return hash;
+}
+
+static bool is_temp_name(const char *name)
+{
+    return strstr(name, ".tmp.") != NULL;
+}
+
+CompileCache::CompileCache(const std::string &directory, long max_bytes)
+    : m_directory(directory), m_max_bytes(max_bytes > 0 ? max_bytes : CACHE_DEFAULT_MAX_BYTES)
+{
+}
+
+bool CompileCache::open()
+{
+    if (mkdir(m_directory.c_str(), 0755) == 0 || errno == EEXIST) {
+        struct stat st;
+        return stat(m_directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+    return false;
+}
+
+std::string CompileCache::make_key(const char *source, size_t length, const std::string &flags)
+{
+    /* The version and flags are hashed ahead of the source, separated by
+     * NULs so no two (flags, source) pairs share a byte stream */
+    uint64_t header = fnv1a(FNV_OFFSET, COMPILER_VERSION, sizeof(COMPILER_VERSION));
+    header = fnv1a(header, flags.c_str(), flags.size() + 1);
+
+    uint64_t lane1 = fnv1a(header, source, length);
+    uint64_t lane2 = murmur64(source, length, header);
+
+    char key[33];
+    snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long)lane1, (unsigned long long)lane2);
+    return key;
+}
+
+bool CompileCache::lookup(const std::string &key, std::string *program)
+{
+    std::string path = entry_path(key);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        m_misses++;
+        return false;
+    }
+
+    program->resize(st.st_size);
+    size_t done = 0;
+    while (done < (size_t)st.st_size) {
+        ssize_t n = read(fd, &(*program)[done], st.st_size - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    /* Mark the entry as recently used for eviction */
+    futimens(fd, NULL);
+    close(fd);
+
+    if (done != (size_t)st.st_size) {
+        program->clear();
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    return true;
+}
+
+void CompileCache::store(const std::string &key, const std::string &program)
+{
+    std::string path = entry_path(key);
+    std::string temp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(m_temp_count++);
+
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return;
+    size_t done = 0;
+    while (done < program.size()) {
+        ssize_t n = write(fd, program.data() + done, program.size() - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    if (close(fd) != 0 || done != program.size() || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    m_stores++;
+    account_store((long)program.size());
+}
+
+void CompileCache::account_store(long bytes)
+{
+    std::lock_guard<std::mutex> guard(m_evict_lock);
+    if (m_total_bytes < 0)
+        m_total_bytes = scan_and_evict(LONG_MAX);
+    else
+        m_total_bytes += bytes;
+    /* Evict down to 90% of the cap, so the directory is not rescanned on
+     * every store once it is full */
+    if (m_total_bytes > m_max_bytes)
+        m_total_bytes = scan_and_evict(m_max_bytes / 10 * 9);
+}
+
+long CompileCache::scan_and_evict(long target_bytes)
+{
+    struct Entry
+    {
+        struct timespec used;
+        long bytes;
+        std::string path;
+    };
+    std::vector<Entry> entries;
+    long total = 0;
+
+    DIR *dir = opendir(m_directory.c_str());
+    if (dir == NULL)
+        return 0;
+    while (struct dirent *dirent = readdir(dir)) {
+        if (dirent->d_name[0] == '.' || is_temp_name(dirent->d_name))
+            continue;
+        std::string path = entry_path(dirent->d_name);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        entries.push_back(Entry{st.st_mtim, (long)st.st_size, path});
+        total += st.st_size;
+    }
+    closedir(dir);
+
+    if (total <= target_bytes)
+        return total;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        if (a.used.tv_sec != b.used.tv_sec)
+            return a.used.tv_sec < b.used.tv_sec;
+        return a.used.tv_nsec < b.used.tv_nsec;
+    });
+    for (const Entry &entry : entries) {
+        if (total <= target_bytes)
+            break;
+        if (unlink(entry.path.c_str()) == 0) {
+            total -= entry.bytes;
+            m_evictions++;
+        }
+    }
+    return total;
+}
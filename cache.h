@@ -0,0 +1,63 @@
+/***********************************************************************
+ * cache.h
+ *
+ * Content addressed on-disk cache of compiled programs. An entry is
+ * named by a 128 bit hash of the source bytes, the compiler version and
+ * the option flags, and holds the ARB program text. Entries are written
+ * to a temporary file and renamed into place, so several compilers may
+ * share one directory. Once the directory grows past its size cap the
+ * least recently used entries (oldest modification time, refreshed on
+ * every hit) are evicted.
+ **********************************************************************/
+
+#ifndef CACHE_H_
+#define CACHE_H_ 1
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+/* Default cap on the total size of a cache directory */
+#define CACHE_DEFAULT_MAX_BYTES (64L * 1024 * 1024)
+
+class CompileCache
+{
+  private:
+    std::string m_directory;
+    long m_max_bytes;
+
+    /* Estimate of the directory size, recounted whenever it passes the cap */
+    std::mutex m_evict_lock;
+    long m_total_bytes = -1;
+
+    std::atomic<long> m_hits{0};
+    std::atomic<long> m_misses{0};
+    std::atomic<long> m_stores{0};
+    std::atomic<long> m_evictions{0};
+    std::atomic<long> m_temp_count{0};
+
+    std::string entry_path(const std::string &key) const {return m_directory + "/" + key;}
+    void account_store(long bytes);
+    long scan_and_evict(long target_bytes);
+
+  public:
+    CompileCache(const std::string &directory, long max_bytes = CACHE_DEFAULT_MAX_BYTES);
+
+    /* Creates the cache directory if needed. Returns false if it can not
+     * be used. */
+    bool open();
+
+    /* Key of a source compiled with the given option flags */
+    static std::string make_key(const char *source, size_t length, const std::string &flags);
+
+    /* Reads the program stored under key. Returns false on a miss. */
+    bool lookup(const std::string &key, std::string *program);
+    void store(const std::string &key, const std::string &program);
+
+    long get_hits() const {return m_hits;}
+    long get_misses() const {return m_misses;}
+    long get_stores() const {return m_stores;}
+    long get_evictions() const {return m_evictions;}
+};
+
+#endif /* CACHE_H_ */
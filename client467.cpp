@@ -0,0 +1,79 @@
+/***********************************************************************
+ * client467.cpp
+ *
+ * Small client of the compile server (compiler467 --serve socket).
+ *
+ *   client467 socket [sourcefile ...]
+ *
+ * Sends each source (standard input if none) over one connection and
+ * writes its program to standard output, or its diagnostics to standard
+ * error as "source:line:column: [phase] message", where source is the
+ * file the source included if the error is in one. Exits with 1 if any
+ * source failed to compile or the server could not be reached.
+ **********************************************************************/
+
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include "server.h"
+
+static const char *phase_names[] = {"lexical", "syntax", "semantic"};
+
+static bool read_source(FILE *file, std::string *source)
+{
+    char buffer[BUFSIZ];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        source->append(buffer, n);
+    return !ferror(file);
+}
+
+static int compile_remote(int fd, const char *name, FILE *file)
+{
+    std::string source;
+    CompileResult result;
+    if (!read_source(file, &source)) {
+        fprintf(stderr, "Unable to read %s\n", name);
+        return 1;
+    }
+    if (!send_request(fd, source.data(), source.size()) || !receive_response(fd, &result)) {
+        fprintf(stderr, "Lost the connection to the server\n");
+        return 1;
+    }
+
+    fputs(result.program.c_str(), stdout);
+    for (const Diagnostic &diagnostic : result.diagnostics)
+        fprintf(stderr, "%s:%d:%d: [%s] %s\n", diagnostic.file.empty() ? name : diagnostic.file.c_str(),
+                diagnostic.line, diagnostic.column,
+                phase_names[diagnostic.phase], diagnostic.message.c_str());
+    return result.success ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s socket [sourcefile ...]\n", argv[0]);
+        return 1;
+    }
+    int fd = connect_to_server(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to connect to %s\n", argv[1]);
+        return 1;
+    }
+
+    int failed = 0;
+    if (argc == 2)
+        failed |= compile_remote(fd, "<stdin>", stdin);
+    for (int i = 2; i < argc; i++) {
+        FILE *file = fopen(argv[i], "r");
+        if (file == NULL) {
+            fprintf(stderr, "Unable to open file %s\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+        failed |= compile_remote(fd, argv[i], file);
+        fclose(file);
+    }
+    close(fd);
+    return failed;
+}
@@ -0,0 +1,74 @@
+"""Check that a fast compile (-F) writes the program a normal one does.
+
+Code generation over a FlatTree (-L) is checked the same way, so all
+three code generators stay in step. The sources are the tests of this
+directory, a few shaders from bench/shadergen.py, one of them an
+expression of 100000 terms, and any further files given. A source the
+normal compile reports errors for is skipped, as -F does not check; the
+others have to give the same program and exit status every way.
+
+usage: python3 fast.py [--compiler PATH] [source ...]
+"""
+
+import argparse
+import glob
+import os
+import subprocess
+import sys
+import tempfile
+
+here = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(here, "..", "bench"))
+import shadergen
+
+
+def compile_source(compiler, options, source):
+    """Return (exit status, stdout, stderr) of one compile."""
+    result = subprocess.run([compiler, "-X"] + options + [source],
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE,
+                            universal_newlines=True, errors="replace")
+    return result.returncode, result.stdout, result.stderr
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler",
+                        default=os.path.join(here, "..", "compiler467"))
+    parser.add_argument("paths", nargs="*")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        shaders = []
+        for blocks in (1, 10, 100):
+            path = os.path.join(directory, "shader%d.frag" % blocks)
+            with open(path, "w") as f:
+                f.write(shadergen.shader(blocks))
+            shaders.append(path)
+        path = os.path.join(directory, "chain.frag")
+        with open(path, "w") as f:
+            f.write(shadergen.chain(100000))
+        shaders.append(path)
+
+        failure_count = 0
+        tested = 0
+        for source in sorted(glob.glob(os.path.join(here, "*.c"))) + shaders + args.paths:
+            normal = compile_source(args.compiler, [], source)
+            if normal[2] or "Failed to compile" in normal[1]:
+                continue
+            tested += 1
+            fast = compile_source(args.compiler, ["-F"], source)
+            if normal[:2] != fast[:2]:
+                print("Fast compile differs on {}".format(source))
+                failure_count += 1
+            flat = compile_source(args.compiler, ["-L"], source)
+            if normal[:2] != flat[:2]:
+                print("Code generation over a FlatTree differs on {}".format(source))
+                failure_count += 1
+
+    print("{} sources, {} differences".format(tested, failure_count))
+    sys.exit(1 if failure_count else 0)
+
+
+if __name__ == "__main__":
+    main()
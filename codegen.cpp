@@ -1,58 +1,78 @@
 #include "ast.h"
+#include "arena.h"
 #include "common.h"
-#include <sstream>
 #include <stdarg.h>
-#include <iostream>
 #include <vector>
 #include <unordered_map>
 #include "parser.tab.h"
+#include "outbuf.h"
+#include "stats.h"
+#include "trace.h"
+#include "codegen.h"
+#include "flat.h"
 
 
 class ARBAssemblyTable
 {
     private:
 
-        std::stringstream buffer;
-        std::unordered_map<std::string, std::string> m_name_map;
+        /* Instructions are appended here piece by piece as they are translated */
+        OutputBuffer *m_out;
+        int m_instruction_count = 0;
+        /* Keyed by interned ids; temp names are interned too, as copies the pool keeps */
+        StringPool *m_identifiers;
+        std::unordered_map<SymbolId, std::string> m_name_map;
         std::string zero_vector = "__zero__vector__";
         int temp_register_counter = 0;
+        /* The register names set on expressions, as long as the table */
+        Arena m_register_names;
 
     public:
-        /* Init of assembly table, create name mapping, ARB assembly prefix and so on */
-        ARBAssemblyTable(){
-            m_name_map.emplace("gl_FragColor", "result.color");
-            m_name_map.emplace("gl_FragDepth", "result.depth");
-            m_name_map.emplace("gl_FragCoord", "fragment.position");
-
-            m_name_map.emplace("gl_TexCoord", "fragment.texcoord");
-            m_name_map.emplace("gl_Color", "fragment.color");
-            m_name_map.emplace("gl_Secondary", "fragment.color.secondary");
-            m_name_map.emplace("gl_FogFradCoord", "fragment.fogcoord");
-
-            m_name_map.emplace("gl_Light_Half", "state.light[0].half");
-            m_name_map.emplace("gl_Light_Ambient", "state.lightmodel.ambient");
-            m_name_map.emplace("gl_Material_Shininess", "state.material.shininess");
-            m_name_map.emplace("env1", "program.env[1]");
-            m_name_map.emplace("env2", "program.env[2]");
-            m_name_map.emplace("env3", "program.env[3]");
-        }
-
-        std::string insert_register_name_into_map(const std::string variable_name){
-            if (get_id_to_name_mapping(variable_name) != variable_name)
+        /* Registers of the predefined variables, indexed by their ids. These are
+         * the same in every program; m_name_map only holds this program's registers */
+        static const std::string &get_predefined_register_name(SymbolId id){
+            static const std::string predefined_register_names[PREDEFINED_NAME_COUNT] = {
+                "result.color",              /* gl_FragColor */
+                "result.depth",              /* gl_FragDepth */
+                "fragment.position",         /* gl_FragCoord */
+
+                "fragment.texcoord",         /* gl_TexCoord */
+                "fragment.color",            /* gl_Color */
+                "fragment.color.secondary",  /* gl_Secondary */
+                "fragment.fogcoord",         /* gl_FogFradCoord */
+
+                "state.light[0].half",       /* gl_Light_Half */
+                "state.lightmodel.ambient",  /* gl_Light_Ambient */
+                "state.material.shininess",  /* gl_Material_Shininess */
+                "program.env[1]",            /* env1 */
+                "program.env[2]",            /* env2 */
+                "program.env[3]",            /* env3 */
+            };
+            return predefined_register_names[id];
+        }
+
+    public:
+        /* Init of assembly table, ARB assembly prefix and so on */
+        ARBAssemblyTable(OutputBuffer *out, StringPool *identifiers) : m_out(out), m_identifiers(identifiers) {}
+
+        std::string insert_register_name_into_map(SymbolId variable){
+            if (StringPool::is_predefined(variable) || m_name_map.count(variable) > 0)
                 return ""; // We don't handle if and else statements in our compiler yet
 
-            std::string created_register_name = "__" + variable_name + "__";
-            m_name_map.emplace(variable_name, created_register_name);
+            std::string created_register_name = "__";
+            created_register_name += m_identifiers->get_name(variable);
+            created_register_name += "__";
+            m_name_map.emplace(variable, created_register_name);
             return created_register_name;
         }
 
         std::string create_temp_register_name() {
             temp_register_counter++;
 
-            std::string temp_register_name = "temp" + std::to_string(temp_register_counter);
+            std::string temp_name = "temp" + std::to_string(temp_register_counter);
 
             // We might not even need this
-            std::string return_str = insert_register_name_into_map(temp_register_name);
+            std::string return_str = insert_register_name_into_map(m_identifiers->intern_copy(temp_name));
             assert(return_str != "");
 
             return return_str;
@@ -63,6 +83,7 @@ class ARBAssemblyTable
             return temp_register_counter;
         }
         void set_temp_register_count(const int count){ temp_register_counter = count;}
+        int get_instruction_count() const {return m_instruction_count;}
 
     public:
         /* Purely based on the literal meaning, you return the index correspondent to x,y,z,w */
@@ -84,92 +105,43 @@ class ARBAssemblyTable
             return "ERROR";
         }
 
-        std::string create_assembly_instruction(AssemblyInstructionType type, ...){
-            va_list args;
-            va_start(args, type);
-
-            std::string result_str = "";
+        /* Appends one instruction line. TEMP takes only the output, the
+         * others one or two inputs. */
+        void emit_assembly_instruction(AssemblyInstructionType type, const std::string &output,
+                                       const std::string *input = nullptr,
+                                       const std::string *second_input = nullptr){
             switch (type)
             {
-            case MOV_INSTRUCTION:
-            {
-                std::string output_register = va_arg(args, std::string);
-                std::string input_register = va_arg(args, std::string);
-                result_str = "MOV " + output_register + ", " + input_register + ";" ;
-                break;
-            }
-
             case TEMP_INSTRUCTION:
-            {
-                std::string register_name = va_arg(args, std::string);
-                result_str = "TEMP " + register_name + ";";
+                m_out->append("TEMP ", 5).append(output);
                 break;
 
-            }
-
-            case MUL_INSTURCTION:
-            {
-                std::string output_location = va_arg(args, std::string);
-                std::string left_input = va_arg(args, std::string);
-                std::string right_input = va_arg(args, std::string);
-
-                result_str = "MUL " + output_location + ", "  + left_input + ", " + right_input + ";";
-                break;
-            }
-
             case CONST_REGISTER:
-            {
-                std::string const_variable_name = va_arg(args, std::string);
-                std::string right_hand_result = va_arg(args, std::string);
-
-                result_str = "PARAM " + const_variable_name + " = " + right_hand_result + ";";
+                m_out->append("PARAM ", 6).append(output).append(" = ", 3).append(*input);
                 break;
-            }
 
-            case DP3_INSTRUCTION:
+            default:
             {
-                std::string output_location = va_arg(args, std::string);
-                std::string left_input = va_arg(args, std::string);
-                std::string right_input = va_arg(args, std::string);
-
-                result_str = "DP3 " + output_location + ", "  + left_input + ", " + right_input + ";";
-                break;
-            }
-
-            case RSQ_INSTRUCTION:
-            {
-                std::string output_location = va_arg(args, std::string);
-                std::string input = va_arg(args, std::string);
-
-                result_str = "RSQ " + output_location + ", "  + input + ";";
-                break;
-            }
-
-            case LIT_INSTRUCTION:
-            {
-                std::string output_location = va_arg(args, std::string);
-                std::string input = va_arg(args, std::string);
-
-                result_str = "LIT " + output_location + ", "  + input + ";";
-                break;
-            }
-
-
-            case ADD_INSTRUCTION:
-            {
-                std::string output_location = va_arg(args, std::string);
-                std::string left_input = va_arg(args, std::string);
-                std::string right_input = va_arg(args, std::string);
-
-                result_str = "ADD " + output_location + ", " + left_input + ", " + right_input + ";";
+                static const char *const opcodes[] = {"MUL ", "MOV ", "ADD ", "TEMP ", "DP3 ", "RSQ ", "LIT "};
+                m_out->append(opcodes[type], 4).append(output).append(", ", 2).append(*input);
+                if (second_input)
+                    m_out->append(", ", 2).append(*second_input);
                 break;
             }
             }
+            m_out->append(";\n", 2);
+            m_instruction_count++;
+        }
 
-            va_end(args); // End the va_args
-            return result_str;
+        /* Appends the last line of the program */
+        void emit_end(){
+            m_out->append("END\n", 4);
+            m_instruction_count++;
         }
 
+        /* Instruction nodes are appended to the output as they are translated
+         * and return an empty string; VECTOR_NODE and CONSTRUCTOR_NODE return
+         * the operand text instead. String arguments are passed by pointer. */
         std::string get_assembly_translation(NodeKind type, ...){
             va_list args;
             va_start(args, type);
@@ -179,61 +151,28 @@ class ARBAssemblyTable
             {
             case SCOPE_NODE:
             {
-                /* We only want the of ABVfp1.0 to appear once */
-                buffer << "!!ARBfp1.0" << std::endl;
-                buffer << std::endl;
-                buffer << "PARAM __zero__vector__ = {0.0, 0.0, 0.0, 0.0};" << std::endl;
+                emit_program_start();
                 break;
             }
 
             case DECLARATION_NODE:
-            {
-                Declaration *decl = va_arg(args, Declaration *);
-                // Get the register name of the declaration
-                std::string decl_register_name = insert_register_name_into_map(decl->id);
-
-                if (decl_register_name == "") // Do nothing for the predefined variables or duplicated names
-                    break;
-
-                buffer << create_assembly_instruction(TEMP_INSTRUCTION, decl_register_name) << std::endl;
-
-                if (decl->initial_val == nullptr)
-                    buffer << create_assembly_instruction(MOV_INSTRUCTION, decl_register_name, zero_vector) << std::endl;
-                else
-                    buffer << create_assembly_instruction(MOV_INSTRUCTION, decl_register_name, \
-                                                        decl->initial_val->get_result_register_name()) << std::endl;
-
-                break;
-            }
-
             case CONST_DECLARATION_NODE:
             {
                 Declaration *decl = va_arg(args, Declaration *);
-                int expression_instance_type = va_arg(args, int);
-
-                std::string const_decl_register_name = insert_register_name_into_map(decl->id);
-
-                if (const_decl_register_name == "")
-                    break;
-
 
                 if (decl->initial_val == nullptr)
-                    buffer << create_assembly_instruction(CONST_REGISTER, const_decl_register_name, zero_vector) << std::endl;
+                    emit_declaration(decl->symbol, type == CONST_DECLARATION_NODE, nullptr);
                 else {
-                    assert(decl->initial_val->get_result_register_name() != "");
-                    buffer << create_assembly_instruction(CONST_REGISTER, const_decl_register_name, \
-                                                          decl->initial_val->get_result_register_name()) << std::endl;
+                    const std::string initial_value = decl->initial_val->get_result_register_name();
+                    emit_declaration(decl->symbol, type == CONST_DECLARATION_NODE, &initial_value);
                 }
                 break;
-
             }
 
             case VECTOR_NODE:
             {
                 VectorVariable *vec_var = va_arg(args, VectorVariable*);
-
-                buffer << get_id_to_name_mapping(vec_var->id);
-                buffer << "." << get_index_to_characater_mapping(vec_var->vector_index);
+                result_str = get_vector_operand(vec_var->symbol, vec_var->vector_index);
                 break;
             }
 
@@ -241,31 +180,11 @@ class ARBAssemblyTable
             {
                 BinaryExpression *be = va_arg(args, BinaryExpression*);
                 int operator_type = va_arg(args, int);
-                std::string left_result_name = va_arg(args, std::string);
-                std::string right_result_name = va_arg(args, std::string);
-
-                // Create a temp register to store the expression result
-                std::string result_register_name = create_temp_register_name();
-                buffer << create_assembly_instruction(TEMP_INSTRUCTION, result_register_name) << std::endl;
+                const std::string *left_result_name = va_arg(args, const std::string *);
+                const std::string *right_result_name = va_arg(args, const std::string *);
 
-                switch (operator_type)
-                {
-                    case TIMES:
-                    {
-                        buffer << create_assembly_instruction(MUL_INSTURCTION, result_register_name, \
-                                                            left_result_name, right_result_name) << std::endl;
-                        break;
-                    }
-
-                    case PLUS:
-                    {
-                        buffer << create_assembly_instruction(ADD_INSTRUCTION, result_register_name, \
-                                                            left_result_name, right_result_name) << std::endl;
-                        break;
-                    }
-                }
                 // Set the result register name for future references
-                be->set_result_register_name(result_register_name);
+                be->set_result_register_name(&m_register_names, emit_binary(operator_type, left_result_name, right_result_name));
                 break;
             }
 
@@ -273,44 +192,40 @@ class ARBAssemblyTable
             case ASSIGNMENT_NODE:
             {
                 // TODO: May be we could recycle all of the used temp register within assign statement(i.e temp1, temp2, temp3 and temp4 etc)
-                std::string variable_name  = va_arg(args, std::string);
-                std::string right_hand_result = va_arg(args, std::string);
-
-                std::string register_name = get_id_to_name_mapping(variable_name);
-                assert(register_name != "");
+                /* The variable arrives already mapped to its register */
+                const std::string *register_name  = va_arg(args, const std::string *);
+                const std::string *right_hand_result = va_arg(args, const std::string *);
+                assert(*register_name != "");
 
-                buffer << create_assembly_instruction(MOV_INSTRUCTION, register_name, right_hand_result) << std::endl;
+                emit_assembly_instruction(MOV_INSTRUCTION, *register_name, right_hand_result);
                 break;
             }
 
             case CONSTRUCTOR_NODE:
             {
                 Constructor *constructor = va_arg(args, Constructor*);
-                int num_expression = get_type_dimension(constructor->type->type_name);
-                std::string constructor_expression_type = get_base_type(constructor->type->type_name);
-
+                int num_expression = constructor->type->desc.get_dimension();
+                TypeDesc::Base constructor_expression_type = constructor->type->desc.get_base();
 
-                buffer << "{";
+                std::vector<std::string> values;
                 for (int i = 0; i < num_expression; i++)
                 {
-                    // Cast to each type to access their values
-                    if (constructor_expression_type == "bool") {
-                        BoolLiteralExpression *ble = reinterpret_cast<BoolLiteralExpression *>(constructor->args->get_expression_list()[i]);
-                        buffer << std::to_string(ble->bool_literal);
+                    // Cast to each type to access their values, zero for what is not a literal
+                    Expression *arg = constructor->args->get_expression_list()[i];
+                    if (constructor_expression_type == TypeDesc::BOOL_BASE) {
+                        bool bool_literal = arg->get_tag() == BOOL_LITERAL_TAG && static_cast<BoolLiteralExpression *>(arg)->bool_literal;
+                        values.push_back(std::to_string(bool_literal));
                     }
-                    else if(constructor_expression_type == "int"){
-                        IntLiteralExpression *ile = reinterpret_cast<IntLiteralExpression *>(constructor->args->get_expression_list()[i]);
-                        buffer << std::to_string(ile->int_literal);
+                    else if(constructor_expression_type == TypeDesc::INT_BASE){
+                        int int_literal = arg->get_tag() == INT_LITERAL_TAG ? static_cast<IntLiteralExpression *>(arg)->int_literal : 0;
+                        values.push_back(std::to_string(int_literal));
                     }
-                    else if (constructor_expression_type == "float"){
-                        FloatLiteralExpression *fle = reinterpret_cast<FloatLiteralExpression *>(constructor->args->get_expression_list()[i]);
-                        buffer << std::to_string(fle->float_literal);
+                    else if (constructor_expression_type == TypeDesc::FLOAT_BASE){
+                        float float_literal = arg->get_tag() == FLOAT_LITERAL_TAG ? static_cast<FloatLiteralExpression *>(arg)->float_literal : 0.0f;
+                        values.push_back(std::to_string(float_literal));
                     }
-
-                    if (i != num_expression - 1)
-                        buffer << ", ";
                 }
-                buffer << "}";
+                result_str = get_constructor_operand(values);
                 break;
             }
 
@@ -318,231 +233,579 @@ class ARBAssemblyTable
             {
                 FunctionExpression * fe = va_arg(args, FunctionExpression*);
 
-                std::string function_name = va_arg(args, std::string);
-
-                // Create a temp register to store the expression result
-                std::string result_register_name = create_temp_register_name();
-                buffer << create_assembly_instruction(TEMP_INSTRUCTION, result_register_name) << std::endl;
-
-                if (function_name == "dp3")
-                {
-                    std::string left_result_name = va_arg(args, std::string);
-                    std::string right_result_name = va_arg(args, std::string);
-                    buffer << create_assembly_instruction(DP3_INSTRUCTION, result_register_name, left_result_name, right_result_name) << std::endl;
-                }else if (function_name == "rsq")
-                {
-                    std::string input_result_name = va_arg(args, std::string);
-                    buffer << create_assembly_instruction(RSQ_INSTRUCTION, result_register_name, input_result_name) << std::endl;
-                }else if (function_name == "lit"){
-                    std::string input_result_name = va_arg(args, std::string);
-                    buffer << create_assembly_instruction(LIT_INSTRUCTION, result_register_name, input_result_name) << std::endl;
-                }
+                const std::string_view *function_name = va_arg(args, const std::string_view *);
+                const std::string *first_result_name = va_arg(args, const std::string *);
+                const std::string *second_result_name = *function_name == "dp3" ? va_arg(args, const std::string *) : nullptr;
 
                 // Set the result register name for future references
-                fe->set_result_register_name(result_register_name);
+                fe->set_result_register_name(&m_register_names, emit_function(*function_name, first_result_name, second_result_name));
                 break;
             }
 
             }
 
             va_end(args);
-            result_str = buffer.str();
-            buffer.str("");
             return result_str;
         }
 
-        std::string get_id_to_name_mapping(const std::string &id){
+        /* The halves of the translations above that need no node. The
+         * fast compile path calls them through ArbEmitter as it parses. */
+        void emit_program_start(){
+            /* We only want the of ABVfp1.0 to appear once */
+            static const std::string zero_vector_value = "{0.0, 0.0, 0.0, 0.0}";
+            m_out->append("!!ARBfp1.0\n\n", 12);
+            emit_assembly_instruction(CONST_REGISTER, zero_vector, &zero_vector_value);
+        }
+
+        /* Returns false, having emitted nothing, for the predefined
+         * variables and names already declared */
+        bool emit_declaration(SymbolId symbol, bool is_const, const std::string *initial_value){
+            // Get the register name of the declaration
+            std::string decl_register_name = insert_register_name_into_map(symbol);
+
+            if (decl_register_name == "") // Do nothing for the predefined variables or duplicated names
+                return false;
+
+            if (is_const) {
+                if (initial_value == nullptr)
+                    emit_assembly_instruction(CONST_REGISTER, decl_register_name, &zero_vector);
+                else {
+                    assert(*initial_value != "");
+                    emit_assembly_instruction(CONST_REGISTER, decl_register_name, initial_value);
+                }
+                return true;
+            }
+
+            emit_assembly_instruction(TEMP_INSTRUCTION, decl_register_name);
+            emit_assembly_instruction(MOV_INSTRUCTION, decl_register_name,
+                                      initial_value == nullptr ? &zero_vector : initial_value);
+            return true;
+        }
+
+        std::string get_vector_operand(SymbolId symbol, int index){
+            std::string result_str = get_id_to_name_mapping(symbol);
+            result_str += '.';
+            result_str += get_index_to_characater_mapping(index);
+            return result_str;
+        }
+
+        /* Returns the temp register holding the result */
+        std::string emit_binary(int operator_type, const std::string *left_result_name,
+                                const std::string *right_result_name){
+            // Create a temp register to store the expression result
+            std::string result_register_name = create_temp_register_name();
+            emit_assembly_instruction(TEMP_INSTRUCTION, result_register_name);
+
+            switch (operator_type)
+            {
+                case TIMES:
+                {
+                    emit_assembly_instruction(MUL_INSTURCTION, result_register_name, \
+                                              left_result_name, right_result_name);
+                    break;
+                }
+
+                case PLUS:
+                {
+                    emit_assembly_instruction(ADD_INSTRUCTION, result_register_name, \
+                                              left_result_name, right_result_name);
+                    break;
+                }
+            }
+            return result_register_name;
+        }
+
+        /* Returns the temp register holding the result. Only dp3 takes a
+         * second argument. */
+        std::string emit_function(std::string_view function_name, const std::string *first_result_name,
+                                  const std::string *second_result_name){
+            // Create a temp register to store the expression result
+            std::string result_register_name = create_temp_register_name();
+            emit_assembly_instruction(TEMP_INSTRUCTION, result_register_name);
+
+            if (function_name == "dp3")
+                emit_assembly_instruction(DP3_INSTRUCTION, result_register_name, first_result_name, second_result_name);
+            else if (function_name == "rsq")
+                emit_assembly_instruction(RSQ_INSTRUCTION, result_register_name, first_result_name);
+            else if (function_name == "lit")
+                emit_assembly_instruction(LIT_INSTRUCTION, result_register_name, first_result_name);
+            return result_register_name;
+        }
+
+        /* A constructor of literals is an inline vector, {1.0, 2.0} */
+        std::string get_constructor_operand(const std::vector<std::string> &values){
+            std::string result_str = "{";
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                if (i != 0)
+                    result_str += ", ";
+                result_str += values[i];
+            }
+            result_str += "}";
+            return result_str;
+        }
+
+        std::string get_id_to_name_mapping(SymbolId id){
             auto name_iter = m_name_map.find(id);
-            if (name_iter == m_name_map.end())
-               return id;
-            else
+            if (name_iter != m_name_map.end())
                 return name_iter->second; /* Return the mapped result */
+
+            if (StringPool::is_predefined(id))
+                return get_predefined_register_name(id);
+            return std::string(m_identifiers->get_name(id));
         }
 
 
+        Arena *get_register_names() {return &m_register_names;}
+
     // Destructor
     public:
         ~ARBAssemblyTable () {}
 };
 
 
-class codeGenVisitor : public Visitor
+class codeGenVisitor : public TreeWalker<codeGenVisitor>
 {
     private:
+        OutputBuffer *m_out;
         ARBAssemblyTable assembly_table;
-        std::vector<std::string> m_instruction_list;
-        ExpressionVisitor expr_visitor;
+
+        /* Each translated node is followed by a blank line */
+        void end_block() {m_out->put('\n');}
 
     public:
-        codeGenVisitor(){
-            std::string scope_str = assembly_table.get_assembly_translation(SCOPE_NODE);
-            push_back_instruction(scope_str);
+        codeGenVisitor(OutputBuffer *out, StringPool *identifiers) : m_out(out), assembly_table(out, identifiers) {
+            assembly_table.get_assembly_translation(SCOPE_NODE);
+            end_block();
         }
 
         std::string get_assembly_id_str(IdentifierNode *var){
-            var->visit(expr_visitor);
-            int variable_type = expr_visitor.get_expression_instance_type();
-
             std::string result_str = "";
-            if (variable_type == TEMP_VECTOR_EXPRESSION) {
-                VectorVariable *vector_variable = reinterpret_cast<VectorVariable *>(var);
+            if (var->get_tag() == VECTOR_VARIABLE_TAG) {
+                VectorVariable *vector_variable = static_cast<VectorVariable *>(var);
                 result_str  = assembly_table.get_assembly_translation(VECTOR_NODE, vector_variable);
             }
-
-            else if(variable_type == TEMP_ID_EXPRESSION) {
-                result_str = assembly_table.get_id_to_name_mapping(var->id);
-            }
-            else{
-                assert(0); // Can not happen
+            else {
+                result_str = assembly_table.get_id_to_name_mapping(var->symbol);
             }
             return result_str;
         }
 
 
     public:
+        using TreeWalker<codeGenVisitor>::enter;
+        using TreeWalker<codeGenVisitor>::leave;
 
-        virtual void visit(Declaration *decl) {
-            // Visit the sub expression to get initial values ready
-            if (decl->initial_val != nullptr) {
-                decl->initial_val->visit(*this);
-            }
-
-            std::string decl_instructions = "";
+        // The sub expression is visited first to get initial values ready
+        void leave(Declaration *decl) {
+            size_t output_length = m_out->length();
             if (decl->get_is_const())
-                decl_instructions = assembly_table.get_assembly_translation(CONST_DECLARATION_NODE, decl);
+                assembly_table.get_assembly_translation(CONST_DECLARATION_NODE, decl);
             else
-                decl_instructions = assembly_table.get_assembly_translation(DECLARATION_NODE, decl);
-            if (decl_instructions == "") // Predefined or error out
+                assembly_table.get_assembly_translation(DECLARATION_NODE, decl);
+            if (m_out->length() == output_length) // Predefined or error out
                 return;
 
-            push_back_instruction(decl_instructions); // Collect the declarations
+            end_block();
         }
 
-        virtual void visit(AssignStatement *assign_stmt) {
+        void leave(AssignStatement *assign_stmt) {
             // int old_register_count = assembly_table.get_temp_register_count();
-            assign_stmt->variable->visit(*this);
-            assign_stmt->expression->visit(*this);
+            const std::string assembly_variable_str = get_assembly_id_str(assign_stmt->variable);
+            const std::string right_hand_result = assign_stmt->expression->get_result_register_name();
+            assembly_table.get_assembly_translation(ASSIGNMENT_NODE, &assembly_variable_str, &right_hand_result);
 
-            std::string assembly_variable_str = get_assembly_id_str(assign_stmt->variable);
-            std::string assign_stmt_instructions = assembly_table.get_assembly_translation(ASSIGNMENT_NODE, assembly_variable_str, \
-                                                                                            assign_stmt->expression->get_result_register_name());
-
-            push_back_instruction(assign_stmt_instructions);
+            end_block();
             // assembly_table.set_temp_register_count(old_register_count); // Reuse the temp registers
         }
 
-        virtual void visit(IfStatement *if_statement) {
+        /* The branches taken are walked here, the if's children are not */
+        bool enter(IfStatement *if_statement) {
             assert(if_statement->expression != nullptr);
-            if_statement->expression->visit(*this);
-            if_statement->expression->visit(expr_visitor);
+            walk(if_statement->expression);
 
             bool expression_val = false;
-            int expression_instance_type = expr_visitor.get_expression_instance_type();
             // We evaluate the expression and if it is true, let's skip the else statement
-            if (expression_instance_type == BOOL_EXPRESSION) {
-                BoolLiteralExpression *ble =  reinterpret_cast<BoolLiteralExpression *>(if_statement->expression);
+            if (if_statement->expression->get_tag() == BOOL_LITERAL_TAG) {
+                BoolLiteralExpression *ble =  static_cast<BoolLiteralExpression *>(if_statement->expression);
                 expression_val = ble->bool_literal;
 
                 // We do deadcode elimination here, and ignore either if stataement, or else statement;
                 if (expression_val){
-                    if_statement->statement->visit(*this);
+                    walk(if_statement->statement);
                 }
                 else {
                     if (if_statement->else_statement)
-                        if_statement->else_statement->visit(*this);
+                        walk(if_statement->else_statement);
                 }
             }
             else{
-                if_statement->statement->visit(*this);
+                walk(if_statement->statement);
                 if (if_statement->else_statement)
-                    if_statement->else_statement->visit(*this);
+                    walk(if_statement->else_statement);
             }
+            return false;
         }
 
-        virtual void visit(BinaryExpression *be) {
-
-            be->left_expression->visit(*this);
-            be->right_expression->visit(*this);
-
+        void leave(BinaryExpression *be) {
             // Get the left expression and right expression register name (it can be in memory or just register)
-            std::string left_result_name = be->left_expression->get_result_register_name();
-            std::string right_result_name = be->right_expression->get_result_register_name();
+            const std::string left_result_name = be->left_expression->get_result_register_name();
+            const std::string right_result_name = be->right_expression->get_result_register_name();
             assert(left_result_name != "");
             assert(right_result_name != "");
 
             int operator_type = be->operator_type;
 
 
-            std::string binary_result_instruction = assembly_table.get_assembly_translation(BINARY_EXPRESSION_NODE, be, operator_type, \
-                                                                                            left_result_name, right_result_name);
-            push_back_instruction(binary_result_instruction);
+            assembly_table.get_assembly_translation(BINARY_EXPRESSION_NODE, be, operator_type, \
+                                                    &left_result_name, &right_result_name);
+            end_block();
         }
 
-        virtual void visit(VariableExpression *ve) {
-            ve->id_node->visit(*this);
-
+        void leave(VariableExpression *ve) {
             // Set the result register name so upper layer can see it
             std::string result_str = get_assembly_id_str(ve->id_node);
-            ve->set_result_register_name(result_str);
+            ve->set_result_register_name(assembly_table.get_register_names(), result_str);
         }
 
-        virtual void visit(ConstructorExpression *ce) {
-            ce->constructor->visit(*this);
-
+        void leave(ConstructorExpression *ce) {
             std::string result_str =  assembly_table.get_assembly_translation(CONSTRUCTOR_NODE, ce->constructor);
             assert(result_str != "");
             // Atm, compiler only supports const declared constructors.. i.e vec4(1.0, 2.0, 3.0, 4.0)
             // where all input are literals
-            ce->set_result_register_name(result_str);
+            ce->set_result_register_name(assembly_table.get_register_names(), result_str);
 
         }
 
-        virtual void visit(FunctionExpression *fe){
-            fe->function->visit(*this);
-            fe->function->arguments->visit(*this);
-            std::vector<Expression *> args = fe->function->arguments->get_expression_list();
+        /* The arguments are translated once as children, and twice more here */
+        void leave(FunctionExpression *fe){
+            walk(fe->function->arguments);
+            const NodeList<Expression *> &args = fe->function->arguments->get_expression_list();
             for (int i=0; i<(int)args.size(); i++){
-                args[i]->visit(*this);
+                walk(args[i]);
             }
 
-            std::string function_result_instruction;
-            std::string function_name = fe->function->function_name;
-            std::vector<Expression *> args_list = fe->function->arguments->get_expression_list();
+            const std::string_view &function_name = fe->function->function_name;
+            const NodeList<Expression *> &args_list = fe->function->arguments->get_expression_list();
 
             if (function_name == "dp3"){
-                std::string left_result_name = args_list[0]->get_result_register_name();
-                std::string right_result_name = args_list[1]->get_result_register_name();
-                function_result_instruction = assembly_table.get_assembly_translation(FUNCTION_NODE, fe, function_name, left_result_name, right_result_name);
+                const std::string left_result_name = args_list[0]->get_result_register_name();
+                const std::string right_result_name = args_list[1]->get_result_register_name();
+                assembly_table.get_assembly_translation(FUNCTION_NODE, fe, &function_name, &left_result_name, &right_result_name);
             }else if (function_name == "rsq"){
-                std::string input_result_name = args_list[0]->get_result_register_name();
-                function_result_instruction = assembly_table.get_assembly_translation(FUNCTION_NODE, fe, function_name, input_result_name);
+                const std::string input_result_name = args_list[0]->get_result_register_name();
+                assembly_table.get_assembly_translation(FUNCTION_NODE, fe, &function_name, &input_result_name);
             }else if (function_name == "lit"){
-                std::string input_result_name = args_list[0]->get_result_register_name();
-                function_result_instruction = assembly_table.get_assembly_translation(FUNCTION_NODE, fe, function_name, input_result_name);
+                const std::string input_result_name = args_list[0]->get_result_register_name();
+                assembly_table.get_assembly_translation(FUNCTION_NODE, fe, &function_name, &input_result_name);
             }
 
-            push_back_instruction(function_result_instruction);
+            end_block();
         }
 
     public:
-        void push_back_instruction(std::string instruction) {m_instruction_list.push_back(instruction);}
+        void finish_program() {
+            assembly_table.emit_end();
+        }
+        int get_instruction_count() const {return assembly_table.get_instruction_count();}
+};
+
+/* The translations of codeGenVisitor over a FlatTree, node for node.
+ * Statements are taken from the top, so that the branch an if on a
+ * literal skips is never translated; an expression is translated by
+ * going through its run of nodes in order, each expression pushing its
+ * register or literal text on m_operands for its parent to take. */
+class FlatCodeGen
+{
+    private:
+        OutputBuffer *m_out;
+        const FlatTree &m_tree;
+        ARBAssemblyTable assembly_table;
+        std::vector<std::string> m_operands;
+
+        void end_block() {m_out->put('\n');}
 
-        void write_out_instructions() {
-            for (std::string instruction : m_instruction_list){
-                std::cout << instruction << std::endl;
+        std::string get_assembly_id_str(uint32_t index){
+            const FlatNode &var = m_tree.nodes[index];
+            if (var.kind == FLAT_VECTOR_VARIABLE)
+                return assembly_table.get_vector_operand(var.symbol, var.vector_index);
+            return assembly_table.get_id_to_name_mapping(var.symbol);
+        }
+
+        /* The literal text of a constructor argument, read as base_type;
+         * only literals of that type pass the semantic check */
+        std::string get_literal_text(const FlatNode &arg, TypeDesc::Base base_type){
+            if (base_type == TypeDesc::BOOL_BASE)
+                return std::to_string(arg.kind == FLAT_BOOL_LITERAL && arg.bool_value);
+            else if (base_type == TypeDesc::INT_BASE)
+                return std::to_string(arg.kind == FLAT_INT_LITERAL ? arg.int_value : 0);
+            return std::to_string(arg.kind == FLAT_FLOAT_LITERAL ? arg.float_value : 0.0f);
+        }
+
+        /* Leaves one operand on m_operands per expression of the run
+         * that is not part of another */
+        void translate_expressions(uint32_t first, uint32_t last){
+            for (uint32_t index = first; index <= last; index++)
+            {
+                const FlatNode &node = m_tree.nodes[index];
+                switch (node.kind)
+                {
+                case FLAT_FLOAT_LITERAL:
+                    m_operands.push_back(std::to_string(node.float_value));
+                    break;
+                case FLAT_BOOL_LITERAL:
+                    m_operands.push_back(std::to_string(node.bool_value));
+                    break;
+                case FLAT_INT_LITERAL:
+                    m_operands.push_back(std::to_string(node.int_value));
+                    break;
+
+                case FLAT_VARIABLE_EXPRESSION:
+                    m_operands.push_back(get_assembly_id_str(m_tree.get_child(index, 0)));
+                    break;
+
+                case FLAT_UNARY:    /* Given no register */
+                    m_operands.back().clear();
+                    break;
+
+                case FLAT_BINARY:
+                {
+                    const std::string &left_result_name = m_operands.end()[-2];
+                    const std::string &right_result_name = m_operands.end()[-1];
+                    assert(left_result_name != "");
+                    assert(right_result_name != "");
+                    std::string result = assembly_table.emit_binary(node.operator_type, &left_result_name, &right_result_name);
+                    m_operands.pop_back();
+                    m_operands.back() = std::move(result);
+                    end_block();
+                    break;
+                }
+
+                case FLAT_CONSTRUCTOR_EXPRESSION:
+                {
+                    uint32_t constructor = m_tree.get_child(index, 0);
+                    TypeDesc type = m_tree.nodes[m_tree.get_child(constructor, 0)].type;
+                    uint32_t args = m_tree.get_child(constructor, 1);
+                    uint32_t arg_count = m_tree.get_child_count(args);
+                    uint32_t num_expression = std::min((uint32_t)type.get_dimension(), arg_count);
+
+                    std::vector<std::string> values;
+                    for (uint32_t i = 0; i < num_expression; i++)
+                        values.push_back(get_literal_text(m_tree.nodes[m_tree.get_child(args, i)], type.get_base()));
+                    m_operands.resize(m_operands.size() - arg_count);
+                    m_operands.push_back(assembly_table.get_constructor_operand(values));
+                    break;
+                }
+
+                case FLAT_FUNCTION_EXPRESSION:
+                {
+                    uint32_t function = m_tree.get_child(index, 0);
+                    uint32_t args = m_tree.get_child(function, 0);
+                    uint32_t arg_count = m_tree.get_child_count(args);
+                    // codeGenVisitor translates the arguments three times, the run above was the first
+                    m_operands.resize(m_operands.size() - arg_count);
+                    translate_expressions(m_tree.get_first(args), args);
+                    m_operands.resize(m_operands.size() - arg_count);
+                    translate_expressions(m_tree.get_first(args), args);
+
+                    std::string_view function_name = m_tree.names[m_tree.nodes[function].name];
+                    const std::string *arguments = m_operands.data() + m_operands.size() - arg_count;
+                    std::string result;
+                    if (function_name == "dp3")
+                        result = assembly_table.emit_function(function_name, &arguments[0], &arguments[1]);
+                    else if (function_name == "rsq" || function_name == "lit")
+                        result = assembly_table.emit_function(function_name, &arguments[0], nullptr);
+                    m_operands.resize(m_operands.size() - arg_count);
+                    m_operands.push_back(std::move(result));
+                    end_block();
+                    break;
+                }
+
+                default:    /* Parts of the expressions above */
+                    break;
+                }
             }
         }
 
+        /* Returns the operand of expression */
+        std::string translate_expression(uint32_t expression){
+            translate_expressions(m_tree.get_first(expression), expression);
+            std::string result = std::move(m_operands.back());
+            m_operands.pop_back();
+            return result;
+        }
 
+        void translate_declaration(uint32_t index){
+            const FlatNode &decl = m_tree.nodes[index];
+            bool is_const = decl.flags & FLAT_IS_CONST;
+            if (m_tree.get_child_count(index) > 1) {
+                const std::string initial_value = translate_expression(m_tree.get_child(index, 1));
+                if (assembly_table.emit_declaration(decl.symbol, is_const, &initial_value))
+                    end_block();
+            }
+            else if (assembly_table.emit_declaration(decl.symbol, is_const, nullptr))
+                end_block();
+        }
 
+        void translate_statement(uint32_t index){
+            const FlatNode &stmt = m_tree.nodes[index];
+            switch (stmt.kind)
+            {
+            case FLAT_ASSIGNMENT:
+            {
+                const std::string right_hand_result = translate_expression(m_tree.get_child(index, 1));
+                const std::string assembly_variable_str = get_assembly_id_str(m_tree.get_child(index, 0));
+                assembly_table.get_assembly_translation(ASSIGNMENT_NODE, &assembly_variable_str, &right_hand_result);
+                end_block();
+                break;
+            }
+
+            case FLAT_IF:
+            {
+                uint32_t condition = m_tree.get_child(index, 0);
+                translate_expression(condition);
+                const FlatNode &expression = m_tree.nodes[condition];
+                // Dead code elimination, as in codeGenVisitor
+                if (expression.kind != FLAT_BOOL_LITERAL || expression.bool_value)
+                    translate_statement(m_tree.get_child(index, 1));
+                if (m_tree.get_child_count(index) > 2 && (expression.kind != FLAT_BOOL_LITERAL || !expression.bool_value))
+                    translate_statement(m_tree.get_child(index, 2));
+                break;
+            }
+
+            case FLAT_NESTED_SCOPE:
+                translate_scope(m_tree.get_child(index, 0));
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        void translate_scope(uint32_t index){
+            uint32_t decls = m_tree.get_child(index, 0);
+            for (uint32_t i = 0; i < m_tree.get_child_count(decls); i++)
+                translate_declaration(m_tree.get_child(decls, i));
+            uint32_t stmts = m_tree.get_child(index, 1);
+            for (uint32_t i = 0; i < m_tree.get_child_count(stmts); i++)
+                translate_statement(m_tree.get_child(stmts, i));
+        }
+
+    public:
+        FlatCodeGen(OutputBuffer *out, StringPool *identifiers, const FlatTree &tree) :
+            m_out(out), m_tree(tree), assembly_table(out, identifiers) {}
+
+        /* Writes the whole program, returns the number of instructions */
+        int translate(){
+            assembly_table.emit_program_start();
+            end_block();
+            translate_scope(m_tree.get_root());
+            assembly_table.emit_end();
+            return assembly_table.get_instruction_count();
+        }
 };
 
-int genCode(node *ast)
+int genCode(CompileContext *ctx)
 {
-    codeGenVisitor code_visitor;
-    ast->visit(code_visitor);
-    code_visitor.push_back_instruction("END");
-    code_visitor.write_out_instructions();
+    node *ast = ctx->ast;
+    FlatTree tree;
+    if (ctx->flatCodegen) {
+        PhaseTimer timer(ctx->stats, PHASE_FLATTEN);
+        TraceSpan span(ctx->traceLog, "flatten", "phase");
+        if (ctx->arena) {
+            tree.nodes.reserve(ctx->arena->get_allocation_count());
+            tree.children.reserve(ctx->arena->get_allocation_count());
+        }
+        tree.build(ast);
+    }
+
+    PhaseTimer timer(ctx->stats, PHASE_CODEGEN);
+    TraceSpan span(ctx->traceLog, "codegen", "phase");
+    OutputBuffer out(ctx);
+    int instructions;
+    if (ctx->flatCodegen) {
+        FlatCodeGen code_gen(&out, ctx->identifiers, tree);
+        TraceSpan walk_span(ctx->traceLog, "FlatCodeGen", "visitor");
+        instructions = code_gen.translate();
+    } else {
+        codeGenVisitor code_visitor(&out, ctx->identifiers);
+        TraceSpan visitor_span(ctx->traceLog, "codeGenVisitor", "visitor");
+        code_visitor.walk(ast);
+        code_visitor.finish_program();
+        instructions = code_visitor.get_instruction_count();
+    }
+    {
+        TraceSpan write_span(ctx->traceLog, "write program", "phase");
+        out.flush();
+    }
+    ctx->outputLength = out.length();
+    if (ctx->stats)
+        ctx->stats->instructions = instructions;
 
     return 1;
 }
+
+ArbEmitter::ArbEmitter(OutputBuffer *out, StringPool *identifiers) :
+    m_out(out), m_table(new ARBAssemblyTable(out, identifiers))
+{
+    m_table->emit_program_start();
+    end_block();
+}
+
+ArbEmitter::~ArbEmitter()
+{
+    delete m_table;
+}
+
+void ArbEmitter::end_block()
+{
+    m_out->put('\n');
+}
+
+void ArbEmitter::declaration(SymbolId symbol, bool is_const, const std::string *initial_value)
+{
+    if (m_table->emit_declaration(symbol, is_const, initial_value))
+        end_block();
+}
+
+void ArbEmitter::assignment(const std::string &variable, const std::string &value)
+{
+    m_table->get_assembly_translation(ASSIGNMENT_NODE, &variable, &value);
+    end_block();
+}
+
+std::string ArbEmitter::variable(SymbolId symbol)
+{
+    return m_table->get_id_to_name_mapping(symbol);
+}
+
+std::string ArbEmitter::vector(SymbolId symbol, int index)
+{
+    return m_table->get_vector_operand(symbol, index);
+}
+
+std::string ArbEmitter::constructor(const std::vector<std::string> &values)
+{
+    return m_table->get_constructor_operand(values);
+}
+
+std::string ArbEmitter::binary(int operator_type, const std::string &left, const std::string &right)
+{
+    std::string result = m_table->emit_binary(operator_type, &left, &right);
+    end_block();
+    return result;
+}
+
+std::string ArbEmitter::function(std::string_view name, const std::vector<std::string> &arguments)
+{
+    std::string result = m_table->emit_function(name, arguments.empty() ? nullptr : &arguments[0],
+                                                arguments.size() > 1 ? &arguments[1] : nullptr);
+    end_block();
+    return result;
+}
+
+int ArbEmitter::finish()
+{
+    m_table->emit_end();
+    return m_table->get_instruction_count();
+}
@@ -1,7 +1,49 @@
 #ifndef CODEGEN_H_
 #define CODEGEN_H_ 1
+#include <string>
+#include <string_view>
+#include <vector>
 #include "ast.h"
+#include "context.h"
 
-int genCode(node *ast);
+class ARBAssemblyTable;
+class OutputBuffer;
+
+int genCode(CompileContext *ctx);
+
+/* Writes the program one production at a time, for compiles that emit
+ * while they parse instead of walking an AST (see hand_compile). It
+ * goes through the same translations as genCode, so each production
+ * comes out as its node would. Operands are register names or literal
+ * text, as genCode passes them between nodes. */
+class ArbEmitter
+{
+  private:
+    OutputBuffer *m_out;
+    ARBAssemblyTable *m_table;
+
+    /* Each translated production is followed by a blank line */
+    void end_block();
+
+  public:
+    ArbEmitter(OutputBuffer *out, StringPool *identifiers);
+    ~ArbEmitter();
+    ArbEmitter(const ArbEmitter &) = delete;
+    ArbEmitter &operator=(const ArbEmitter &) = delete;
+
+    /* initial_value is NULL for a declaration without one */
+    void declaration(SymbolId symbol, bool is_const, const std::string *initial_value);
+    void assignment(const std::string &variable, const std::string &value);
+
+    /* Operands. binary and function emit instructions for their result */
+    std::string variable(SymbolId symbol);
+    std::string vector(SymbolId symbol, int index);
+    std::string constructor(const std::vector<std::string> &values);
+    std::string binary(int operator_type, const std::string &left, const std::string &right);
+    std::string function(std::string_view name, const std::vector<std::string> &arguments);
+
+    /* Ends the program, returns the number of instructions in it */
+    int finish();
+};
 
 #endif
@@ -25,30 +25,8 @@
 #define MAX_INTEGER    32767
 #define MAX_FLOAT      1E37
 
-/********************************************************************** 
- * External declarations for variables declared in globalvars.c.
- **********************************************************************/
-extern FILE * inputFile;
-extern FILE * outputFile;
-extern FILE * errorFile;
-extern FILE * dumpFile;
-extern FILE * traceFile;
-extern FILE * runInputFile;
-
-extern int errorOccurred;
-extern int suppressExecution;
-
-extern int traceScanner;
-extern int traceParser;
-extern int traceExecution;
-
-extern int dumpSource;
-extern int dumpAST;
-extern int dumpSymbols;
-extern int dumpInstructions;
-
-
-
+/* Part of every compile cache key, bump when the generated code changes */
+#define COMPILER_VERSION "467.1"
 
 #endif
 
@@ -0,0 +1,594 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include "compile.h"
+#include "ast.h"
+#include "arena.h"
+#include "parser.tab.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "cache.h"
+#include "stats.h"
+#include "trace.h"
+#include "source.h"
+#include "outbuf.h"
+#include "intern.h"
+#include "location.h"
+#include "handparse.h"
+#include "preprocess.h"
+
+extern int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+
+static int compilePreprocessed(CompileContext *ctx);
+static int compilePhases(CompileContext *ctx);
+static int compileParsed(CompileContext *ctx);
+static int compileFast(CompileContext *ctx);
+static void scanAlone(CompileContext *ctx);
+static bool canStream(CompileContext *ctx);
+static int compileStreamed(CompileContext *ctx);
+static int compileCached(CompileContext *ctx);
+static std::string cacheFlags(CompileContext *ctx);
+
+int compileSource(CompileContext *ctx)
+{
+/***********************************************************************
+ * Compiler Initialization.
+ *
+ * If explicit initialization of any phase of the compilation is needed,
+ * calls to initialization routines in the applicable modules are placed
+ * here.
+ **********************************************************************/
+  ctx->errorOccurred = FALSE;
+  ctx->ast = NULL;
+
+  TraceSpan span(ctx->traceLog, "compile", "compile");
+  if (ctx->traceLog && ctx->sourceName)
+    span.args = "\"file\": " + TraceLog::quote(ctx->sourceName);
+
+  CompileStats stats;
+  if (ctx->traceTiming)
+    ctx->stats = &stats;
+
+/* A pipe is parsed as it is read, see CompileStream */
+  if (canStream(ctx))
+    return compileStreamed(ctx);
+
+/* Read the source once, every phase works from this one buffer */
+  SourceBuffer source;
+  if (ctx->inputText ? !source.load_text(ctx->inputText, ctx->inputLength)
+                     : !source.load_file(ctx->inputFile)) {
+    if (ctx->errorFile)
+      fprintf(ctx->errorFile, "Unable to read the source\n");
+    ctx->stats = nullptr;
+    return 1;
+  }
+  if (source.get_length() > MAX_SOURCE_LENGTH) {
+    if (ctx->errorFile)
+      fprintf(ctx->errorFile, "The source is too large\n");
+    ctx->stats = nullptr;
+    return 1;
+  }
+  ctx->sourceText = source.get_data();
+  ctx->sourceLength = source.get_length();
+  LineTable lines(ctx->sourceText, ctx->sourceLength);
+  ctx->lines = &lines;
+
+/* Only the program is cached, so compiles that trace or dump skip it */
+  int failed;
+  if (ctx->cache && !ctx->dumpSource && !ctx->dumpAST &&
+      !ctx->traceScanner && !ctx->traceParser)
+    failed = compileCached(ctx);
+  else
+    failed = compilePreprocessed(ctx);
+
+  if (ctx->stats) {
+    stats.print(ctx->traceFile);
+    ctx->stats = nullptr;
+  }
+  ctx->sourceText = nullptr;
+  ctx->sourceLength = 0;
+  ctx->lines = nullptr;
+  return failed;
+}
+
+/* Directives are carried out before anything else */
+static int compilePreprocessed(CompileContext *ctx)
+{
+  std::unique_ptr<Preprocessor> preprocessor;
+  if (has_directives(ctx->sourceText, ctx->sourceLength)) {
+    PhaseTimer timer(ctx->stats, PHASE_SCAN);
+    TraceSpan span(ctx->traceLog, "preprocess", "phase");
+    preprocessor.reset(new Preprocessor(ctx));
+    preprocessor->run();
+    ctx->preprocessor = preprocessor.get();
+  }
+  int failed = compilePhases(ctx);
+  ctx->preprocessor = nullptr;
+  return failed;
+}
+
+static int compilePhases(CompileContext *ctx)
+{
+  StringPool identifiers;
+  ctx->identifiers = &identifiers;
+  Arena arena;    /* The AST goes with it, whatever its size */
+  ctx->arena = &arena;
+  if (scanner_init(ctx)) {
+    ctx->identifiers = nullptr;
+    ctx->arena = nullptr;
+    if (ctx->errorFile)
+      fprintf(ctx->errorFile, "Unable to initialize the scanner\n");
+    return 1;
+  }
+
+/***********************************************************************
+ * Start the Compilation
+ **********************************************************************/
+  if (ctx->dumpSource)
+    sourceDump(ctx);
+
+/* A fast compile writes the program as it parses, unless the AST or the
+ * reductions are wanted */
+  if (ctx->fastCompile && !ctx->dumpAST && !ctx->traceParser) {
+    int failed = compileFast(ctx);
+    scanner_destroy(ctx);
+    ctx->identifiers = nullptr;
+    ctx->arena = nullptr;
+    return failed;
+  }
+
+/* Phase 2: Parser -- should allocate an AST, storing the reference in the
+ * context field "ast", and build the AST there. */
+  int parsed;
+  CompileStats before = ctx->stats ? *ctx->stats : CompileStats();
+  scanAlone(ctx);
+  {
+    PhaseTimer timer(ctx->stats, PHASE_PARSE);
+    TraceSpan span(ctx->traceLog, "parse", "phase"); /* Scanning happens within */
+    /* Only the bison parser can trace its reductions */
+    parsed = ctx->handParser && !ctx->traceParser ? hand_parse(ctx) : yyparse(ctx, ctx->scanner);
+  }
+  if (ctx->stats) {
+    /* The parse scanned again what scanAlone timed, keep the two apart */
+    ctx->stats->wall_ms[PHASE_PARSE] -= ctx->stats->wall_ms[PHASE_SCAN] - before.wall_ms[PHASE_SCAN];
+    ctx->stats->cpu_ms[PHASE_PARSE]  -= ctx->stats->cpu_ms[PHASE_SCAN] - before.cpu_ms[PHASE_SCAN];
+  }
+  /* 1: a syntax error, 2: the parser ran out of stack; either way no AST */
+  int failed = parsed != 0 ? 1 : compileParsed(ctx);
+
+/* Make calls to any cleanup or finalization routines here. */
+  if (ctx->stats) {
+    ctx->stats->arena_bytes = arena.get_used();
+    ctx->stats->arena_chunks = arena.get_chunk_count();
+  }
+  {
+    /* A chunk at a time, however many nodes the tree has */
+    PhaseTimer timer(ctx->stats, PHASE_FREE);
+    arena.reset();
+  }
+  scanner_destroy(ctx);
+  ctx->identifiers = nullptr;
+  ctx->arena = nullptr;
+  return failed;
+}
+
+/* The phases after parsing, over ctx->ast, which goes with ctx->arena after */
+static int compileParsed(CompileContext *ctx)
+{
+  if (ctx->stats)
+    ctx->stats->nodes = ast_count_nodes(ctx->ast);
+  semantic_check(ctx);
+/* Phase 3: Call the AST dumping routine if requested */
+  if (ctx->dumpAST) {
+    TraceSpan span(ctx->traceLog, "dump ast", "phase");
+    ast_print(ctx->ast, ctx->dumpFile);
+  }
+/* Phase 4: Add code to call the code generation routine */
+  int failed = ctx->errorOccurred;
+  if (!failed)
+    genCode(ctx);
+  else if (ctx->outputFile)
+    fprintf(ctx->outputFile,"Failed to compile\n");
+
+  ctx->ast = NULL;
+  return failed ? 1 : 0;
+}
+
+/* Parse and generate code in one pass. The program is held back until
+ * the parse succeeds, so a syntax error writes nothing, as it would in
+ * compilePhases. */
+static int compileFast(CompileContext *ctx)
+{
+  std::string program;
+  int parsed;
+  CompileStats before = ctx->stats ? *ctx->stats : CompileStats();
+  scanAlone(ctx);
+  {
+    PhaseTimer timer(ctx->stats, PHASE_PARSE);
+    TraceSpan span(ctx->traceLog, "parse and codegen", "phase");
+    parsed = hand_compile(ctx, &program);
+  }
+  if (ctx->stats) {
+    ctx->stats->wall_ms[PHASE_PARSE] -= ctx->stats->wall_ms[PHASE_SCAN] - before.wall_ms[PHASE_SCAN];
+    ctx->stats->cpu_ms[PHASE_PARSE]  -= ctx->stats->cpu_ms[PHASE_SCAN] - before.cpu_ms[PHASE_SCAN];
+  }
+  if (parsed)
+    return 1;
+
+  OutputBuffer out(ctx);
+  out.append(program);
+  ctx->outputLength = out.length();
+  return 0;
+}
+
+/* For -Tt, scan the whole source once on its own before the parse. A
+ * timer around each token the parser reads costs more than scanning
+ * it, so the time of this pass stands for scanning and is taken off the
+ * parse, which scans again. Errors and traces are left to the parse. A
+ * preprocessed source was scanned when its directives were run. */
+static void scanAlone(CompileContext *ctx)
+{
+  if (!ctx->stats || ctx->preprocessor)
+    return;
+  size_t errors = ctx->diagnostics.size();
+  int errorOccurred = ctx->errorOccurred;
+  FILE *errorFile = ctx->errorFile;
+  int traceScanner = ctx->traceScanner;
+  ctx->errorFile = NULL;
+  ctx->traceScanner = FALSE;
+  {
+    PhaseTimer timer(ctx->stats, PHASE_SCAN);
+    YYSTYPE value = {};
+    YYLTYPE location = {0, 0};
+    while (yylex(&value, &location, ctx->scanner))
+      ;
+  }
+  ctx->errorFile = errorFile;
+  ctx->traceScanner = traceScanner;
+  ctx->diagnostics.resize(errors);
+  ctx->errorOccurred = errorOccurred;
+  scanner_seek(ctx, 0);
+  ctx->yyline = 1;
+}
+
+/***********************************************************************
+ * Compile through ctx->cache. A hit costs one hash of the source and one
+ * read of the stored program, and for a source with directives a stat of
+ * each file it can include and a read of those the include cache does
+ * not hold; nothing is scanned. A miss compiles and stores the program.
+ * Failed compiles are not stored.
+ **********************************************************************/
+static int compileCached(CompileContext *ctx)
+{
+  std::string key = CompileCache::make_key(ctx->sourceText, ctx->sourceLength, cacheFlags(ctx));
+  std::string program;
+  int failed = 0;
+  bool hit;
+  {
+    TraceSpan span(ctx->traceLog, "cache lookup", "cache");
+    hit = ctx->cache->lookup(key, &program);
+  }
+  if (!hit) {
+    std::string *outputText = ctx->outputText;
+    ctx->outputText = &program;
+    failed = compilePreprocessed(ctx);
+    ctx->outputText = outputText;
+    if (!failed) {
+      TraceSpan span(ctx->traceLog, "cache store", "cache");
+      ctx->cache->store(key, program);
+    }
+  }
+
+  if (failed)
+    return failed;
+  OutputBuffer out(ctx);
+  out.append(program);
+  ctx->outputLength = out.length();
+  return 0;
+}
+
+/* Options that change the program, as part of the cache key */
+static std::string cacheFlags(CompileContext *ctx)
+{
+  std::string flags = "-D";
+  if (ctx->dumpInstructions) flags += 'x';
+  if (ctx->dumpSymbols)      flags += 'y';
+  flags += " -T";
+  if (ctx->traceExecution)   flags += 'x';
+  if (ctx->fastCompile)      flags += " -F";
+  if (has_directives(ctx->sourceText, ctx->sourceLength))
+    flags += "\n" + include_stamps(ctx);
+  return flags;
+}
+
+/***********************************************************************
+ * Streaming. The text grows in a SourceBuffer while the push parser is
+ * handed its tokens. A token is only final once the text shows where
+ * it ends, by a blank or punctuator after it that no token runs on
+ * through; until then it waits for the next piece and the scanner later
+ * starts again at it. Its errors wait too, so nothing is reported that
+ * more text would have made right.
+ **********************************************************************/
+struct StreamState
+{
+  SourceBuffer source;
+  LineTable lines{nullptr, 0};
+  StringPool identifiers;
+  Arena arena;
+  yypstate *parser = nullptr;
+  int status = YYPUSH_MORE;    /* Of the last push */
+  size_t scanned = 0;          /* Where the scanner starts next time */
+  int line = 1;                /* ctx->yyline there */
+
+  /* Kept from token to token, as in yyparse: some rules read yylval
+   * after the tokens that follow have been scanned */
+  YYSTYPE value = {};
+  YYLTYPE location = {0, 0};
+
+  /* Once the text shows a '#' the rest waits for finish, which
+   * preprocesses it from where scanning got to */
+  bool preprocess = false;
+};
+
+/* Offset just past which no token can run on, given what follows */
+static size_t settledLength(const char *text, size_t begin, size_t end)
+{
+  while (end > begin) {
+    switch (text[--end]) {
+      case ' ': case '\t': case '\r': case '\n':
+      case ';': case ',': case '(': case ')': case '{': case '}':
+        return end;
+    }
+  }
+  return begin;
+}
+
+/* Push every token that the text so far settles; at the end of the
+ * source that is all of them, and then the end itself */
+static void streamTokens(CompileContext *ctx, StreamState *state, bool at_end)
+{
+  ctx->sourceText = state->source.get_data();
+  ctx->sourceLength = state->source.get_length();
+  state->lines.reset(ctx->sourceText, ctx->sourceLength);
+  scanner_seek(ctx, state->scanned);
+  ctx->yyline = state->line;
+
+  size_t settled = at_end ? ctx->sourceLength
+                          : settledLength(ctx->sourceText, state->scanned, ctx->sourceLength);
+  while (state->status == YYPUSH_MORE) {
+    YYSTYPE value = state->value;
+    size_t errors = ctx->diagnostics.size();
+    int errorOccurred = ctx->errorOccurred;
+    FILE *errorFile = ctx->errorFile;
+    if (!at_end)
+      ctx->errorFile = NULL;
+    int token = yylex(&state->value, &state->location, ctx->scanner);
+    ctx->errorFile = errorFile;
+
+    if (!at_end && (token == 0 || ctx->diagnostics.size() > errors || state->location.end > settled)) {
+      /* Not final. Blanks and comments before a clean token need not be
+       * scanned again, the token itself never spans lines. */
+      if (token != 0 && ctx->diagnostics.size() == errors) {
+        state->scanned = state->location.begin;
+        state->line = ctx->yyline;
+      }
+      ctx->diagnostics.resize(errors);
+      ctx->errorOccurred = errorOccurred;
+      state->value = value;
+      break;
+    }
+    state->scanned = state->location.end;
+    state->line = ctx->yyline;
+    state->status = yypush_parse(state->parser, token, &state->value, &state->location, ctx, ctx->scanner);
+  }
+
+  /* flex leaves a NUL after the last token it read, put it back before
+   * the text is next copied */
+  if (!at_end)
+    scanner_seek(ctx, state->scanned);
+}
+
+/* Push the tokens of the rest of the source, preprocessed */
+static void streamPreprocessed(CompileContext *ctx, StreamState *state, Preprocessor *preprocessor)
+{
+  ctx->sourceText = state->source.get_data();
+  ctx->sourceLength = state->source.get_length();
+  state->lines.reset(ctx->sourceText, ctx->sourceLength);
+  preprocessor->run(state->scanned, state->line);
+  ctx->preprocessor = preprocessor;
+  while (state->status == YYPUSH_MORE) {
+    int token = preprocessor->next(&state->value, &state->location);
+    state->status = yypush_parse(state->parser, token, &state->value, &state->location, ctx, ctx->scanner);
+  }
+}
+
+CompileStream::CompileStream(CompileContext *ctx) : m_ctx(ctx), m_state(new StreamState)
+{
+  ctx->errorOccurred = FALSE;
+  ctx->ast = NULL;
+  m_state->source.append("", 0);
+  ctx->sourceText = m_state->source.get_data();
+  ctx->sourceLength = 0;
+  ctx->lines = &m_state->lines;
+  ctx->identifiers = &m_state->identifiers;
+  ctx->arena = &m_state->arena;
+  m_state->parser = yypstate_new();
+  if (m_state->parser == nullptr || ctx->sourceText == nullptr || scanner_init(ctx)) {
+    if (ctx->errorFile)
+      fprintf(ctx->errorFile, "Unable to initialize the scanner\n");
+    ctx->add_diagnostic(Diagnostic::LEXICAL, 1, 1, "Unable to initialize the scanner");
+    m_state->status = 1;
+  }
+}
+
+CompileStream::~CompileStream()
+{
+  close();
+}
+
+void CompileStream::close()
+{
+  if (m_state == nullptr)
+    return;
+  if (m_ctx->scanner)
+    scanner_destroy(m_ctx);
+  if (m_state->parser)
+    yypstate_delete(m_state->parser);
+  m_ctx->sourceText = nullptr;
+  m_ctx->sourceLength = 0;
+  m_ctx->lines = nullptr;
+  m_ctx->identifiers = nullptr;
+  m_ctx->arena = nullptr;
+  delete m_state;
+  m_state = nullptr;
+}
+
+bool CompileStream::feed(const char *text, size_t length)
+{
+  if (m_state == nullptr)
+    return false;
+  if (m_state->status != YYPUSH_MORE)
+    return true;    /* Parsing has stopped at an error, the rest is not needed */
+  if (length > MAX_SOURCE_LENGTH - m_state->source.get_length() ||
+      !m_state->source.append(text, length)) {
+    m_state->status = 1;
+    return false;
+  }
+  if (!m_state->preprocess)
+    m_state->preprocess = has_directives(m_state->source.get_data() + m_state->scanned,
+                                         m_state->source.get_length() - m_state->scanned);
+  if (!m_state->preprocess)
+    streamTokens(m_ctx, m_state, false);
+  return true;
+}
+
+int CompileStream::finish()
+{
+  if (m_state == nullptr)
+    return 1;
+  std::unique_ptr<Preprocessor> preprocessor;
+  if (m_state->status == YYPUSH_MORE && m_state->preprocess) {
+    preprocessor.reset(new Preprocessor(m_ctx));
+    streamPreprocessed(m_ctx, m_state, preprocessor.get());
+  }
+  else if (m_state->status == YYPUSH_MORE)
+    streamTokens(m_ctx, m_state, true);
+  /* Anything but an accept (a syntax error, or the parser out of
+   * stack) leaves no AST */
+  int failed = m_state->status != 0 ? 1 : compileParsed(m_ctx);
+  m_ctx->preprocessor = nullptr;
+  close();
+  return failed;
+}
+
+/* Stream the input when it is a pipe and nothing needs the whole text
+ * before parsing: the cache key, the source dump, scanner traces and
+ * the phase timing all do, and a fast compile has its own parser */
+static bool canStream(CompileContext *ctx)
+{
+  struct stat st;
+  return !ctx->inputText && !ctx->cache && !ctx->fastCompile && !ctx->dumpSource && !ctx->traceScanner && !ctx->stats &&
+         fstat(fileno(ctx->inputFile), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/* Feed the input to a CompileStream as each read returns */
+static int compileStreamed(CompileContext *ctx)
+{
+  CompileStream stream(ctx);
+  int fd = fileno(ctx->inputFile);
+  char piece[BUFSIZ * 8];
+  for (;;) {
+    ssize_t n = read(fd, piece, sizeof(piece));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n == 0)
+      break;
+    if (n < 0 || !stream.feed(piece, n)) {
+      if (ctx->errorFile)
+        fprintf(ctx->errorFile, "Unable to read the source\n");
+      return 1;
+    }
+  }
+  return stream.finish();
+}
+
+/***********************************************************************
+ * Dump source file, with line numbers.
+ **********************************************************************/
+void sourceDump(CompileContext *ctx)
+{
+  const char *line = ctx->sourceText;
+  const char *end = ctx->sourceText + ctx->sourceLength;
+  int i = 0;
+
+  while (line < end) {
+    const char *newline = (const char *)memchr(line, '\n', end - line);
+    const char *next = newline ? newline + 1 : end;
+    i += 1;
+    fprintf(ctx->dumpFile, "%3d: %.*s", i, (int)(next - line), line);
+    line = next;
+  }
+}
+
+/***********************************************************************
+ * In-memory API. Nothing is printed: errors come back as diagnostics
+ * and the program as text.
+ **********************************************************************/
+CompileResult compile_shader(const char *source, size_t length, CompileCache *cache,
+                             IncludeCache *includes)
+{
+  CompileResult result;
+  QuietContext ctx;
+
+  ctx.inputText    = source;
+  ctx.inputLength  = length;
+  ctx.outputText   = &result.program;
+  ctx.cache        = cache;
+  ctx.includeCache = includes;
+
+  result.success = compileSource(&ctx) == 0 && ctx.diagnostics.empty();
+  if (!result.success)
+    result.program.clear();
+  result.diagnostics.swap(ctx.diagnostics);
+  return result;
+}
+
+CompileResult compile_shader(const std::string &source)
+{
+  return compile_shader(source.data(), source.size());
+}
+
+CompileResult compile_shader_into(const char *source, size_t length, char *program, size_t capacity,
+                                  CompileCache *cache, IncludeCache *includes)
+{
+  CompileResult result;
+  QuietContext ctx;
+
+  ctx.inputText      = source;
+  ctx.inputLength    = length;
+  ctx.outputBuffer   = program;
+  ctx.outputCapacity = capacity;
+  ctx.cache          = cache;
+  ctx.includeCache   = includes;
+
+  result.success = compileSource(&ctx) == 0 && ctx.diagnostics.empty();
+  result.program_length = result.success ? ctx.outputLength : 0;
+  result.diagnostics.swap(ctx.diagnostics);
+  return result;
+}
+
+ShaderStream::ShaderStream() : m_stream(&m_ctx)
+{
+  m_ctx.outputText = &m_result.program;
+}
+
+CompileResult ShaderStream::finish()
+{
+  m_result.success = m_stream.finish() == 0 && m_ctx.diagnostics.empty();
+  if (!m_result.success)
+    m_result.program.clear();
+  m_result.diagnostics.swap(m_ctx.diagnostics);
+  return std::move(m_result);
+}
@@ -0,0 +1,111 @@
+/***********************************************************************
+ * compile.h
+ *
+ * Entry points of libcompiler467. compileSource runs every phase of the
+ * compiler over a prepared CompileContext and is what the command line
+ * driver uses. compile_shader is the in-memory API for programs that
+ * link the compiler in: it takes the source as a buffer and returns the
+ * ARB program and the diagnostics, without touching any FILE*.
+ * CompileStream and ShaderStream do the same for a source that arrives
+ * in pieces, parsing each piece as it comes.
+ **********************************************************************/
+
+#ifndef COMPILE_H_
+#define COMPILE_H_ 1
+
+#include <string>
+#include <vector>
+#include "context.h"
+
+class CompileCache;
+struct StreamState;
+
+/* The context of the in-memory API, with every sink NULL so that nothing
+ * is printed. A member of this type is set up before the members after
+ * it, which may take it and report on it as they are built. */
+class QuietContext : public CompileContext
+{
+  public:
+    QuietContext() {
+        inputFile    = NULL;
+        outputFile   = NULL;
+        errorFile    = NULL;
+        dumpFile     = NULL;
+        traceFile    = NULL;
+        runInputFile = NULL;
+    }
+};
+
+class CompileResult
+{
+  public:
+    bool success = false;
+    std::string program;                  /* ARB program, empty on failure */
+    size_t program_length = 0;            /* Length of the program compile_shader_into wrote */
+    std::vector<Diagnostic> diagnostics;  /* Errors in the order found */
+};
+
+/* Run every phase of the compiler over ctx. Returns 0 when the program
+ * compiled, 1 otherwise. */
+int  compileSource(CompileContext *ctx);
+void sourceDump(CompileContext *ctx);
+
+/* Compile length bytes of MiniGLSL source, through cache if given, with
+ * included files read through includes if given. Safe to call from
+ * several threads at once, sharing both caches. */
+CompileResult compile_shader(const char *source, size_t length, CompileCache *cache = nullptr,
+                             IncludeCache *includes = nullptr);
+CompileResult compile_shader(const std::string &source);
+
+/* Same, writing the program into the caller's buffer of capacity bytes
+ * rather than result.program. When program_length comes back larger
+ * than capacity the program was cut short; retry with a bigger buffer. */
+CompileResult compile_shader_into(const char *source, size_t length, char *program, size_t capacity,
+                                  CompileCache *cache = nullptr, IncludeCache *includes = nullptr);
+
+/* Compile a source that arrives in pieces, from a pipe or a
+ * decompressor say. Each feed scans and parses as far as the text so
+ * far allows, so by the time the last piece is in only the phases after
+ * parsing are left. ctx is set up as for compileSource, less its input
+ * fields; it must not trace the scanner or dump the source, which both
+ * need the whole text up front. */
+class CompileStream
+{
+  private:
+    CompileContext *m_ctx;
+    StreamState *m_state;
+
+    void close();
+
+  public:
+    explicit CompileStream(CompileContext *ctx);
+    ~CompileStream();
+    CompileStream(const CompileStream &) = delete;
+    CompileStream &operator=(const CompileStream &) = delete;
+
+    /* Add the next length bytes of source. Returns false if they can
+     * not be held, which ends the compile. */
+    bool feed(const char *text, size_t length);
+
+    /* The source is complete: parse the rest and run the remaining
+     * phases. Returns 0 when the program compiled, 1 otherwise. */
+    int finish();
+};
+
+/* CompileStream for programs that link the compiler in. Nothing is
+ * printed, finish returns what compile_shader would have. */
+class ShaderStream
+{
+  private:
+    QuietContext m_ctx;
+    CompileResult m_result;
+    CompileStream m_stream;
+
+  public:
+    ShaderStream();
+
+    bool feed(const char *text, size_t length) {return m_stream.feed(text, length);}
+    CompileResult finish();
+};
+
+#endif /* COMPILE_H_ */
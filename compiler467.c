@@ -12,7 +12,8 @@
 
 /***********************************************************************
  * The compiler has the following parts:
- * global variables     globalvars.c common.h languageDef.h
+ * compile context      context.h    common.h languageDef.h
+ * library entry points compile.cpp  compile.h
  * scanner module       scanner.c
  * parser module        parser.c     parser.tab.h
  * abstract syntax tree ast.c        ast.h
@@ -20,12 +21,27 @@
  * semantics analysis   semantic.c   semantic.h
  * code generator       codegen.c    codegen.h
  **********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "common.h"
+#include "context.h"
+#include "threadpool.h"
 
 /* Phases 3,4: Uncomment following includes as needed */
 #include "ast.h"
 #include "semantic.h"
 #include "codegen.h"
+#include "compile.h"
+#include "session.h"
+#include "preprocess.h"
+#include "cache.h"
+#include "server.h"
+#include "trace.h"
 
 /***********************************************************************
  * Default values for various files. Note assumption that default files
@@ -38,9 +54,39 @@
 #define DEFAULT_TRACE_FILE     stdout
 #define DEFAULT_RUN_INPUT_FILE stdin
 
-void  getOpts   (int numargs, char **argstr);
-FILE *fileOpen  (char *fileName, char *fileMode, FILE *defaultFile);
-void  sourceDump(void);
+/* Suffix of the per source program file written in batch mode */
+#define BATCH_OUTPUT_SUFFIX    ".arb"
+
+/* Options of the driver itself, as opposed to those of a single compile */
+struct DriverOptions {
+  std::vector<std::string> sourceFiles;
+  int batchMode  = FALSE;
+  int batchJobs  = 1;     /* Sources compiled in parallel, -j */
+  std::string cacheDirectory;                 /* -C, empty for no cache */
+  long cacheMaxBytes = CACHE_DEFAULT_MAX_BYTES; /* -K */
+  std::string serveSocket;                    /* --serve, empty to compile */
+  std::string traceEventFile;                 /* -J, empty for no timeline */
+  std::string editFile;                       /* -W, empty to compile once */
+};
+
+/* Everything one source of a batch produced, held until its turn to print */
+struct BatchResult {
+  char  *errorText = NULL;
+  size_t errorSize = 0;
+  char  *traceText = NULL; /* Also holds the dumps when both share a sink */
+  size_t traceSize = 0;
+  char  *dumpText  = NULL;
+  size_t dumpSize  = 0;
+  int    done      = FALSE;
+};
+
+void  getOpts   (CompileContext *ctx, DriverOptions *opts, int numargs, char **argstr);
+FILE *fileOpen  (CompileContext *ctx, char *fileName, char *fileMode, FILE *defaultFile);
+void  readResponseFile(CompileContext *ctx, char *fileName, std::vector<std::string> *sourceFiles);
+int   compileBatch (CompileContext *ctx, const DriverOptions &opts);
+void  compileBatchSource(CompileContext *ctx, const std::string &sourceFile, BatchResult *result);
+void  reportBatchSource (CompileContext *ctx, const std::string &sourceFile, BatchResult *result);
+int   compileEdited (CompileContext *ctx, const std::string &editFile);
 
 /* Phase 1: Scanner Interface. For phase 2 and after these declarations
  * are removed */
@@ -50,77 +96,231 @@ extern char *yytext;
 extern int   yyline;
  */
 
-/* Phase 2: Parser Interface. Merely uncomment the following line */
-extern int yyparse(void);
+/* Phase 2: Parser Interface. The parser is driven by compileSource, see
+ * compile.h */
 
 /***********************************************************************
  * Main program for the Compiler
  **********************************************************************/
 int main (int argc, char *argv[]) {
-  getOpts (argc, argv); /* Set up and apply command line options */
+  CompileContext ctx;
+  DriverOptions opts;
+  getOpts (&ctx, &opts, argc, argv); /* Set up and apply command line options */
+
+  CompileCache cache(opts.cacheDirectory, opts.cacheMaxBytes);
+  if (!opts.cacheDirectory.empty()) {
+    if (cache.open())
+      ctx.cache = &cache;
+    else
+      fprintf(ctx.errorFile, "Unable to use cache directory %s\n", opts.cacheDirectory.c_str());
+  }
+
+/* Files included by the sources of a batch are scanned once */
+  IncludeCache includeCache;
+  ctx.includeCache = &includeCache;
+
+  TraceLog traceLog;
+  if (!opts.traceEventFile.empty())
+    ctx.traceLog = &traceLog;
+
+/* As a server, compile requests from clients until killed */
+  if (!opts.serveSocket.empty())
+    return serve(opts.serveSocket.c_str(), ctx.cache, ctx.errorFile);
+
+/* Several sources (or a response file) compile as one batch, one output
+ * per source. A single source keeps the classic behaviour. */
+  if (opts.batchMode)
+    compileBatch(&ctx, opts);
+  else {
+    if (!opts.sourceFiles.empty())
+      ctx.inputFile = fileOpen(&ctx, (char *)opts.sourceFiles.back().c_str(), "r", DEFAULT_INPUT_FILE);
+    if (ctx.inputFile != DEFAULT_INPUT_FILE)
+      ctx.sourceName = opts.sourceFiles.back().c_str();
+    if (!opts.editFile.empty())
+      compileEdited(&ctx, opts.editFile);
+    else
+      compileSource(&ctx);
+  }
+
+  if (ctx.traceLog) {
+    FILE *traceEventFile = fopen(opts.traceEventFile.c_str(), "w");
+    if (traceEventFile) {
+      traceLog.write(traceEventFile);
+      fclose(traceEventFile);
+    } else
+      fprintf(ctx.errorFile, "Unable to open file %s\n", opts.traceEventFile.c_str());
+  }
+
+  if (ctx.traceCache && ctx.cache)
+    fprintf(ctx.traceFile, "CACHE: %ld hits, %ld misses, %ld stores, %ld evictions\n",
+            cache.get_hits(), cache.get_misses(), cache.get_stores(), cache.get_evictions());
+  if (ctx.traceCache && (includeCache.get_scanned() || includeCache.get_reused()))
+    fprintf(ctx.traceFile, "INCLUDES: %ld scanned, %ld reused\n",
+            includeCache.get_scanned(), includeCache.get_reused());
 
 /***********************************************************************
- * Compiler Initialization.
- *
- * If explicit initialization of any phase of the compilation is needed,
- * calls to initialization routines in the applicable modules are placed
- * here.
+ * Post Compilation Cleanup
  **********************************************************************/
-  errorOccurred = FALSE;
+
+  /* Clean up files if necessary */
+  if (ctx.inputFile != DEFAULT_INPUT_FILE)
+    fclose (ctx.inputFile);
+  if (ctx.errorFile != DEFAULT_ERROR_FILE)
+    fclose (ctx.errorFile);
+  if (ctx.dumpFile != DEFAULT_DUMP_FILE)
+    fclose (ctx.dumpFile);
+  if (ctx.traceFile != DEFAULT_TRACE_FILE)
+    fclose (ctx.traceFile);
+  if (ctx.outputFile != DEFAULT_OUTPUT_FILE)
+    fclose (ctx.outputFile);
+  if (ctx.runInputFile != DEFAULT_RUN_INPUT_FILE)
+    fclose (ctx.runInputFile);
+
+  return 0;
+}
 
 /***********************************************************************
- * Start the Compilation
+ * Compile every source of a batch, opts.batchJobs at a time. Each source
+ * gets its own context (copied from the command line one), its program
+ * is written to "<source>.arb" and its error messages are reported under
+ * its name. Whatever the number of jobs, reports come out in the order
+ * the sources were given: a finished source is held until all sources
+ * before it have been reported.
  **********************************************************************/
-  if (dumpSource)
-    sourceDump();
+int compileBatch (CompileContext *ctx, const DriverOptions &opts) {
+  const std::vector<std::string> &sourceFiles = opts.sourceFiles;
+  int sourceCount = (int)sourceFiles.size();
+  std::vector<BatchResult> results(sourceCount);
+  std::mutex reportLock;
+  int nextReport = 0;
 
-/* Phase 1: Scanner. In phase 2 and after the following code should be
- * removed */
-/*
-  while (yylex())
-    if (errorOccurred)
-      break;
- */
+  TraceSpan span(ctx->traceLog, "batch", "batch");
+  WorkStealingPool pool(opts.batchJobs);
+  pool.run(sourceCount, [&](int source) {
+    compileBatchSource(ctx, sourceFiles[source], &results[source]);
 
-/* Phase 2: Parser -- should allocate an AST, storing the reference in the
- * global variable "ast", and build the AST there. */
-  if(1 == yyparse()) {
-    return 0; // parse failed
-  }
-  semantic_check(ast);
-/* Phase 3: Call the AST dumping routine if requested */
-  if (dumpAST) {
-    ast_print(ast);
-  }
-/* Phase 4: Add code to call the code generation routine */
-/* TODO: call your code generation routine here */
-  if (errorOccurred)
-    fprintf(outputFile,"Failed to compile\n");
+    std::lock_guard<std::mutex> guard(reportLock);
+    results[source].done = TRUE;
+    while (nextReport < sourceCount && results[nextReport].done) {
+      reportBatchSource(ctx, sourceFiles[nextReport], &results[nextReport]);
+      nextReport++;
+    }
+  });
+  return 0;
+}
+
+/***********************************************************************
+ * Compile one source of a batch. Errors, traces and dumps are collected
+ * in result rather than written, since other sources may be compiling
+ * at the same time.
+ **********************************************************************/
+void compileBatchSource (CompileContext *ctx, const std::string &sourceFile, BatchResult *result) {
+  CompileContext fileCtx = *ctx;
+
+  fileCtx.errorFile = open_memstream(&result->errorText, &result->errorSize);
+  fileCtx.traceFile = open_memstream(&result->traceText, &result->traceSize);
+  if (ctx->dumpFile == ctx->traceFile)
+    fileCtx.dumpFile = fileCtx.traceFile; /* Keep traces and dumps interleaved */
   else
-    genCode(ast);
-    ;
+    fileCtx.dumpFile = open_memstream(&result->dumpText, &result->dumpSize);
+
+  fileCtx.sourceName = sourceFile.c_str();
+  fileCtx.inputFile = fopen(sourceFile.c_str(), "r");
+  std::string outputName = sourceFile + BATCH_OUTPUT_SUFFIX;
+  if (fileCtx.inputFile == NULL)
+    fprintf(fileCtx.errorFile, "Unable to open file %s\n", sourceFile.c_str());
+  else if ((fileCtx.outputFile = fopen(outputName.c_str(), "w")) == NULL)
+    fprintf(fileCtx.errorFile, "Unable to open file %s\n", outputName.c_str());
+  else {
+    compileSource(&fileCtx);
+    fclose(fileCtx.outputFile);
+  }
+  if (fileCtx.inputFile != NULL)
+    fclose(fileCtx.inputFile);
+
+  fclose(fileCtx.errorFile);
+  if (fileCtx.dumpFile != fileCtx.traceFile)
+    fclose(fileCtx.dumpFile);
+  fclose(fileCtx.traceFile);
+}
+
 /***********************************************************************
- * Post Compilation Cleanup
+ * Write out, and release, what one source of a batch produced.
  **********************************************************************/
+void reportBatchSource (CompileContext *ctx, const std::string &sourceFile, BatchResult *result) {
+  if (result->traceSize > 0)
+    fputs(result->traceText, ctx->traceFile);
+  if (result->dumpSize > 0)
+    fputs(result->dumpText, ctx->dumpFile);
+  if (result->errorSize > 0)
+    fprintf(ctx->errorFile, "%s:\n%s", sourceFile.c_str(), result->errorText);
+  free(result->traceText);
+  free(result->dumpText);
+  free(result->errorText);
+  result->traceText = result->dumpText = result->errorText = NULL;
+}
 
-/* Make calls to any cleanup or finalization routines here. */
-  ast_free(ast);
+/***********************************************************************
+ * Compile the source, then apply the edits in editFile to it one at a
+ * time through a CompileSession, as an editor would, compiling after
+ * each. Only the last compile is reported. Each edit is a line
+ * "offset removed length" followed by length bytes of new text. With
+ * -Tt the time and the work of each edit are traced.
+ **********************************************************************/
+int compileEdited (CompileContext *ctx, const std::string &editFile) {
+  struct Edit {
+    size_t offset, removed;
+    std::string text;
+  };
+  std::vector<Edit> edits;
 
-  /* Clean up files if necessary */
-  if (inputFile != DEFAULT_INPUT_FILE)
-    fclose (inputFile);
-  if (errorFile != DEFAULT_ERROR_FILE)
-    fclose (errorFile);
-  if (dumpFile != DEFAULT_DUMP_FILE)
-    fclose (dumpFile);
-  if (traceFile != DEFAULT_TRACE_FILE)
-    fclose (traceFile);
-  if (outputFile != DEFAULT_OUTPUT_FILE)
-    fclose (outputFile);
-  if (runInputFile != DEFAULT_RUN_INPUT_FILE)
-    fclose (runInputFile);
+  FILE *editInput = fopen(editFile.c_str(), "rb");
+  if (editInput == NULL) {
+    fprintf(ctx->errorFile, "Unable to open file %s\n", editFile.c_str());
+    return 1;
+  }
+  size_t offset, removed, length;
+  while (fscanf(editInput, "%zu %zu %zu", &offset, &removed, &length) == 3) {
+    Edit edit = {offset, removed, std::string(length, '\0')};
+    if (fgetc(editInput) != '\n' || fread(&edit.text[0], 1, length, editInput) != length) {
+      fprintf(ctx->errorFile, "Malformed edit in %s\n", editFile.c_str());
+      fclose(editInput);
+      return 1;
+    }
+    edits.push_back(edit);
+  }
+  fclose(editInput);
 
-  return 0;
+  std::string source;
+  char piece[BUFSIZ];
+  size_t n;
+  while ((n = fread(piece, 1, sizeof(piece), ctx->inputFile)) > 0)
+    source.append(piece, n);
+
+  /* Every compile but the last is silent */
+  FILE *outputFile = ctx->outputFile;
+  FILE *errorFile = ctx->errorFile;
+  if (!edits.empty())
+    ctx->outputFile = ctx->errorFile = NULL;
+
+  CompileSession session(ctx);
+  int failed = session.compile(source.data(), source.size());
+  for (size_t i = 0; i < edits.size(); i++) {
+    if (i + 1 == edits.size()) {
+      ctx->outputFile = outputFile;
+      ctx->errorFile = errorFile;
+    }
+    auto start = std::chrono::steady_clock::now();
+    failed = session.edit(edits[i].offset, edits[i].removed, edits[i].text.data(), edits[i].text.size());
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    const SessionWork &work = session.get_work();
+    if (ctx->traceTiming)
+      fprintf(ctx->traceFile, "EDIT %zu: %.3f ms, %zu bytes parsed%s, %zu of %zu parts checked\n",
+              i + 1, elapsed.count(), work.parsed_bytes, work.reparsed_all ? " (all)" : "",
+              work.checked_parts, work.parts);
+  }
+  return failed;
 }
 
 /***********************************************************************
@@ -130,31 +330,37 @@ Internal Subroutines.
 /***********************************************************************
 Subroutines for reading command line input and initializing IO files.
 ***********************************************************************/
-void getOpts (int numargs, char **argstr) {
+void getOpts (CompileContext *ctx, DriverOptions *opts, int numargs, char **argstr) {
   char *optarg;
   char *subarg;
   int   i;
   char  optch;
 
-  /* Initialize global variables to default values */
-  inputFile         = DEFAULT_INPUT_FILE;
-  outputFile        = DEFAULT_OUTPUT_FILE;
-  errorFile         = DEFAULT_ERROR_FILE;
-  dumpFile          = DEFAULT_DUMP_FILE;
-  traceFile         = DEFAULT_TRACE_FILE;
-  runInputFile      = DEFAULT_RUN_INPUT_FILE;
+  /* Initialize context streams to default values */
+  ctx->inputFile         = DEFAULT_INPUT_FILE;
+  ctx->outputFile        = DEFAULT_OUTPUT_FILE;
+  ctx->errorFile         = DEFAULT_ERROR_FILE;
+  ctx->dumpFile          = DEFAULT_DUMP_FILE;
+  ctx->traceFile         = DEFAULT_TRACE_FILE;
+  ctx->runInputFile      = DEFAULT_RUN_INPUT_FILE;
 
   /* Initialize control flags */
-  suppressExecution = FALSE;
+  ctx->suppressExecution = FALSE;
+
+  ctx->traceScanner      = FALSE;
+  ctx->traceParser       = FALSE;
+  ctx->traceExecution    = FALSE;
+  ctx->traceCache        = FALSE;
+  ctx->traceTiming       = FALSE;
 
-  traceScanner      = FALSE;
-  traceParser       = FALSE;
-  traceExecution    = FALSE;
+  ctx->dumpSource        = FALSE;
+  ctx->dumpAST           = FALSE;
+  ctx->dumpSymbols       = FALSE;
+  ctx->dumpInstructions  = FALSE;
 
-  dumpSource        = FALSE;
-  dumpAST           = FALSE;
-  dumpSymbols       = FALSE;
-  dumpInstructions  = FALSE;
+  ctx->handParser        = HAND_PARSER;
+  ctx->fastCompile       = FALSE;
+  ctx->flatCodegen       = FALSE;
 
   /* Process command line input */
   for (i=1; i<numargs; i++) {
@@ -166,11 +372,11 @@ void getOpts (int numargs, char **argstr) {
           optch = *(subarg++);
           while (optch) {
             switch (optch) {
-              case 'a': dumpAST          = TRUE; break;
-              case 's': dumpSource       = TRUE; break;
-              case 'x': dumpInstructions = TRUE; break;
-              case 'y': dumpSymbols      = TRUE; break;
-              default: fprintf(errorFile, "Invalid dump option %c ignored\n", optch); break ;
+              case 'a': ctx->dumpAST          = TRUE; break;
+              case 's': ctx->dumpSource       = TRUE; break;
+              case 'x': ctx->dumpInstructions = TRUE; break;
+              case 'y': ctx->dumpSymbols      = TRUE; break;
+              default: fprintf(ctx->errorFile, "Invalid dump option %c ignored\n", optch); break ;
             }
             optch = *(subarg++);
           }
@@ -179,10 +385,12 @@ void getOpts (int numargs, char **argstr) {
           optch = *(subarg++);
           while (optch) {
             switch (optch) {
-              case 'n': traceScanner   = TRUE; break;
-              case 'p': traceParser    = TRUE; break;
-              case 'x': traceExecution = TRUE; break;
-              default: fprintf(errorFile, "Invalid trace option %c ignored\n", optch); break;
+              case 'n': ctx->traceScanner   = TRUE; break;
+              case 'p': ctx->traceParser    = TRUE; break;
+              case 'x': ctx->traceExecution = TRUE; break;
+              case 'c': ctx->traceCache     = TRUE; break;
+              case 't': ctx->traceTiming    = TRUE; break;
+              default: fprintf(ctx->errorFile, "Invalid trace option %c ignored\n", optch); break;
             }
             optch = *(subarg++);
           }
@@ -190,77 +398,153 @@ void getOpts (int numargs, char **argstr) {
         case 'O': /* Alternative output file */
           if (optarg[2] == 0) {
             i += 1;
-            outputFile = fileOpen (argstr[i], "w", DEFAULT_OUTPUT_FILE);
-          printf("%s\n",argstr[i]);
+            ctx->outputFile = fileOpen (ctx, argstr[i], "w", DEFAULT_OUTPUT_FILE);
           } else
-            outputFile = fileOpen (&optarg[2], "w", DEFAULT_OUTPUT_FILE);
-          printf("%s\n",&optarg[2]);
+            ctx->outputFile = fileOpen (ctx, &optarg[2], "w", DEFAULT_OUTPUT_FILE);
           break;
         case 'E': /* Alternative error message file */
           if (optarg[2] == 0) {
             i += 1;
-            errorFile = fileOpen (argstr[i], "w", DEFAULT_OUTPUT_FILE);
+            ctx->errorFile = fileOpen (ctx, argstr[i], "w", DEFAULT_OUTPUT_FILE);
           } else
-            errorFile = fileOpen (&optarg[2], "w", DEFAULT_ERROR_FILE);
+            ctx->errorFile = fileOpen (ctx, &optarg[2], "w", DEFAULT_ERROR_FILE);
           break;
         case 'R': /* Alternative sink for traces */
           if (optarg[2] == 0) {
             i += 1;
-            traceFile = fileOpen (argstr[i], "w", DEFAULT_TRACE_FILE);
+            ctx->traceFile = fileOpen (ctx, argstr[i], "w", DEFAULT_TRACE_FILE);
           } else
-            traceFile = fileOpen (&optarg[2], "w", DEFAULT_TRACE_FILE);
+            ctx->traceFile = fileOpen (ctx, &optarg[2], "w", DEFAULT_TRACE_FILE);
           break;
         case 'U': /* Alternative sink for dumps */
           if (optarg[2] == 0) {
             i += 1;
-            dumpFile = fileOpen (argstr[i], "w", DEFAULT_DUMP_FILE);
+            ctx->dumpFile = fileOpen (ctx, argstr[i], "w", DEFAULT_DUMP_FILE);
           } else
-            dumpFile = fileOpen (&optarg[2], "w", DEFAULT_DUMP_FILE);
+            ctx->dumpFile = fileOpen (ctx, &optarg[2], "w", DEFAULT_DUMP_FILE);
           break;
         case 'I': /* Alternative input during execution */
           if (optarg[2] == 0) {
             i += 1;
-            runInputFile = fileOpen (argstr[i], "r", DEFAULT_RUN_INPUT_FILE);
+            ctx->runInputFile = fileOpen (ctx, argstr[i], "r", DEFAULT_RUN_INPUT_FILE);
           } else
-            runInputFile = fileOpen (&optarg[2], "r", DEFAULT_RUN_INPUT_FILE);
+            ctx->runInputFile = fileOpen (ctx, &optarg[2], "r", DEFAULT_RUN_INPUT_FILE);
+          break;
+        case 'P': /* Hand written parser in place of bison's */
+          ctx->handParser = TRUE;
+          break;
+        case 'F': /* Fast compile of trusted sources */
+          ctx->fastCompile = TRUE;
+          break;
+        case 'L': /* Code generation over a FlatTree laid out from the AST */
+          ctx->flatCodegen = TRUE;
           break;
         case 'X': /* supress execution flag */
-          suppressExecution = TRUE;
+          ctx->suppressExecution = TRUE;
+          break;
+        case 'J': /* Timeline of the run as trace-event JSON */
+          if (optarg[2] == 0) {
+            i += 1;
+            if (i < numargs)
+              opts->traceEventFile = argstr[i];
+          } else
+            opts->traceEventFile = &optarg[2];
+          break;
+        case 'W': /* Edits to apply to the source, one compile each */
+          if (optarg[2] == 0) {
+            i += 1;
+            if (i < numargs)
+              opts->editFile = argstr[i];
+          } else
+            opts->editFile = &optarg[2];
+          break;
+        case 'C': /* Directory of the compile cache */
+          if (optarg[2] == 0) {
+            i += 1;
+            if (i < numargs)
+              opts->cacheDirectory = argstr[i];
+          } else
+            opts->cacheDirectory = &optarg[2];
+          break;
+        case 'K': /* Size cap of the compile cache, in kilobytes */
+          if (optarg[2] == 0) {
+            i += 1;
+            opts->cacheMaxBytes = i < numargs ? atol(argstr[i]) * 1024 : 0;
+          } else
+            opts->cacheMaxBytes = atol(&optarg[2]) * 1024;
+          if (opts->cacheMaxBytes <= 0)
+            opts->cacheMaxBytes = CACHE_DEFAULT_MAX_BYTES;
+          break;
+        case 'j': /* Parallel batch jobs, 0 for one per hardware thread */
+          if (optarg[2] == 0) {
+            i += 1;
+            opts->batchJobs = i < numargs ? atoi(argstr[i]) : 1;
+          } else
+            opts->batchJobs = atoi(&optarg[2]);
+          if (opts->batchJobs <= 0)
+            opts->batchJobs = (int)std::thread::hardware_concurrency();
+          if (opts->batchJobs <= 0)
+            opts->batchJobs = 1;
+          break;
+        case '-': /* Long options */
+          if (strcmp(optarg, "--serve") == 0) {
+            i += 1;
+            if (i < numargs)
+              opts->serveSocket = argstr[i];
+            else
+              fprintf(ctx->errorFile, "Option --serve needs a socket path\n");
+          } else
+            fprintf(ctx->errorFile, "Unknown option %s (ignored)\n", optarg);
           break;
         default: /* Anything else */
           fprintf(stderr,"Unknown option character %c (ignored)\n", optch);
           break;
       }
+    } else if (optarg[0] == '@') { /* Response file listing sources */
+      readResponseFile(ctx, optarg + 1, &opts->sourceFiles);
+      opts->batchMode = TRUE;
     } else /* Source file */
-      inputFile = fileOpen(optarg , "r", DEFAULT_INPUT_FILE);
+      opts->sourceFiles.push_back(optarg);
   }
+  if (opts->sourceFiles.size() > 1)
+    opts->batchMode = TRUE;
 }
 
 /***********************************************************************
- * Utility for opening files
+ * Read a response file, one source file name per line. Blank lines are
+ * skipped.
  **********************************************************************/
-FILE *fileOpen (char *fileName, char *fileMode, FILE *defaultFile) {
-  FILE * fTemp;
+void readResponseFile (CompileContext *ctx, char *fileName, std::vector<std::string> *sourceFiles) {
+  char  linebuf[MAX_TEXT];
+  FILE *responseFile;
 
-  if ((fTemp = fopen (fileName, fileMode)) != NULL)
-    return fTemp;
-  else {
-    fprintf (errorFile, "Unable to open file %s\n", fileName);
-    return defaultFile;
+  if ((responseFile = fopen (fileName, "r")) == NULL) {
+    fprintf (ctx->errorFile, "Unable to open file %s\n", fileName);
+    return;
   }
+  while (fgets(linebuf, MAX_TEXT, responseFile)) {
+    char *begin = linebuf;
+    char *end = linebuf + strlen(linebuf);
+    while (*begin == ' ' || *begin == '\t')
+      begin++;
+    while (end > begin && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+      end--;
+    if (end > begin)
+      sourceFiles->push_back(std::string(begin, end));
+  }
+  fclose(responseFile);
 }
 
 /***********************************************************************
- * Dump source file, with line numbers.
+ * Utility for opening files
  **********************************************************************/
-void sourceDump (void) {
-  char srcbuf[MAX_TEXT];
-  int i = 0;
+FILE *fileOpen (CompileContext *ctx, char *fileName, char *fileMode, FILE *defaultFile) {
+  FILE * fTemp;
 
-  while (fgets(srcbuf, MAX_TEXT, inputFile)) {
-    i += 1;
-    fprintf(dumpFile, "%3d: %s", i, srcbuf);
+  if ((fTemp = fopen (fileName, fileMode)) != NULL)
+    return fTemp;
+  else {
+    fprintf (ctx->errorFile, "Unable to open file %s\n", fileName);
+    return defaultFile;
   }
-  rewind(inputFile);
 }
-
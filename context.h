@@ -0,0 +1,168 @@
+/***********************************************************************
+ * context.h
+ *
+ * The compile context. Everything a single compilation reads or writes
+ * (streams, control flags, scanner state and the AST root) lives in one
+ * CompileContext, so several compiles can run in one address space.
+ **********************************************************************/
+
+#ifndef CONTEXT_H_
+#define CONTEXT_H_ 1
+
+#include <string>
+#include <vector>
+#include "common.h"
+
+/* Whether compiles use the hand written parser unless told otherwise */
+#ifndef HAND_PARSER
+#define HAND_PARSER FALSE
+#endif
+
+class Node;
+class CompileCache;
+class CompileStats;
+class TraceLog;
+class StringPool;
+class Arena;
+class LineTable;
+class IncludeCache;
+class Preprocessor;
+
+/* One error found while compiling, kept in structured form alongside
+ * (or, for library callers, instead of) the text written to errorFile */
+class Diagnostic
+{
+  public:
+    enum Phase {LEXICAL, SYNTAX, SEMANTIC};
+
+    Phase phase;
+    int line;
+    int column;
+    std::string message;
+    std::string file;    /* Included file the error is in, empty for the source */
+};
+
+/* Opaque handle to a reentrant scanner, same guard as the flex output */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+class CompileContext
+{
+  public:
+    /* Sinks for compiler output and sources for compiler input. A NULL
+     * error, trace or dump file discards that output. */
+    FILE *inputFile    = stdin;
+    FILE *outputFile   = stdout;
+    FILE *errorFile    = stderr;
+    FILE *dumpFile     = stdout;
+    FILE *traceFile    = stdout;
+    FILE *runInputFile = stdin;
+
+    /* Name of the source being compiled, NULL for standard input */
+    const char *sourceName = nullptr;
+
+    /* In-memory source and program text. When inputText is set the
+     * scanner reads it instead of inputFile, and when outputText is set
+     * the program is appended to it instead of written to outputFile.
+     * Failing that, when outputBuffer is set the program is written into
+     * its outputCapacity bytes. outputLength receives the length of the
+     * program, which exceeds outputCapacity if it did not fit. */
+    const char  *inputText   = nullptr;
+    size_t       inputLength = 0;
+    std::string *outputText  = nullptr;
+    char        *outputBuffer   = nullptr;
+    size_t       outputCapacity = 0;
+    size_t       outputLength   = 0;
+
+    /* The whole source followed by two NULs, read once by compileSource
+     * and shared by the scanner, the source dump and diagnostics. Lines
+     * turns the byte offsets in token and node locations into lines and
+     * columns for messages. */
+    char        *sourceText   = nullptr;
+    size_t       sourceLength = 0;
+    LineTable   *lines        = nullptr;
+
+    /* Control flags, set from the command line */
+    int errorOccurred     = FALSE;
+    int suppressExecution = FALSE;
+
+    int traceScanner   = FALSE;
+    int traceParser    = FALSE;
+    int traceExecution = FALSE;
+    int traceCache     = FALSE;
+    int traceTiming    = FALSE;
+
+    int dumpSource       = FALSE;
+    int dumpAST          = FALSE;
+    int dumpSymbols      = FALSE;
+    int dumpInstructions = FALSE;
+
+    /* Parse with the hand written parser of handparse.cpp, not bison's.
+     * HAND_PARSER is the default, which "make PARSER=hand" turns on. */
+    int handParser = HAND_PARSER;
+
+    /* Write the program while parsing, with no AST and no semantic
+     * check, for trusted sources already known to compile (-F) */
+    int fastCompile = FALSE;
+
+    /* Generate code from a FlatTree laid out from the AST rather than by
+     * visiting the AST itself (-L), to compare the two */
+    int flatCodegen = FALSE;
+
+    /* Scanner line, used for error messages */
+    int yyline   = 1;
+    yyscan_t scanner = nullptr;
+
+    /* Identifiers interned by the scanner, alive until code generation ends */
+    StringPool *identifiers = nullptr;
+
+    /* Where the nodes of the AST are made, released with the tree */
+    Arena *arena = nullptr;
+
+    /* Phase timing and counters of the running compile, NULL unless -Tt */
+    CompileStats *stats = nullptr;
+
+    /* Timeline of the run for -J, NULL when not tracing */
+    TraceLog *traceLog = nullptr;
+
+    /* Cache of compiled programs, or NULL to always compile */
+    CompileCache *cache = nullptr;
+
+    /* Scanned included files, shared by a batch, or NULL to scan them
+     * for each compile */
+    IncludeCache *includeCache = nullptr;
+
+    /* Tokens of a source with directives, which the parser reads in
+     * place of the scanner's; NULL for a source without */
+    Preprocessor *preprocessor = nullptr;
+
+    /* Root of the AST built by the parser */
+    Node *ast = nullptr;
+
+    /* Every error reported so far, in the order found */
+    std::vector<Diagnostic> diagnostics;
+
+    void add_diagnostic(Diagnostic::Phase phase, int line, int column, const std::string &message,
+                        const char *file = nullptr) {
+        diagnostics.push_back(Diagnostic{phase, line, column, message, file ? file : ""});
+        errorOccurred = TRUE;
+    }
+};
+
+/***********************************************************************
+ * Scanner lifecycle, implemented by the lexer module. scanner_init
+ * creates ctx->scanner reading ctx->sourceText in place. Tokens point into
+ * that text, so it has to outlive the AST. Identifiers are interned into
+ * ctx->identifiers and lexical errors are located with ctx->lines, so
+ * both have to be set as well.
+ **********************************************************************/
+int  scanner_init(CompileContext *ctx);
+void scanner_destroy(CompileContext *ctx);
+
+/* Carry on scanning ctx->sourceText from offset, outside any comment,
+ * after the text has grown or moved. yyline is left to the caller. */
+void scanner_seek(CompileContext *ctx, size_t offset);
+
+#endif /* CONTEXT_H_ */
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include "ast.h"
+#include "flat.h"
+
+/* Appends each node after its children. The indices of the nodes whose
+ * parent has not been appended yet wait in m_pending, so a node with n
+ * children takes the last n there as its children, and their subtrees,
+ * which end just before it, as its own. */
+class FlattenVisitor : public TreeWalker<FlattenVisitor>
+{
+  private:
+    FlatTree *m_tree;
+    std::vector<uint32_t> m_pending;
+
+    FlatNode &end(FlatKind kind, size_t child_count) {
+        size_t first_pending = m_pending.size() - child_count;
+        uint32_t index = (uint32_t)m_tree->nodes.size();
+        uint32_t first = child_count ? m_tree->get_first(m_pending[first_pending]) : index;
+        m_tree->nodes.emplace_back();
+        FlatNode &node = m_tree->nodes.back();
+        node.kind = kind;
+        node.size = index + 1 - first;
+        node.first_child = (uint32_t)m_tree->children.size();
+        m_tree->children.insert(m_tree->children.end(), m_pending.begin() + first_pending, m_pending.end());
+        m_pending.resize(first_pending);
+        m_pending.push_back(index);
+        return node;
+    }
+
+    uint32_t add_name(std::string_view name) {
+        m_tree->names.push_back(name);
+        return (uint32_t)m_tree->names.size() - 1;
+    }
+
+  public:
+    FlattenVisitor(FlatTree *tree) : m_tree(tree) {}
+    using TreeWalker<FlattenVisitor>::enter;
+
+    void leave(Scope *scope) {end(FLAT_SCOPE, 2);}
+    void leave(Declarations *decls) {end(FLAT_DECLARATIONS, decls->declaration_list.size());}
+    void leave(Declaration *decl) {
+        FlatNode &node = end(FLAT_DECLARATION, decl->initial_val ? 2 : 1);
+        node.symbol = decl->symbol;
+        node.flags = decl->get_is_const() ? FLAT_IS_CONST : 0;
+    }
+    void leave(Type *type) {end(FLAT_TYPE, 0).type = type->desc;}
+
+    void leave(Statements *stmts) {end(FLAT_STATEMENTS, stmts->get_statement_list().size());}
+    void leave(AssignStatement *as_stmt) {end(FLAT_ASSIGNMENT, 2);}
+    void leave(IfStatement *if_statement) {end(FLAT_IF, if_statement->else_statement ? 3 : 2);}
+    void leave(NestedScope *ns) {end(FLAT_NESTED_SCOPE, 1);}
+    void leave(EmptyStatement *es) {end(FLAT_EMPTY, 0);}
+
+    void leave(ConstructorExpression *ce) {end(FLAT_CONSTRUCTOR_EXPRESSION, 1);}
+    void leave(FloatLiteralExpression *fle) {end(FLAT_FLOAT_LITERAL, 0).float_value = fle->float_literal;}
+    void leave(BoolLiteralExpression *ble) {end(FLAT_BOOL_LITERAL, 0).bool_value = ble->bool_literal;}
+    void leave(IntLiteralExpression *ile) {end(FLAT_INT_LITERAL, 0).int_value = ile->int_literal;}
+    void leave(UnaryExpression *ue) {end(FLAT_UNARY, 1).operator_type = ue->operator_type;}
+    void leave(BinaryExpression *be) {end(FLAT_BINARY, 2).operator_type = be->operator_type;}
+    void leave(VariableExpression *ve) {end(FLAT_VARIABLE_EXPRESSION, 1);}
+    void leave(FunctionExpression *fe) {end(FLAT_FUNCTION_EXPRESSION, 1);}
+
+    void leave(Function *f) {end(FLAT_FUNCTION, 1).name = add_name(f->function_name);}
+    void leave(Constructor *c) {end(FLAT_CONSTRUCTOR, 2);}
+    /* A call without arguments has a null one, which is not walked */
+    void leave(Arguments *args) {
+        const NodeList<Expression *> &list = args->get_expression_list();
+        end(FLAT_ARGUMENTS, list.size() - std::count(list.begin(), list.end(), nullptr));
+    }
+    void leave(IdentifierNode *var) {end(FLAT_IDENTIFIER, 0).symbol = var->symbol;}
+    /* The type of a vector variable is its declaration's, not a child */
+    void leave(VectorVariable *vec_var) {
+        FlatNode &node = end(FLAT_VECTOR_VARIABLE, 0);
+        node.symbol = vec_var->symbol;
+        node.vector_index = (uint8_t)vec_var->vector_index;
+    }
+};
+
+void FlatTree::build(Node *root)
+{
+    FlattenVisitor visitor(this);
+    visitor.walk(root);
+}
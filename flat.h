@@ -0,0 +1,113 @@
+/***********************************************************************
+ * flat.h
+ *
+ * The AST laid out in arrays, for passes that only read the tree. Every
+ * node of the tree becomes one FlatNode, stored in post-order: a node
+ * comes after all of its descendants, and its subtree is the run of
+ * nodes ending at it. An expression can be translated by going through
+ * its run from first to last, each operand ready before the operator
+ * that uses it, with no pointers to chase.
+ *
+ * The children of a node, in the order of the tree, are a run of
+ * indices in FlatTree::children, which ends where the run of the next
+ * node begins. Attributes of a node (a literal, an operator, a symbol)
+ * are held in the node itself; names are indices into FlatTree::names.
+ * A node takes 16 bytes.
+ *
+ * A FlatTree is built from a tree that has been checked, and is a copy
+ * of it: the tree can be edited or released while the FlatTree is in
+ * use, as long as the source text stays.
+ **********************************************************************/
+
+#ifndef FLAT_H_
+#define FLAT_H_ 1
+
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+#include "intern.h"
+#include "types.h"
+
+class Node;
+
+/* The class of the node a FlatNode was made from */
+enum FlatKind : uint8_t
+{
+    FLAT_SCOPE,
+    FLAT_DECLARATIONS,
+    FLAT_DECLARATION,            /* type, initial value if any */
+    FLAT_TYPE,
+    FLAT_STATEMENTS,
+    FLAT_ASSIGNMENT,             /* variable, expression */
+    FLAT_IF,                     /* condition, statement, else statement if any */
+    FLAT_NESTED_SCOPE,
+    FLAT_EMPTY,
+
+    FLAT_CONSTRUCTOR_EXPRESSION,
+    FLAT_FLOAT_LITERAL,
+    FLAT_BOOL_LITERAL,
+    FLAT_INT_LITERAL,
+    FLAT_UNARY,                  /* operand */
+    FLAT_BINARY,                 /* left, right */
+    FLAT_VARIABLE_EXPRESSION,
+    FLAT_FUNCTION_EXPRESSION,
+
+    FLAT_FUNCTION,
+    FLAT_CONSTRUCTOR,            /* type, arguments */
+    FLAT_ARGUMENTS,
+    FLAT_IDENTIFIER,
+    FLAT_VECTOR_VARIABLE,
+};
+
+/* FlatNode::flags */
+enum
+{
+    FLAT_IS_CONST = 1 << 0,    /* A const declaration */
+};
+
+struct FlatNode
+{
+    FlatKind kind;
+    uint8_t flags;
+    uint8_t vector_index;    /* Vector variables */
+    uint32_t size;           /* Nodes in the subtree, this one included */
+    uint32_t first_child;    /* Into FlatTree::children */
+    union {
+        int int_value;
+        float float_value;
+        bool bool_value;
+        int operator_type;    /* Unary and binary expressions */
+        SymbolId symbol;      /* Declarations, identifiers, vector variables */
+        TypeDesc type;        /* Types */
+        uint32_t name;        /* Functions, into FlatTree::names */
+    };
+
+    /* TypeDesc has a constructor of its own, so the union needs one */
+    FlatNode() : kind(FLAT_EMPTY), flags(0), vector_index(0), size(0), first_child(0), int_value(0) {}
+};
+static_assert(sizeof(FlatNode) == 16, "a FlatNode is 16 bytes");
+
+class FlatTree
+{
+  public:
+    std::vector<FlatNode> nodes;
+    std::vector<uint32_t> children;
+    /* Function names, viewing the text the tree's names view */
+    std::vector<std::string_view> names;
+
+    /* Lay out the tree under root after what the FlatTree holds; root
+     * becomes the last node */
+    void build(Node *root);
+
+    uint32_t get_root() const {return (uint32_t)nodes.size() - 1;}
+    uint32_t get_child_count(uint32_t node) const {
+        uint32_t end = node + 1 < nodes.size() ? nodes[node + 1].first_child : (uint32_t)children.size();
+        return end - nodes[node].first_child;
+    }
+    /* The index of the nth child of node */
+    uint32_t get_child(uint32_t node, uint32_t nth) const {return children[nodes[node].first_child + nth];}
+    /* The index of the first node of the subtree of node */
+    uint32_t get_first(uint32_t node) const {return node + 1 - nodes[node].size;}
+};
+
+#endif /* FLAT_H_ */
@@ -0,0 +1,539 @@
+/**********************************************************************
+ *  Hand written scanner, a drop-in replacement for the flex scanner in
+ *  scanner.l (build with make LEXER=hand). It returns the same tokens,
+ *  yylval and yylloc values and reports the same lexical errors.
+ *
+ *  Blanks and comment bodies are skipped with SSE2 (or AVX2 when built
+ *  with -mavx2) compares, and keywords and type names are told apart
+ *  from identifiers with a perfect hash.
+ **********************************************************************/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "common.h"
+#include "context.h"
+#include "ast.h"
+#include "parser.tab.h"
+#include "literal.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class HandLexer
+{
+  public:
+    CompileContext *ctx;
+    const char *begin = nullptr;
+    const char *cursor = nullptr;
+    const char *end = nullptr;
+
+    /* Last blank or comment piece skipped, which flex leaves in yylloc
+     * when it reaches the end of the input. NULL when there is none. */
+    const char *skipped_begin = nullptr;
+    const char *skipped_end = nullptr;
+
+    HandLexer(CompileContext *context) : ctx(context) {}
+
+    /* yylloc of the source from first up to last */
+    void set_location(YYLTYPE *yylloc, const char *first, const char *last) const {
+        yylloc->begin = (uint32_t)(first - begin);
+        yylloc->end = (uint32_t)(last - begin);
+    }
+};
+
+/***********************************************************************
+ * Keywords and type names. The hash is collision free over the 21 words
+ * below; a word that hashes onto an entry still has to match it.
+ **********************************************************************/
+#define KEYWORD_HASH_SIZE 32
+
+struct Keyword
+{
+    const char *text;
+    int length;
+    int token;
+    int value;    /* Vector dimension, or the value of a bool literal */
+};
+
+static inline unsigned keyword_hash(const char *text, int length)
+{
+    return (length + (unsigned char)text[0] * 28 + (unsigned char)text[length - 1] * 3) % KEYWORD_HASH_SIZE;
+}
+
+class KeywordTable
+{
+  private:
+    Keyword m_slots[KEYWORD_HASH_SIZE];
+
+  public:
+    KeywordTable() {
+        static const Keyword keywords[] = {
+            {"if", 2, IF, 0},           {"else", 4, ELSE, 0},         {"while", 5, WHILE, 0},
+            {"const", 5, CONST_TYPE, 0},
+            {"true", 4, BOOL, 1},       {"false", 5, BOOL, 0},
+            {"lit", 3, FUNC_NAME, 0},   {"dp3", 3, FUNC_NAME, 0},     {"rsq", 3, FUNC_NAME, 0},
+            {"int", 3, INT_TYPE, 1},    {"ivec2", 5, INT_TYPE, 2},    {"ivec3", 5, INT_TYPE, 3},
+            {"ivec4", 5, INT_TYPE, 4},
+            {"bool", 4, BOOL_TYPE, 1},  {"bvec2", 5, BOOL_TYPE, 2},   {"bvec3", 5, BOOL_TYPE, 3},
+            {"bvec4", 5, BOOL_TYPE, 4},
+            {"float", 5, FLOAT_TYPE, 1}, {"vec2", 4, FLOAT_TYPE, 2},  {"vec3", 4, FLOAT_TYPE, 3},
+            {"vec4", 4, FLOAT_TYPE, 4},
+        };
+        memset(m_slots, 0, sizeof(m_slots));
+        for (const Keyword &keyword : keywords) {
+            Keyword &slot = m_slots[keyword_hash(keyword.text, keyword.length)];
+            assert(slot.text == nullptr);
+            slot = keyword;
+        }
+    }
+
+    const Keyword *find(const char *text, int length) const {
+        if (length < 2 || length > 5)
+            return nullptr;
+        const Keyword &slot = m_slots[keyword_hash(text, length)];
+        if (slot.length == length && memcmp(slot.text, text, length) == 0)
+            return &slot;
+        return nullptr;
+    }
+};
+
+static const KeywordTable &keyword_table()
+{
+    static const KeywordTable table;
+    return table;
+}
+
+/***********************************************************************
+ * Vector scans. Each returns a bit per byte of the block at p; blocks
+ * are only loaded while they lie wholly inside the source.
+ **********************************************************************/
+#if defined(__AVX2__)
+#define LEX_BLOCK 32
+typedef uint32_t block_mask;
+
+static inline block_mask byte_mask(__m256i block, char c)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+}
+
+static inline __m256i load_block(const char *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+#elif defined(__SSE2__)
+#define LEX_BLOCK 16
+typedef uint32_t block_mask;
+
+static inline block_mask byte_mask(__m128i block, char c)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+}
+
+static inline __m128i load_block(const char *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+#endif
+
+/* Note the newlines in [from, to) */
+static inline void count_lines(HandLexer *lexer, const char *from, const char *to)
+{
+    for (const char *p = from; p < to; p++)
+        if (*p == '\n')
+            lexer->ctx->yyline++;
+}
+
+#ifdef LEX_BLOCK
+/* Same, for the newlines flagged in a block mask */
+static inline void count_block_lines(HandLexer *lexer, block_mask newlines)
+{
+    lexer->ctx->yyline += __builtin_popcount(newlines);
+}
+#endif
+
+/* First byte at or after p that is not a blank */
+static const char *skip_blanks(HandLexer *lexer, const char *p)
+{
+    const char *end = lexer->end;
+#ifdef LEX_BLOCK
+    while (p + LEX_BLOCK <= end) {
+        auto block = load_block(p);
+        block_mask newlines = byte_mask(block, '\n');
+        block_mask blanks = byte_mask(block, ' ') | byte_mask(block, '\t') | byte_mask(block, '\r') | newlines;
+        if (blanks != (block_mask)((1ULL << LEX_BLOCK) - 1)) {
+            int first = __builtin_ctz(~blanks);
+            count_block_lines(lexer, newlines & ((1U << first) - 1));
+            return p + first;
+        }
+        count_block_lines(lexer, newlines);
+        p += LEX_BLOCK;
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        if (*p == '\n')
+            lexer->ctx->yyline++;
+        p++;
+    }
+    return p;
+}
+
+/* First '*' at or after p, or end */
+static const char *find_star(HandLexer *lexer, const char *p)
+{
+    const char *end = lexer->end;
+#ifdef LEX_BLOCK
+    while (p + LEX_BLOCK <= end) {
+        auto block = load_block(p);
+        block_mask newlines = byte_mask(block, '\n');
+        block_mask stars = byte_mask(block, '*');
+        if (stars) {
+            int first = __builtin_ctz(stars);
+            count_block_lines(lexer, newlines & ((1U << first) - 1));
+            return p + first;
+        }
+        count_block_lines(lexer, newlines);
+        p += LEX_BLOCK;
+    }
+#endif
+    const char *star = (const char *)memchr(p, '*', end - p);
+    if (star == nullptr)
+        star = end;
+    count_lines(lexer, p, star);
+    return star;
+}
+
+/* Start of the last piece flex would match in the comment body that runs
+ * from body to end without a closing star slash */
+static const char *last_comment_piece(const char *body, const char *end)
+{
+    if (end == body)
+        return body - 2;    /* The opening slash star itself */
+    if (end[-1] == '\n')
+        return end - 1;
+    const char *p = end;
+    while (p > body && p[-1] != '\n' && p[-1] != '*')
+        p--;
+    if (p == body || p[-1] == '\n')
+        return p;
+    /* A run of stars takes the text after it up to a slash */
+    const char *slash = (const char *)memchr(p, '/', end - p);
+    if (slash != nullptr)
+        return slash;
+    while (p > body && p[-1] == '*')
+        p--;
+    return p;
+}
+
+/***********************************************************************
+ * Number rules, each giving the length scanner.l would match at p
+ **********************************************************************/
+static inline bool is_digit(char c) {return c >= '0' && c <= '9';}
+static inline bool is_letter(char c) {return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';}
+
+/* [0-9]*\.[0-9]+([eE][-+]?[0-9]+)? */
+static int match_float(const char *p)
+{
+    int i = 0;
+    while (is_digit(p[i]))
+        i++;
+    if (p[i] != '.' || !is_digit(p[i + 1]))
+        return 0;
+    i += 2;
+    while (is_digit(p[i]))
+        i++;
+    if (p[i] == 'e' || p[i] == 'E') {
+        int j = i + 1;
+        if (p[j] == '+' || p[j] == '-')
+            j++;
+        if (is_digit(p[j])) {
+            while (is_digit(p[j]))
+                j++;
+            i = j;
+        }
+    }
+    return i;
+}
+
+/* [0-9][eE][-]?[0-9]+ */
+static int match_scientific(const char *p)
+{
+    if (!is_digit(p[0]) || (p[1] != 'e' && p[1] != 'E'))
+        return 0;
+    int i = p[2] == '-' ? 3 : 2;
+    if (!is_digit(p[i]))
+        return 0;
+    while (is_digit(p[i]))
+        i++;
+    return i;
+}
+
+/* 0[0-9]+{RX_FLOAT}? */
+static int match_leading_zero(const char *p)
+{
+    if (p[0] != '0' || !is_digit(p[1]))
+        return 0;
+    int i = 1;
+    while (is_digit(p[i]))
+        i++;
+    return i + match_float(p + i);
+}
+
+/* [0-9]E([0-9]|{RX_FLOAT}) */
+static int match_bad_exponent(const char *p)
+{
+    if (!is_digit(p[0]) || p[1] != 'E')
+        return 0;
+    int tail = match_float(p + 2);
+    if (tail == 0 && is_digit(p[2]))
+        tail = 1;
+    return tail ? 2 + tail : 0;
+}
+
+/* [0-9]+".-"[0-9a-zA-Z_]+ */
+static int match_bad_minus(const char *p)
+{
+    int i = 0;
+    while (is_digit(p[i]))
+        i++;
+    if (i == 0 || p[i] != '.' || p[i + 1] != '-')
+        return 0;
+    int j = i + 2;
+    while (is_digit(p[j]) || is_letter(p[j]))
+        j++;
+    return j > i + 2 ? j : 0;
+}
+
+/* [0-9]+[a-zA-Z_]+ */
+static int match_bad_id(const char *p)
+{
+    int i = 0;
+    while (is_digit(p[i]))
+        i++;
+    int j = i;
+    while (is_letter(p[j]))
+        j++;
+    return i > 0 && j > i ? j : 0;
+}
+
+/***********************************************************************
+ * The scanner proper
+ **********************************************************************/
+#define yTRACE(x)    { if (ctx->traceScanner) fprintf(ctx->traceFile, "TOKEN %3d : %.*s\n", x, length, start); }
+#define yERROR(x)    { if (ctx->errorFile) fprintf(ctx->errorFile, "\nLEXICAL ERROR, LINE %d: %s\n", ctx->yyline, x); \
+                       ctx->add_diagnostic(Diagnostic::LEXICAL, ctx->yyline, ctx->lines->locate(*yylloc).get_last_col(), x); }
+
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner)
+{
+    HandLexer *lexer = (HandLexer *)scanner;
+    CompileContext *ctx = lexer->ctx;
+    const char *end = lexer->end;
+    const char *p = lexer->cursor;
+
+    lexer->skipped_begin = nullptr;
+    for (;;) {
+        const char *blank = p;
+        p = skip_blanks(lexer, p);
+        if (p > blank) {
+            /* flex matches blanks one at a time */
+            lexer->skipped_begin = p - 1;
+            lexer->skipped_end = p;
+        }
+        if (p >= end)
+            break;
+        if (p[0] != '/' || p + 1 >= end || p[1] != '*')
+            break;
+
+        /* A comment: find the closing star slash, counting lines */
+        const char *body = p + 2;
+        const char *star = body;
+        for (;;) {
+            star = find_star(lexer, star);
+            if (star >= end || (star + 1 < end && star[1] == '/'))
+                break;
+            star++;
+        }
+        if (star >= end) {
+            /* flex leaves yylloc on the last piece of the comment it matched */
+            lexer->set_location(yylloc, last_comment_piece(body, end), end);
+            lexer->cursor = end;
+            yERROR("No closing comment(*/) until EOF");
+            return 0;
+        }
+        const char *run = star;
+        while (run > body && run[-1] == '*')
+            run--;
+        lexer->skipped_begin = run;
+        lexer->skipped_end = star + 2;
+        p = star + 2;
+    }
+
+    if (p >= end) {
+        lexer->cursor = end;
+        if (lexer->skipped_begin)
+            lexer->set_location(yylloc, lexer->skipped_begin, lexer->skipped_end);
+        return 0;
+    }
+
+    /* Longest match, the earlier rule of scanner.l winning a tie */
+    const char *start = p;
+    int length = 1;
+    int token = 0;
+    enum {TOKEN, KEYWORD, IDENTIFIER, FLOAT_NUMBER, INT_NUMBER, BAD_NUMBER, BAD_ID, UNKNOWN} kind = TOKEN;
+    const Keyword *keyword = nullptr;
+    char c = *p;
+
+    if (is_letter(c)) {
+        int letters = 1;
+        while (is_letter(p[letters]))
+            letters++;
+        length = letters;
+        while (is_letter(p[length]) || is_digit(p[length]))
+            length++;
+        if (length == letters && p[length] == '.' &&
+            (p[length + 1] == '+' || p[length + 1] == '*' || p[length + 1] == '/' || p[length + 1] == '"')) {
+            /* [a-zA-Z_]+"."[+*"/]+, an identifier run into an operator */
+            length += 2;
+            while (p[length] == '+' || p[length] == '*' || p[length] == '/' || p[length] == '"')
+                length++;
+            kind = BAD_ID;
+        } else if ((keyword = keyword_table().find(p, length)) != nullptr)
+            kind = KEYWORD;
+        else
+            kind = IDENTIFIER;
+    } else if (is_digit(c) || c == '.') {
+        /* The number rules in scanner.l order */
+        int lengths[7] = {
+            match_scientific(p), match_leading_zero(p), match_float(p), 0,
+            match_bad_exponent(p), match_bad_minus(p), match_bad_id(p)
+        };
+        while (is_digit(p[lengths[3]]))
+            lengths[3]++;
+        int best = 0;
+        for (int rule = 1; rule < 7; rule++)
+            if (lengths[rule] > lengths[best])
+                best = rule;
+        if (lengths[best] == 0)
+            kind = UNKNOWN;                 /* A lone '.' */
+        else {
+            static const int kinds[7] = {FLOAT_NUMBER, BAD_NUMBER, FLOAT_NUMBER, INT_NUMBER,
+                                         BAD_NUMBER, BAD_NUMBER, BAD_ID};
+            length = lengths[best];
+            kind = (decltype(kind))kinds[best];
+        }
+    } else {
+        char next = p + 1 < end ? p[1] : '\0';
+        switch (c) {
+            case '=': if (next == '=') {token = DOUBLE_EQ; length = 2;} else token = EQ; break;
+            case '!': if (next == '=') {token = N_EQ; length = 2;} else token = NOT; break;
+            case '>': if (next == '=') {token = G_EQ; length = 2;} else token = GREATER; break;
+            case '<': if (next == '=') {token = S_EQ; length = 2;} else token = SMALLER; break;
+            case '&': if (next == '&') {token = AND; length = 2;} else kind = UNKNOWN; break;
+            case '|': if (next == '|') {token = OR; length = 2;} else kind = UNKNOWN; break;
+            case '{': token = LEFT_CURLY; break;
+            case '}': token = RIGHT_CURLY; break;
+            case '(': token = LEFT_PARENTHESIS; break;
+            case ')': token = RIGHT_PARENTHESIS; break;
+            case '[': token = LEFT_BRACKET; break;
+            case ']': token = RIGHT_BRACKET; break;
+            case '^': token = CARET; break;
+            case '*': token = TIMES; break;
+            case '/': token = DIVIDE; break;
+            case '+': token = PLUS; break;
+            case '-': token = MINUS; break;
+            case ',': token = COMMA; break;
+            case ';': token = SEMICOLON; break;
+            default:  kind = UNKNOWN; break;
+        }
+    }
+
+    lexer->set_location(yylloc, start, start + length);
+    lexer->cursor = start + length;
+
+    switch (kind) {
+        case TOKEN:
+            yTRACE(token);
+            return token;
+
+        case KEYWORD:
+            token = keyword->token;
+            if (token == BOOL)
+                yylval->as_bool = keyword->value;
+            yTRACE(token);
+            if (token == FUNC_NAME) {
+                yylval->func_name.text = start;
+                yylval->func_name.length = length;
+            } else if (token == INT_TYPE || token == BOOL_TYPE || token == FLOAT_TYPE)
+                yylval->vec_dimension = keyword->value;
+            return token;
+
+        case IDENTIFIER:
+            yTRACE(ID);
+            yylval->as_id.text = start;
+            yylval->as_id.length = length;
+            yylval->as_id.symbol = ctx->identifiers->intern(std::string_view(start, length));
+            if (length > MAX_IDENTIFIER)
+                yERROR("Size of ID > 32");
+            return ID;
+
+        case FLOAT_NUMBER: {
+            yTRACE(FLOAT);
+            if (parse_float_literal(start, length, &yylval->as_float) == LITERAL_TOO_LARGE)
+                yERROR("Float number is greater than 1E37");
+            return FLOAT;
+        }
+
+        case INT_NUMBER: {
+            yTRACE(INT);
+            if (parse_int_literal(start, length, &yylval->as_int) == LITERAL_TOO_LARGE)
+                yERROR("Integer greater than 32767");
+            return INT;
+        }
+
+        case BAD_NUMBER:
+            yERROR("Invalid number");
+            return 0;
+
+        case BAD_ID:
+            yERROR("Invalid ID");
+            return 0;
+
+        case UNKNOWN:
+            yERROR("Unknown token");
+            return 0;
+    }
+    return 0;
+}
+
+int scanner_init(CompileContext *ctx)
+{
+    if (ctx->sourceText == nullptr || ctx->identifiers == nullptr || ctx->lines == nullptr)
+        return 1;
+    HandLexer *lexer = new HandLexer(ctx);
+    lexer->cursor = ctx->sourceText;
+    lexer->end = ctx->sourceText + ctx->sourceLength;
+    lexer->begin = lexer->cursor;
+    ctx->scanner = lexer;
+    ctx->yyline = 1;
+    return 0;
+}
+
+void scanner_seek(CompileContext *ctx, size_t offset)
+{
+    HandLexer *lexer = (HandLexer *)ctx->scanner;
+    lexer->begin = ctx->sourceText;
+    lexer->cursor = ctx->sourceText + offset;
+    lexer->end = ctx->sourceText + ctx->sourceLength;
+    lexer->skipped_begin = nullptr;
+}
+
+void scanner_destroy(CompileContext *ctx)
+{
+    delete (HandLexer *)ctx->scanner;
+    ctx->scanner = nullptr;
+}
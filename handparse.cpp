@@ -0,0 +1,976 @@
+/**********************************************************************
+ *  Hand written parser, a drop-in replacement for the bison parser in
+ *  parser.y (compiler467 -P). Statements and declarations are parsed by
+ *  recursive descent on one token of lookahead; expressions by
+ *  precedence climbing over the precedence declarations of parser.y.
+ *
+ *  What each production yields is up to the actions the parser is
+ *  instantiated with. AstActions builds the nodes parser.y builds, each
+ *  with the span the grammar rule gives it. EmitActions builds nothing:
+ *  it hands each production to an ArbEmitter as soon as it is parsed,
+ *  which is the fast compile of compiler467 -F. There are no reduction
+ *  traces, so -Tp always runs the bison parser.
+ **********************************************************************/
+
+#include <string>
+#include <vector>
+#include "common.h"
+#include "context.h"
+#include "ast.h"
+#include "parser.tab.h"
+#include "stats.h"
+#include "outbuf.h"
+#include "codegen.h"
+#include "handparse.h"
+#include "preprocess.h"
+
+void yyerror(YYLTYPE *yylloc, CompileContext *ctx, yyscan_t scanner, const char *s);
+int  yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+
+/* The token stream and error state, whatever the actions */
+class TokenReader
+{
+  public:
+    CompileContext *ctx;
+    int failed = 0;    /* What the parse returns once set */
+    int depth = 1;     /* States on bison's stack, counting its first */
+
+    /* The lookahead. Values are left in place by tokens that carry
+     * none, as in yyparse. */
+    int token = 0;
+    YYSTYPE value = {};
+    YYLTYPE location = {0, 0};
+
+    TokenReader(CompileContext *context) : ctx(context) {}
+
+    void next() {
+        token = ctx->preprocessor ? ctx->preprocessor->next(&value, &location)
+                                  : yylex(&value, &location, ctx->scanner);
+        if (ctx->stats && token)
+            ctx->stats->tokens++;
+    }
+
+    /* Report an error at the lookahead */
+    void fail(const char *message = "syntax error", int result = 1) {
+        if (!failed)
+            yyerror(&location, ctx, ctx->scanner, message);
+        failed = result;
+    }
+
+    /* Consume the lookahead if it is token, else fail */
+    bool expect(int expected) {
+        if (token != expected) {
+            fail();
+            return false;
+        }
+        next();
+        return true;
+    }
+};
+
+/* The symbols of one grammar rule on bison's stack, from when each is
+ * pushed until the rule is reduced, which is when this goes out of
+ * scope. A rule nested in another is pushed on top of the symbols of
+ * the outer one parsed so far. */
+class Nesting
+{
+  private:
+    TokenReader *m_reader;
+    int m_symbols = 0;
+  public:
+    Nesting(TokenReader *reader) : m_reader(reader) {}
+    ~Nesting() {m_reader->depth -= m_symbols;}
+
+    /* Push count more symbols of the rule, failing the parse as bison
+     * does once its stack is full. Returns false once failed. */
+    bool push(int count = 1) {
+        m_symbols += count;
+        m_reader->depth += count;
+        if (m_reader->depth >= PARSER_STACK_DEPTH && !m_reader->failed)
+            m_reader->fail("memory exhausted", 2);
+        return !m_reader->failed;
+    }
+};
+
+/* Precedences follow parser.y, lowest first; every binary operator is
+ * left associative except the comparisons, which do not associate, and
+ * CARET, which associates to the right. Unary operators bind tighter
+ * than all of them. */
+enum Precedence {
+    PREC_NONE,
+    PREC_OR,
+    PREC_AND,
+    PREC_COMPARE,
+    PREC_ADD,
+    PREC_MULTIPLY,
+    PREC_POWER,
+};
+
+static int binary_precedence(int token)
+{
+    switch (token) {
+        case OR:        return PREC_OR;
+        case AND:       return PREC_AND;
+        case DOUBLE_EQ: case N_EQ: case GREATER: case SMALLER: case S_EQ: case G_EQ:
+                        return PREC_COMPARE;
+        case PLUS:      case MINUS:
+                        return PREC_ADD;
+        case TIMES:     case DIVIDE:
+                        return PREC_MULTIPLY;
+        case CARET:     return PREC_POWER;
+    }
+    return PREC_NONE;
+}
+
+static bool is_type(int token)
+{
+    return token == INT_TYPE || token == BOOL_TYPE || token == FLOAT_TYPE;
+}
+
+static bool starts_statement(int token)
+{
+    return token == ID || token == IF || token == WHILE || token == LEFT_CURLY || token == SEMICOLON;
+}
+
+/***********************************************************************
+ * Actions. Each returns what one production yields; discard drops what
+ * a production that failed had collected.
+ **********************************************************************/
+
+/* The AST of parser.y, in ctx->arena */
+class AstActions
+{
+  private:
+    Arena *m_arena;
+
+  public:
+    typedef Type *TypeValue;
+    typedef IdentifierNode *VariableValue;
+    typedef Expression *ExpressionValue;
+    typedef Arguments *ArgumentsValue;
+    typedef Declaration *DeclarationValue;
+    typedef Statement *StatementValue;
+    typedef Scope *ScopeValue;
+
+    explicit AstActions(Arena *arena) : m_arena(arena) {}
+
+    /* What a failed production made stays in the arena until the tree goes */
+    template <class T> void discard(T *) {}
+
+    TypeValue type(int base, int dimension) {
+        return new (m_arena) Type(TypeDesc((TypeDesc::Base)base, dimension));
+    }
+
+    VariableValue variable(const Lexeme &id, SourceSpan span) {
+        IdentifierNode *variable = new (m_arena) IdentifierNode(std::string_view(id.text, id.length), id.symbol);
+        variable->set_span(span);
+        return variable;
+    }
+    VariableValue vector(const Lexeme &id, int index, SourceSpan span) {
+        VectorVariable *variable = new (m_arena) VectorVariable(std::string_view(id.text, id.length), id.symbol, index);
+        variable->set_span(span);
+        return variable;
+    }
+
+    ExpressionValue literal(int token, const YYSTYPE &value, SourceSpan span) {
+        Expression *expression;
+        if (token == INT)
+            expression = new (m_arena) IntLiteralExpression(value.as_int);
+        else if (token == FLOAT)
+            expression = new (m_arena) FloatLiteralExpression(value.as_float);
+        else
+            expression = new (m_arena) BoolLiteralExpression(value.as_bool);
+        expression->set_span(span);
+        return expression;
+    }
+    ExpressionValue variable_expression(VariableValue variable, SourceSpan span) {
+        Expression *expression = new (m_arena) VariableExpression(variable);
+        expression->set_span(span);
+        return expression;
+    }
+    ExpressionValue unary(int operator_type, ExpressionValue operand, SourceSpan span) {
+        Expression *expression = new (m_arena) UnaryExpression(operator_type, operand);
+        expression->set_span(span);
+        return expression;
+    }
+    ExpressionValue binary(int operator_type, ExpressionValue left, ExpressionValue right, SourceSpan span) {
+        Expression *expression = new (m_arena) BinaryExpression(operator_type, right, left);
+        expression->set_span(span);
+        return expression;
+    }
+
+    ArgumentsValue arguments() {return new (m_arena) Arguments(m_arena);}
+    void argument(ArgumentsValue arguments, ExpressionValue expression, SourceSpan span) {
+        arguments->push_back_expression(expression);
+        arguments->set_span(span);
+    }
+    /* The grammar's empty arguments_opt, one null expression */
+    void no_arguments(ArgumentsValue arguments, SourceSpan span) {
+        arguments->push_back_expression(nullptr);
+        arguments->set_span(span);
+    }
+
+    ExpressionValue function(const Lexeme &name, ArgumentsValue arguments, SourceSpan span) {
+        Function *function = new (m_arena) Function(std::string_view(name.text, name.length), arguments);
+        function->set_span(span);
+        Expression *expression = new (m_arena) FunctionExpression(function);
+        expression->set_span(span);
+        return expression;
+    }
+    ExpressionValue constructor(TypeValue type, ArgumentsValue arguments, SourceSpan span) {
+        Constructor *constructor = new (m_arena) Constructor(type, arguments);
+        constructor->set_span(span);
+        Expression *expression = new (m_arena) ConstructorExpression(constructor);
+        expression->set_span(span);
+        return expression;
+    }
+
+    DeclarationValue declaration(TypeValue type, const Lexeme &id, const ExpressionValue *initial_value,
+                                 bool is_const, SourceSpan span) {
+        Declaration *declaration = new (m_arena) Declaration(type, std::string_view(id.text, id.length), id.symbol,
+                                                   initial_value ? *initial_value : nullptr, is_const);
+        declaration->set_span(span);
+        return declaration;
+    }
+
+    StatementValue assignment(VariableValue variable, ExpressionValue value, SourceSpan span) {
+        AssignStatement *assignment = new (m_arena) AssignStatement();
+        assignment->variable = variable;
+        assignment->expression = value;
+        assignment->set_span(span);
+        return assignment;
+    }
+    StatementValue if_statement(ExpressionValue condition, StatementValue body, const StatementValue *else_body,
+                                SourceSpan span) {
+        IfStatement *if_statement = new (m_arena) IfStatement();
+        if_statement->expression = condition;
+        if_statement->statement = body;
+        if_statement->else_statement = else_body ? *else_body : nullptr;
+        if_statement->set_span(span);
+        return if_statement;
+    }
+    StatementValue nested_scope(ScopeValue scope) {
+        NestedScope *nested_scope = new (m_arena) NestedScope(scope);
+        nested_scope->set_span(scope->get_span());
+        return nested_scope;
+    }
+    StatementValue empty_statement(SourceSpan span) {
+        EmptyStatement *empty_statement = new (m_arena) EmptyStatement();
+        empty_statement->set_span(span);
+        return empty_statement;
+    }
+
+    ScopeValue scope() {
+        Scope *scope = new (m_arena) Scope();
+        scope->declarations = new (m_arena) Declarations(m_arena);
+        scope->statements = new (m_arena) Statements(m_arena);
+        return scope;
+    }
+    void end_scope(ScopeValue scope, SourceSpan span) {scope->set_span(span);}
+    void add_declaration(ScopeValue scope, DeclarationValue declaration) {
+        scope->declarations->push_back_declaration(declaration);
+    }
+    /* A while loop yields no statement */
+    void add_statement(ScopeValue scope, StatementValue statement) {
+        if (statement != nullptr)
+            scope->statements->push_back_statement(statement);
+    }
+
+    bool begin_branch(ExpressionValue, bool) {return false;}
+    void end_branch(bool) {}
+    void begin_loop() {}
+    void end_loop() {}
+};
+
+/* ARB instructions, written as genCode would write them for the AST.
+ * That leaves out what genCode never reaches: the untaken branch of an
+ * if on a literal, and while loops. genCode translates the arguments of
+ * a function call three times over; here they are translated once. */
+class EmitActions
+{
+  private:
+    ArbEmitter *m_emitter;
+    int m_skipping = 0;    /* Inside code genCode would not reach */
+
+  public:
+    /* An operand, and whether it is a bool literal, which decides an if */
+    struct Operand {
+        std::string name;
+        bool is_bool_literal = false;
+        bool bool_value = false;
+    };
+    struct Variable {
+        SymbolId symbol;
+        int index;    /* -1 unless it is a vector element */
+    };
+
+    typedef int TypeValue;
+    typedef Variable VariableValue;
+    typedef Operand ExpressionValue;
+    typedef std::vector<std::string> ArgumentsValue;
+    typedef int DeclarationValue;
+    typedef int StatementValue;
+    typedef int ScopeValue;
+
+    EmitActions(ArbEmitter *emitter) : m_emitter(emitter) {}
+
+    template <class T> void discard(const T &) {}
+
+    TypeValue type(int, int) {return 0;}
+
+    VariableValue variable(const Lexeme &id, SourceSpan) {return {id.symbol, -1};}
+    VariableValue vector(const Lexeme &id, int index, SourceSpan) {return {id.symbol, index};}
+
+    ExpressionValue literal(int token, const YYSTYPE &value, SourceSpan) {
+        Operand operand;
+        if (m_skipping)
+            return operand;
+        if (token == INT)
+            operand.name = std::to_string(value.as_int);
+        else if (token == FLOAT)
+            operand.name = std::to_string(value.as_float);
+        else {
+            operand.name = std::to_string(value.as_bool);
+            operand.is_bool_literal = true;
+            operand.bool_value = value.as_bool;
+        }
+        return operand;
+    }
+    ExpressionValue variable_expression(VariableValue variable, SourceSpan) {
+        Operand operand;
+        if (!m_skipping)
+            operand.name = register_name(variable);
+        return operand;
+    }
+    /* genCode gives unary expressions no register */
+    ExpressionValue unary(int, const ExpressionValue &, SourceSpan) {return Operand();}
+    ExpressionValue binary(int operator_type, const ExpressionValue &left, const ExpressionValue &right,
+                           SourceSpan) {
+        Operand operand;
+        if (!m_skipping)
+            operand.name = m_emitter->binary(operator_type, left.name, right.name);
+        return operand;
+    }
+
+    ArgumentsValue arguments() {return ArgumentsValue();}
+    void argument(ArgumentsValue &arguments, const ExpressionValue &expression, SourceSpan) {
+        arguments.push_back(expression.name);
+    }
+    void no_arguments(ArgumentsValue &, SourceSpan) {}
+
+    ExpressionValue function(const Lexeme &name, const ArgumentsValue &arguments, SourceSpan) {
+        Operand operand;
+        if (!m_skipping)
+            operand.name = m_emitter->function(std::string_view(name.text, name.length), arguments);
+        return operand;
+    }
+    ExpressionValue constructor(TypeValue, const ArgumentsValue &arguments, SourceSpan) {
+        Operand operand;
+        if (!m_skipping)
+            operand.name = m_emitter->constructor(arguments);
+        return operand;
+    }
+
+    DeclarationValue declaration(TypeValue, const Lexeme &id, const ExpressionValue *initial_value,
+                                 bool is_const, SourceSpan) {
+        if (!m_skipping)
+            m_emitter->declaration(id.symbol, is_const, initial_value ? &initial_value->name : nullptr);
+        return 0;
+    }
+
+    StatementValue assignment(VariableValue variable, const ExpressionValue &value, SourceSpan) {
+        if (!m_skipping)
+            m_emitter->assignment(register_name(variable), value.name);
+        return 0;
+    }
+    StatementValue if_statement(const ExpressionValue &, StatementValue, const StatementValue *, SourceSpan) {
+        return 0;
+    }
+    StatementValue nested_scope(ScopeValue) {return 0;}
+    StatementValue empty_statement(SourceSpan) {return 0;}
+
+    ScopeValue scope() {return 0;}
+    void end_scope(ScopeValue, SourceSpan) {}
+    void add_declaration(ScopeValue, DeclarationValue) {}
+    void add_statement(ScopeValue, StatementValue) {}
+
+    /* genCode only translates the branch a literal condition takes */
+    bool begin_branch(const ExpressionValue &condition, bool taken_when) {
+        bool skip = condition.is_bool_literal && condition.bool_value != taken_when;
+        m_skipping += skip;
+        return skip;
+    }
+    void end_branch(bool skipped) {m_skipping -= skipped;}
+    void begin_loop() {m_skipping++;}
+    void end_loop() {m_skipping--;}
+
+  private:
+    std::string register_name(const Variable &variable) {
+        return variable.index < 0 ? m_emitter->variable(variable.symbol)
+                                  : m_emitter->vector(variable.symbol, variable.index);
+    }
+};
+
+/***********************************************************************
+ * The parser. A parse function that fails returns an empty value, with
+ * failed set and what it had collected discarded.
+ **********************************************************************/
+template <class Actions>
+class HandParser : public TokenReader
+{
+  public:
+    typedef typename Actions::TypeValue TypeValue;
+    typedef typename Actions::VariableValue VariableValue;
+    typedef typename Actions::ExpressionValue ExpressionValue;
+    typedef typename Actions::ArgumentsValue ArgumentsValue;
+    typedef typename Actions::DeclarationValue DeclarationValue;
+    typedef typename Actions::StatementValue StatementValue;
+    typedef typename Actions::ScopeValue ScopeValue;
+
+    Actions actions;
+
+    HandParser(CompileContext *context, Actions parse_actions) : TokenReader(context), actions(parse_actions) {}
+
+    /* program: scope, followed by the end of the source */
+    int parse_program(ScopeValue *program) {
+        next();
+        if (token != LEFT_CURLY) {
+            fail();
+            return failed;
+        }
+        SourceSpan span;
+        ScopeValue scope = parse_scope(&span);
+        if (!failed && token != 0) {
+            actions.discard(scope);
+            fail();
+        }
+        if (!failed)
+            *program = scope;
+        return failed;
+    }
+
+    /* The declarations and statements of a scope, from the lookahead on
+     * to the first token at or past end, which they have to end just
+     * before. stack_depth is the states bison's stack holds below the
+     * scope. */
+    int parse_items(size_t end, int stack_depth, bool declarations_allowed, bool statements_allowed,
+                    std::vector<DeclarationValue> *declarations, std::vector<StatementValue> *statements) {
+        depth = stack_depth;
+        Nesting rule(this);
+        rule.push(2);    /* '{' declarations */
+        next();
+        while (!failed && token != 0 && location.begin < end) {
+            if (is_type(token) || token == CONST_TYPE) {
+                if (!declarations_allowed || !statements->empty())
+                    fail();
+                else
+                    declarations->push_back(parse_declaration());
+            } else if (starts_statement(token) && statements_allowed) {
+                Nesting statements_symbol(this);
+                SourceSpan statement_span;
+                StatementValue statement = {};
+                if (statements_symbol.push())
+                    statement = parse_statement(&statement_span);
+                if (!failed && statement)
+                    statements->push_back(statement);
+            } else
+                fail();
+        }
+        if (!failed && location.begin != end)
+            fail();
+        return failed;
+    }
+
+  private:
+    /* type: INT_TYPE | BOOL_TYPE | FLOAT_TYPE, with the lookahead one of them */
+    TypeValue parse_type() {
+        int base = token == INT_TYPE ? 0 : token == BOOL_TYPE ? 1 : 2;
+        TypeValue type = actions.type(base, value.vec_dimension);
+        next();
+        return type;
+    }
+
+    /* variable: ID | ID '[' INT ']', with the lookahead the ID */
+    VariableValue parse_variable(SourceSpan *span) {
+        Nesting rule(this);
+        Lexeme id = value.as_id;
+        *span = location;
+        if (!rule.push())
+            return {};
+        next();
+        if (token != LEFT_BRACKET)
+            return actions.variable(id, *span);
+
+        if (!rule.push())
+            return {};
+        next();
+        if (token != INT) {
+            fail();
+            return {};
+        }
+        int index = value.as_int;
+        if (!rule.push())
+            return {};
+        next();
+        if (token != RIGHT_BRACKET) {
+            fail();
+            return {};
+        }
+        span->end = location.end;
+        if (!rule.push())
+            return {};
+        next();
+        return actions.vector(id, index, *span);
+    }
+
+    /* arguments: expression (',' expression)* */
+    ArgumentsValue parse_arguments(SourceSpan *span) {
+        ArgumentsValue arguments = actions.arguments();
+        for (bool first = true; ; first = false) {
+            Nesting rule(this);    /* arguments ',' in front of all but the first */
+            if (!first) {
+                if (!rule.push(2)) {
+                    actions.discard(arguments);
+                    return {};
+                }
+                next();
+            }
+            SourceSpan expression_span;
+            ExpressionValue expression = parse_expression(&expression_span, PREC_OR);
+            if (failed) {
+                actions.discard(arguments);
+                return {};
+            }
+            if (first)
+                span->begin = expression_span.begin;
+            span->end = expression_span.end;
+            actions.argument(arguments, expression, *span);
+            if (token != COMMA)
+                return arguments;
+        }
+    }
+
+    /* The argument list of a call or constructor, with the lookahead its
+     * '('. A call may have none, which the grammar's empty arguments_opt
+     * places just after the '('. */
+    ArgumentsValue parse_call_arguments(bool optional, SourceSpan *span) {
+        Nesting rule(this);
+        SourceSpan open = location;
+        if (!rule.push() || !expect(LEFT_PARENTHESIS))
+            return {};
+
+        ArgumentsValue arguments;
+        if (optional && token == RIGHT_PARENTHESIS) {
+            arguments = actions.arguments();
+            actions.no_arguments(arguments, SourceSpan{open.end, open.end});
+        } else {
+            SourceSpan arguments_span;
+            arguments = parse_arguments(&arguments_span);
+            if (failed)
+                return {};
+        }
+        if (token != RIGHT_PARENTHESIS)
+            fail();
+        else
+            rule.push(2);    /* arguments ')' */
+        if (failed) {
+            actions.discard(arguments);
+            return {};
+        }
+        span->end = location.end;
+        next();
+        return arguments;
+    }
+
+    /* An operand of a binary operator: a primary expression or a unary
+     * operator applied to another operand. span is that of the grammar
+     * symbol, which for a parenthesized expression takes in the
+     * parentheses its value leaves out. */
+    ExpressionValue parse_operand(SourceSpan *span) {
+        Nesting rule(this);
+        *span = location;
+        switch (token) {
+            case NOT:
+            case MINUS: {
+                int operator_type = token;
+                if (!rule.push())
+                    return {};
+                next();
+                SourceSpan operand_span;
+                ExpressionValue operand = parse_operand(&operand_span);
+                if (failed)
+                    return {};
+                span->end = operand_span.end;
+                return actions.unary(operator_type, operand, *span);
+            }
+
+            case INT:
+            case FLOAT:
+            case BOOL: {
+                if (!rule.push())
+                    return {};
+                ExpressionValue literal = actions.literal(token, value, *span);
+                next();
+                return literal;
+            }
+
+            case ID: {
+                VariableValue variable = parse_variable(span);
+                if (failed)
+                    return {};
+                return actions.variable_expression(variable, *span);
+            }
+
+            case FUNC_NAME: {
+                Lexeme name = value.func_name;
+                if (!rule.push())
+                    return {};
+                next();
+                ArgumentsValue arguments = parse_call_arguments(true, span);
+                if (failed)
+                    return {};
+                return actions.function(name, arguments, *span);
+            }
+
+            case INT_TYPE:
+            case BOOL_TYPE:
+            case FLOAT_TYPE: {
+                if (!rule.push())
+                    return {};
+                TypeValue type = parse_type();
+                ArgumentsValue arguments = parse_call_arguments(false, span);
+                if (failed) {
+                    actions.discard(type);
+                    return {};
+                }
+                return actions.constructor(type, arguments, *span);
+            }
+
+            case LEFT_PARENTHESIS: {
+                if (!rule.push())
+                    return {};
+                next();
+                SourceSpan inner_span;
+                ExpressionValue expression = parse_expression(&inner_span, PREC_OR);
+                if (failed)
+                    return {};
+                if (token != RIGHT_PARENTHESIS)
+                    fail();
+                else
+                    rule.push(2);    /* expression ')' */
+                if (failed) {
+                    actions.discard(expression);
+                    return {};
+                }
+                span->end = location.end;
+                next();
+                return expression;
+            }
+        }
+        fail();
+        return {};
+    }
+
+    /* Operands joined by operators of at least the given precedence */
+    ExpressionValue parse_expression(SourceSpan *span, int precedence) {
+        ExpressionValue expression = parse_operand(span);
+        if (failed)
+            return {};
+
+        int previous = PREC_NONE;    /* Of the operator last applied at this level */
+        for (;;) {
+            int operator_precedence = binary_precedence(token);
+            if (operator_precedence < precedence || operator_precedence == PREC_NONE)
+                return expression;
+            if (operator_precedence == PREC_COMPARE && previous == PREC_COMPARE) {
+                actions.discard(expression);
+                fail();    /* a < b < c */
+                return {};
+            }
+
+            int operator_type = token;
+            SourceSpan right_span;
+            ExpressionValue right = {};
+            {
+                Nesting rule(this);
+                if (rule.push(2)) {    /* expression and the operator */
+                    next();
+                    right = parse_expression(&right_span,
+                                             operator_type == CARET ? operator_precedence : operator_precedence + 1);
+                }
+            }
+            if (failed) {
+                actions.discard(expression);
+                return {};
+            }
+            span->end = right_span.end;
+            expression = actions.binary(operator_type, expression, right, *span);
+            previous = operator_precedence;
+        }
+    }
+
+    /* declaration: [CONST_TYPE] type ID ['=' expression] ';', where a
+     * constant has to be initialized */
+    DeclarationValue parse_declaration() {
+        Nesting rule(this);
+        SourceSpan span = location;
+        bool is_const = token == CONST_TYPE;
+        if (is_const) {
+            if (!rule.push())
+                return {};
+            next();
+        }
+        if (!is_type(token)) {
+            fail();
+            return {};
+        }
+        if (!rule.push())
+            return {};
+        TypeValue type = parse_type();
+        if (token != ID)
+            fail();
+        else
+            rule.push();
+        if (failed) {
+            actions.discard(type);
+            return {};
+        }
+        Lexeme id = value.as_id;
+        next();
+
+        ExpressionValue initial_value = {};
+        bool has_initial_value = is_const || token == EQ;
+        if (has_initial_value) {
+            SourceSpan value_span;
+            if (rule.push() && expect(EQ)) {
+                initial_value = parse_expression(&value_span, PREC_OR);
+                rule.push();
+            }
+            if (failed) {
+                actions.discard(type);
+                return {};
+            }
+        }
+        if (token != SEMICOLON)
+            fail();
+        else
+            rule.push();
+        if (failed) {
+            actions.discard(type);
+            actions.discard(initial_value);
+            return {};
+        }
+        span.end = location.end;
+        next();
+        return actions.declaration(type, id, has_initial_value ? &initial_value : nullptr, is_const, span);
+    }
+
+    /* '(' expression ')', the condition of an if or a while, pushed as
+     * symbols of its rule */
+    ExpressionValue parse_condition(Nesting *rule) {
+        SourceSpan span;
+        if (!rule->push() || !expect(LEFT_PARENTHESIS))
+            return {};
+        ExpressionValue condition = parse_expression(&span, PREC_OR);
+        if (failed)
+            return {};
+        if (!rule->push(2) || !expect(RIGHT_PARENTHESIS)) {
+            actions.discard(condition);
+            return {};
+        }
+        return condition;
+    }
+
+    /* A statement, or an empty value for one that leaves nothing in the
+     * AST (a while loop, which ARB can not express). Check failed to
+     * tell the two apart. */
+    StatementValue parse_statement(SourceSpan *span) {
+        Nesting rule(this);
+        *span = location;
+        switch (token) {
+            case ID: {
+                SourceSpan variable_span, value_span;
+                VariableValue variable = parse_variable(&variable_span);
+                ExpressionValue value = {};
+                if (!failed && rule.push(2) && expect(EQ))    /* variable '=' */
+                    value = parse_expression(&value_span, PREC_OR);
+                if (!failed) {
+                    if (token != SEMICOLON)
+                        fail();
+                    else
+                        rule.push(2);    /* expression ';' */
+                    if (failed)
+                        actions.discard(value);
+                }
+                if (failed) {
+                    actions.discard(variable);
+                    return {};
+                }
+                span->end = location.end;
+                next();
+                return actions.assignment(variable, value, *span);
+            }
+
+            case IF: {
+                if (!rule.push())
+                    return {};
+                next();
+                ExpressionValue condition = parse_condition(&rule);
+                if (failed)
+                    return {};
+                SourceSpan body_span;
+                bool skipped = actions.begin_branch(condition, true);
+                StatementValue body = parse_statement(&body_span);
+                actions.end_branch(skipped);
+                /* The body, then the empty else_statement or the ELSE
+                 * in its place that an else branch is parsed on top of */
+                if (!failed)
+                    rule.push(2);
+                StatementValue else_body = {};
+                bool has_else = !failed && token == ELSE;
+                if (has_else) {
+                    next();
+                    skipped = actions.begin_branch(condition, false);
+                    else_body = parse_statement(&body_span);
+                    actions.end_branch(skipped);
+                }
+                if (failed) {
+                    actions.discard(condition);
+                    actions.discard(body);
+                    return {};
+                }
+                span->end = body_span.end;
+                return actions.if_statement(condition, body, has_else ? &else_body : nullptr, *span);
+            }
+
+            case WHILE: {
+                if (!rule.push())
+                    return {};
+                next();
+                actions.begin_loop();
+                ExpressionValue condition = parse_condition(&rule);
+                SourceSpan body_span = *span;
+                StatementValue body = {};
+                if (!failed)
+                    body = parse_statement(&body_span);
+                actions.end_loop();
+                span->end = body_span.end;
+                actions.discard(condition);
+                actions.discard(body);
+                return {};
+            }
+
+            case LEFT_CURLY: {
+                ScopeValue scope = parse_scope(span);
+                if (failed)
+                    return {};
+                return actions.nested_scope(scope);
+            }
+
+            case SEMICOLON:
+                if (!rule.push())
+                    return {};
+                next();
+                return actions.empty_statement(*span);
+        }
+        fail();
+        return {};
+    }
+
+    /* scope: '{' declarations statements '}', with the lookahead the '{' */
+    ScopeValue parse_scope(SourceSpan *span) {
+        Nesting rule(this);
+        *span = location;
+        if (!rule.push(2))    /* '{' and the empty declarations bison reduces at once */
+            return {};
+        next();
+
+        ScopeValue scope = actions.scope();
+        while (is_type(token) || token == CONST_TYPE) {
+            DeclarationValue declaration = parse_declaration();
+            if (failed) {
+                actions.discard(scope);
+                return {};
+            }
+            actions.add_declaration(scope, declaration);
+        }
+        if (!rule.push()) {    /* statements */
+            actions.discard(scope);
+            return {};
+        }
+        while (starts_statement(token)) {
+            SourceSpan statement_span;
+            StatementValue statement = parse_statement(&statement_span);
+            if (failed) {
+                actions.discard(scope);
+                return {};
+            }
+            actions.add_statement(scope, statement);
+        }
+        if (token != RIGHT_CURLY)
+            fail();
+        else
+            rule.push();
+        if (failed) {
+            actions.discard(scope);
+            return {};
+        }
+        span->end = location.end;
+        actions.end_scope(scope, *span);
+        next();
+        return scope;
+    }
+};
+
+int hand_parse(CompileContext *ctx)
+{
+    HandParser<AstActions> parser(ctx, AstActions(ctx->arena));
+    Scope *program = nullptr;
+    int failed = parser.parse_program(&program);
+    if (!failed)
+        ctx->ast = program;
+    return failed;
+}
+
+int hand_parse_items(CompileContext *ctx, size_t begin, size_t end, int stack_depth,
+                     bool declarations_allowed, bool statements_allowed,
+                     std::vector<Declaration *> *declarations, std::vector<Statement *> *statements)
+{
+    /* Nothing is reported: the caller parses more of the source instead */
+    FILE *errorFile = ctx->errorFile;
+    int errorOccurred = ctx->errorOccurred;
+    size_t diagnostics = ctx->diagnostics.size();
+    ctx->errorFile = NULL;
+    ctx->errorOccurred = FALSE;
+
+    scanner_seek(ctx, begin);
+    HandParser<AstActions> parser(ctx, AstActions(ctx->arena));
+    int failed = parser.parse_items(end, stack_depth, declarations_allowed, statements_allowed,
+                                    declarations, statements);
+    if (ctx->diagnostics.size() > diagnostics)
+        failed = failed ? failed : 1;
+    /* flex leaves a NUL after the last token it read, put it back */
+    scanner_seek(ctx, begin);
+    if (failed) {
+        declarations->clear();
+        statements->clear();
+    }
+
+    ctx->errorFile = errorFile;
+    ctx->errorOccurred = errorOccurred;
+    ctx->diagnostics.resize(diagnostics);
+    return failed;
+}
+
+int hand_compile(CompileContext *ctx, std::string *program)
+{
+    OutputBuffer out(program);
+    ArbEmitter emitter(&out, ctx->identifiers);
+    HandParser<EmitActions> parser(ctx, EmitActions(&emitter));
+    int scope;
+    int failed = parser.parse_program(&scope);
+    int instructions = emitter.finish();
+    if (ctx->stats)
+        ctx->stats->instructions = instructions;
+    return failed;
+}
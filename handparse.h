@@ -0,0 +1,57 @@
+/***********************************************************************
+ * handparse.h
+ *
+ * Hand written parser, used in place of the bison parser in parser.y
+ * when ctx->handParser is set (compiler467 -P). It accepts the same
+ * language, builds the same AST with the same source spans, and reports
+ * a syntax error at the same token with the same message.
+ *
+ * The same parser also drives the fast compile (compiler467 -F), which
+ * writes the ARB program as it parses, with no AST in between.
+ **********************************************************************/
+
+#ifndef HANDPARSE_H_
+#define HANDPARSE_H_ 1
+
+#include <string>
+#include <vector>
+#include "context.h"
+#include "ast.h"
+
+/* Bison's stack holds a state for each symbol of every rule being
+ * parsed, on top of the one it starts in, and the parse fails with
+ * "memory exhausted" once it holds PARSER_STACK_DEPTH of them. parser.y
+ * takes this as its YYMAXDEPTH; the hand parser counts the same states
+ * and fails at the same depth. */
+#define PARSER_STACK_DEPTH 10000
+
+/* The states in front of a statement of a scope ('{' declarations
+ * statements), of the body of an if (IF '(' expression ')') and of its
+ * else branch (the same, then statement ELSE) */
+#define STACK_BEFORE_STATEMENT 3
+#define STACK_BEFORE_IF_BODY   4
+#define STACK_BEFORE_ELSE_BODY 6
+
+/* Parse the tokens of ctx->scanner into ctx->ast, whose nodes are made
+ * in ctx->arena as they are for every item parsed. Returns what yyparse
+ * would: 0 on success, 1 on a syntax error and 2 when the source nests
+ * too deeply. */
+int hand_parse(CompileContext *ctx);
+
+/* Parse the declarations and statements of a scope that lie between
+ * offsets begin and end of ctx->sourceText, for an incremental compile.
+ * ctx->scanner starts over at begin, and the items have to end just before
+ * the first token at or past end. stack_depth is the number of states
+ * bison's stack holds below the scope's '{'. Declarations may only come first, and each kind only
+ * where allowed. Nothing is reported; on failure nothing is returned
+ * and the result is what hand_parse would return. */
+int hand_parse_items(CompileContext *ctx, size_t begin, size_t end, int stack_depth,
+                     bool declarations_allowed, bool statements_allowed,
+                     std::vector<Declaration *> *declarations, std::vector<Statement *> *statements);
+
+/* Parse the tokens of ctx->scanner and write the ARB program genCode
+ * would write for them into *program, building no AST and checking
+ * nothing. Returns what hand_parse returns. */
+int hand_compile(CompileContext *ctx, std::string *program);
+
+#endif /* HANDPARSE_H_ */
@@ -0,0 +1,52 @@
+#include "intern.h"
+
+const char *const predefined_names[PREDEFINED_NAME_COUNT] = {
+    "gl_FragColor",
+    "gl_FragDepth",
+    "gl_FragCoord",
+    "gl_TexCoord",
+    "gl_Color",
+    "gl_Secondary",
+    "gl_FogFradCoord",
+    "gl_Light_Half",
+    "gl_Light_Ambient",
+    "gl_Material_Shininess",
+    "env1",
+    "env2",
+    "env3",
+};
+
+StringPool::StringPool()
+{
+    /* Room for a typical shader before the first rehash */
+    m_ids.reserve(256);
+    m_names.reserve(256);
+    for (const char *name : predefined_names)
+        intern(name);
+}
+
+SymbolId StringPool::intern(std::string_view name)
+{
+    auto inserted = m_ids.emplace(name, (SymbolId)m_names.size());
+    if (inserted.second)
+        m_names.push_back(name);
+    return inserted.first->second;
+}
+
+SymbolId StringPool::intern_copy(std::string_view name)
+{
+    auto found = m_ids.find(name);
+    if (found != m_ids.end())
+        return found->second;
+    return intern(m_owned.emplace_back(name));
+}
+
+void StringPool::own_names()
+{
+    for (SymbolId id = (SymbolId)m_owned_count; id < m_names.size(); id++) {
+        m_ids.erase(m_names[id]);
+        m_names[id] = m_owned.emplace_back(m_names[id]);
+        m_ids.emplace(m_names[id], id);
+    }
+    m_owned_count = m_names.size();
+}
@@ -0,0 +1,81 @@
+/***********************************************************************
+ * intern.h
+ *
+ * Pool of the identifiers of one compile. The scanner interns every ID
+ * token as it is read and hands the parser a 32 bit SymbolId along with
+ * the text, so the symbol table and code generation hash and compare
+ * integers rather than strings. Equal names get equal ids.
+ *
+ * The pool holds views, not copies: interned text has to outlive the
+ * pool, which the source buffer and string literals do. A pool kept
+ * across versions of a source copies the names once it has them, see
+ * own_names.
+ *
+ * The predefined variables are interned first, in the order of
+ * predefined_names, so their ids are the same in every compile and the
+ * process wide predefined declarations can carry them.
+ **********************************************************************/
+
+#ifndef INTERN_H_
+#define INTERN_H_ 1
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t SymbolId;
+
+enum PredefinedName {
+    PREDEFINED_GL_FRAGCOLOR,
+    PREDEFINED_GL_FRAGDEPTH,
+    PREDEFINED_GL_FRAGCOORD,
+    PREDEFINED_GL_TEXCOORD,
+    PREDEFINED_GL_COLOR,
+    PREDEFINED_GL_SECONDARY,
+    PREDEFINED_GL_FOGFRADCOORD,
+    PREDEFINED_GL_LIGHT_HALF,
+    PREDEFINED_GL_LIGHT_AMBIENT,
+    PREDEFINED_GL_MATERIAL_SHININESS,
+    PREDEFINED_ENV1,
+    PREDEFINED_ENV2,
+    PREDEFINED_ENV3,
+    PREDEFINED_NAME_COUNT
+};
+
+/* Indexed by PredefinedName */
+extern const char *const predefined_names[PREDEFINED_NAME_COUNT];
+
+class StringPool
+{
+  private:
+    std::unordered_map<std::string_view, SymbolId> m_ids;
+    std::vector<std::string_view> m_names;   /* Indexed by SymbolId */
+    std::deque<std::string> m_owned;         /* Copies of names, see own_names */
+    size_t m_owned_count = PREDEFINED_NAME_COUNT;    /* Names not viewing a source */
+
+  public:
+    StringPool();
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    /* The id of name, interning it if it is new */
+    SymbolId intern(std::string_view name);
+
+    /* Same, for a name that does not outlive the call: a new one is
+     * interned as a copy the pool keeps */
+    SymbolId intern_copy(std::string_view name);
+
+    /* Copy the text of the names interned since the last call into the
+     * pool, so they stop viewing the source they were scanned from */
+    void own_names();
+
+    std::string_view get_name(SymbolId id) const {return m_names[id];}
+    size_t size() const {return m_names.size();}
+
+    static bool is_predefined(SymbolId id) {return id < PREDEFINED_NAME_COUNT;}
+};
+
+#endif /* INTERN_H_ */
@@ -0,0 +1,51 @@
+/***********************************************************************
+ * literal.h
+ *
+ * Conversion of number tokens, shared by both scanners. std::from_chars
+ * works on the token in place: it needs no NUL terminator, copies
+ * nothing and never looks at the locale. Floats round exactly as strtof
+ * does, to the nearest float. A float that overflows or underflows
+ * goes through strtof itself, so those rare cases also match it.
+ **********************************************************************/
+
+#ifndef LITERAL_H_
+#define LITERAL_H_ 1
+
+#include <stdlib.h>
+#include <charconv>
+#include <string>
+#include "common.h"
+
+enum LiteralStatus {
+    LITERAL_OK,
+    LITERAL_INVALID,     /* Not a number at all */
+    LITERAL_TOO_LARGE    /* Above MAX_INTEGER or MAX_FLOAT */
+};
+
+inline LiteralStatus parse_int_literal(const char *text, size_t length, int *value)
+{
+    long int_num;
+    std::from_chars_result result = std::from_chars(text, text + length, int_num);
+    if (result.ec == std::errc::invalid_argument)
+        return LITERAL_INVALID;
+    if (result.ec == std::errc::result_out_of_range || int_num > MAX_INTEGER)
+        return LITERAL_TOO_LARGE;
+    *value = (int)int_num;
+    return LITERAL_OK;
+}
+
+inline LiteralStatus parse_float_literal(const char *text, size_t length, float *value)
+{
+    float float_num;
+    std::from_chars_result result = std::from_chars(text, text + length, float_num);
+    if (result.ec == std::errc::invalid_argument)
+        return LITERAL_INVALID;
+    if (result.ec == std::errc::result_out_of_range)
+        float_num = strtof(std::string(text, length).c_str(), nullptr);
+    if (float_num > MAX_FLOAT)
+        return LITERAL_TOO_LARGE;
+    *value = float_num;
+    return LITERAL_OK;
+}
+
+#endif /* LITERAL_H_ */
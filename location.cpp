@@ -0,0 +1,94 @@
+#include <string.h>
+#include <algorithm>
+#include "location.h"
+
+void LineTable::build()
+{
+    m_line_starts.push_back(0);
+    const char *end = m_text + m_length;
+    for (const char *c = m_text; (c = (const char *)memchr(c, '\n', end - c)) != nullptr; c++)
+        m_line_starts.push_back((uint32_t)(c + 1 - m_text));
+}
+
+void LineTable::add_file(const char *name, const char *text, size_t length, uint32_t base)
+{
+    m_files.push_back(IncludedFile{base, name, std::unique_ptr<LineTable>(new LineTable(text, length))});
+}
+
+/* The table of the file offset is in, with offset made relative to it */
+LineTable *LineTable::find(uint32_t *offset, const char **file)
+{
+    *file = nullptr;
+    if (m_files.empty() || *offset <= m_length)
+        return this;
+    auto next = std::upper_bound(m_files.begin(), m_files.end(), *offset,
+                                 [](uint32_t offset, const IncludedFile &file) {return offset < file.base;});
+    *file = next[-1].name;
+    *offset -= next[-1].base;
+    return next[-1].lines.get();
+}
+
+void LineTable::locate(uint32_t offset, int *line, int *column)
+{
+    const char *file;
+    LineTable *table = find(&offset, &file);
+    if (table->m_line_starts.empty())
+        table->build();
+    auto next = std::upper_bound(table->m_line_starts.begin(), table->m_line_starts.end(), offset);
+    *line = (int)(next - table->m_line_starts.begin());
+    *column = (int)(offset - next[-1]) + 1;
+}
+
+NodeLocation LineTable::locate(SourceSpan span)
+{
+    int first_line, first_col, last_line, last_col;
+    uint32_t first = span.begin, last = span.end - 1;
+    const char *file, *last_file = nullptr;
+    find(&first, &file);
+    if (span.end > span.begin)
+        find(&last, &last_file);
+    locate(span.begin, &first_line, &first_col);
+    /* A span that runs from one file into another is located at its start */
+    if (span.end > span.begin && last_file == file) {
+        locate(span.end - 1, &last_line, &last_col);
+        last_col++;
+    } else {
+        last_line = first_line;
+        last_col = first_col;
+    }
+    return NodeLocation(first_line, last_line, first_col, last_col, file);
+}
+
+bool LineTable::get_line(const char *file, int line, const char **text, int *length)
+{
+    if (file != nullptr) {
+        for (IncludedFile &included : m_files)
+            if (included.name == file)
+                return included.lines->get_line(nullptr, line, text, length);
+        return false;
+    }
+    if (m_line_starts.empty())
+        build();
+    if (line < 1 || line > (int)m_line_starts.size())
+        return false;
+    size_t start = m_line_starts[line - 1];
+    size_t end = line < (int)m_line_starts.size() ? m_line_starts[line] : m_length;
+    if (start == m_length)
+        return false;    /* Nothing follows the last line break */
+    while (end > start && (m_text[end - 1] == '\n' || m_text[end - 1] == '\r'))
+        end--;
+    *text = m_text + start;
+    *length = (int)(end - start);
+    return true;
+}
+
+void print_location(FILE *file, LineTable *lines, SourceSpan span)
+{
+    NodeLocation location = lines->locate(span);
+    int end_col = location.get_last_col() != 0 ? location.get_last_col() - 1 : 0;
+    fprintf(file, "%d.%d", location.get_first_line(), location.get_first_col());
+    if (location.get_first_line() < location.get_last_line())
+        fprintf(file, "-%d.%d", location.get_last_line(), end_col);
+    else if (location.get_first_col() < end_col)
+        fprintf(file, "-%d", end_col);
+}
@@ -0,0 +1,119 @@
+/***********************************************************************
+ * location.h
+ *
+ * Where tokens and AST nodes are in the source. Each carries a
+ * SourceSpan: the byte offset of its first character and the offset
+ * just past its last one. Lines and columns are only needed for
+ * messages, so a LineTable works them out on demand. It finds the line
+ * starts of the source the first time it is asked and then uses a
+ * binary search over them.
+ *
+ * Tokens of files the preprocessor includes are given offsets past the
+ * end of the source, each file a range of its own, so a span tells the
+ * file as well; the LineTable of the source locates those too.
+ **********************************************************************/
+
+#ifndef LOCATION_H_
+#define LOCATION_H_ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/* Offsets are 32 bits, compileSource refuses larger sources */
+#define MAX_SOURCE_LENGTH UINT32_MAX
+
+struct SourceSpan
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+/* A span as lines and columns, both counted from 1. last_col is one
+ * past the last character, as the scanners always reported it. file is
+ * the name of the included file the span is in, NULL for the source. */
+class NodeLocation
+{
+  private:
+    int m_first_line = 0;
+    int m_last_line  = 0;
+    int m_first_col = 0;
+    int m_last_col = 0;
+    const char *m_file = nullptr;
+  public:
+    NodeLocation(int first_line, int last_line, int first_col, int last_col, const char *file = nullptr) :
+      m_first_line(first_line), m_last_line(last_line), m_first_col(first_col), m_last_col(last_col), m_file(file) {}
+
+    int get_first_line() const {return m_first_line;}
+    int get_last_line() const {return m_last_line;}
+    int get_first_col() const {return m_first_col;}
+    int get_last_col() const {return m_last_col;}
+    const char *get_file() const {return m_file;}
+
+};
+
+inline std::ostream& operator<<(std::ostream &out, NodeLocation const& data) {
+      out << "at line ";
+      out << data.get_first_line() << ':';
+      out << data.get_first_col();
+      out << " to " << data.get_last_line() << ':';
+      out << data.get_last_col();
+      if (data.get_file())
+          out << " in " << data.get_file();
+
+      return out;
+}
+
+class LineTable
+{
+  private:
+    const char *m_text;
+    size_t m_length;
+    std::vector<uint32_t> m_line_starts;    /* Empty until first needed */
+
+    /* Included files, in the order of their offsets */
+    struct IncludedFile
+    {
+        uint32_t base;
+        const char *name;
+        std::unique_ptr<LineTable> lines;
+    };
+    std::vector<IncludedFile> m_files;
+
+    void build();
+    LineTable *find(uint32_t *offset, const char **file);
+
+  public:
+    LineTable(const char *text, size_t length) : m_text(text), m_length(length) {}
+    LineTable(const LineTable &) = delete;
+    LineTable &operator=(const LineTable &) = delete;
+
+    /* The text has grown or moved: forget the line starts found so far,
+     * and the included files */
+    void reset(const char *text, size_t length) {
+        m_text = text;
+        m_length = length;
+        m_line_starts.clear();
+        m_files.clear();
+    }
+
+    /* Locate offsets from base on in length bytes of text, included from
+     * the file called name. Files are added in the order of their bases,
+     * which lie past the end of the source; text and name have to stay. */
+    void add_file(const char *name, const char *text, size_t length, uint32_t base);
+
+    /* Line and column of the byte at offset, in whichever file it is */
+    void locate(uint32_t offset, int *line, int *column);
+    NodeLocation locate(SourceSpan span);
+
+    /* Text of line of file (NULL for the source) without its line break.
+     * False if there is no such line. */
+    bool get_line(const char *file, int line, const char **text, int *length);
+};
+
+/* Print span the way bison prints locations in parser traces */
+void print_location(FILE *file, LineTable *lines, SourceSpan span);
+
+#endif /* LOCATION_H_ */
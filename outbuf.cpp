@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include "outbuf.h"
+
+void OutputBuffer::open_file(FILE *file)
+{
+    m_file = file;
+    if (m_file) {
+        /* Should this fail, every append is written directly */
+        m_data = (char *)malloc(OUTPUT_CHUNK_SIZE);
+        m_capacity = m_data ? OUTPUT_CHUNK_SIZE : 0;
+        m_owns_data = true;
+    }
+}
+
+OutputBuffer::OutputBuffer(CompileContext *ctx)
+{
+    if (ctx->outputText)
+        m_text = ctx->outputText;
+    else if (ctx->outputBuffer) {
+        m_data = ctx->outputBuffer;
+        m_capacity = ctx->outputCapacity;
+    } else
+        open_file(ctx->outputFile);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+    if (m_owns_data)
+        free(m_data);
+}
+
+void OutputBuffer::append_slow(const char *data, size_t length)
+{
+    if (m_file) {
+        /* Write out the staged chunk. A piece as large as a chunk goes
+         * straight to the file, anything smaller starts the next chunk. */
+        flush();
+        if (length >= m_capacity)
+            fwrite(data, 1, length, m_file);
+        else {
+            memcpy(m_data, data, length);
+            m_used = length;
+        }
+        return;
+    }
+
+    /* Caller's buffer: keep what fits, count the rest */
+    size_t room = m_capacity - m_used;
+    if (room > 0) {
+        memcpy(m_data + m_used, data, room);
+        m_used += room;
+    }
+}
+
+void OutputBuffer::flush()
+{
+    if (m_file && m_used > 0) {
+        fwrite(m_data, 1, m_used, m_file);
+        m_used = 0;
+    }
+}
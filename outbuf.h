@@ -0,0 +1,73 @@
+/***********************************************************************
+ * outbuf.h
+ *
+ * Append-only sink for the generated program. Code generation appends
+ * each piece of an instruction straight into it, so no instruction is
+ * ever built as a string of its own. The bytes end up in one of:
+ *   - a FILE*, written with large fwrite calls from a staging buffer
+ *   - a std::string, appended to in place
+ *   - a caller supplied buffer of fixed capacity; bytes that do not fit
+ *     are dropped but still counted, as snprintf does
+ **********************************************************************/
+
+#ifndef OUTBUF_H_
+#define OUTBUF_H_ 1
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "context.h"
+
+/* Bytes staged before each write to a FILE* */
+#define OUTPUT_CHUNK_SIZE (64 * 1024)
+
+class OutputBuffer
+{
+  private:
+    FILE        *m_file = nullptr;
+    std::string *m_text = nullptr;
+    char        *m_data = nullptr;   /* Staging buffer or the caller's buffer */
+    size_t       m_capacity = 0;
+    size_t       m_used = 0;         /* Bytes held in m_data */
+    size_t       m_length = 0;       /* Bytes appended so far */
+    bool         m_owns_data = false;
+
+    void open_file(FILE *file);
+    void append_slow(const char *data, size_t length);
+
+  public:
+    explicit OutputBuffer(FILE *file) {open_file(file);}
+    explicit OutputBuffer(std::string *text) : m_text(text) {}
+    OutputBuffer(char *buffer, size_t capacity) : m_data(buffer), m_capacity(capacity) {}
+
+    /* The sink ctx asks for: outputText, then outputBuffer, then
+     * outputFile. With none of them the program is discarded. */
+    explicit OutputBuffer(CompileContext *ctx);
+
+    ~OutputBuffer();
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    OutputBuffer &append(const char *data, size_t length) {
+        if (m_text)
+            m_text->append(data, length);
+        else if (m_used + length <= m_capacity) {
+            memcpy(m_data + m_used, data, length);
+            m_used += length;
+        } else
+            append_slow(data, length);
+        m_length += length;
+        return *this;
+    }
+    OutputBuffer &append(const char *text) {return append(text, strlen(text));}
+    OutputBuffer &append(const std::string &text) {return append(text.data(), text.size());}
+    OutputBuffer &put(char c) {return append(&c, 1);}
+
+    /* Hands staged bytes to the FILE*. Called by the destructor too. */
+    void flush();
+
+    /* Bytes appended so far, including any dropped for lack of room */
+    size_t length() const {return m_length;}
+};
+
+#endif /* OUTBUF_H_ */
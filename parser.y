@@ -19,15 +19,30 @@
 #include "ast.h"
 #include "symbol.h"
 #include "semantic.h"
+#include "stats.h"
+#include "preprocess.h"
+#include "handparse.h"
 #define YYERROR_VERBOSE
-#define yTRACE(x)    { if (traceParser) fprintf(traceFile, "%s\n", x); }
-
-void yyerror(const char* s);    /* what to do in case of error            */
-int yylex();              /* procedure for calling lexical analyzer */
-extern int yyline;        /* variable holding current line number   */
+#define yTRACE(x)    { if (ctx->traceParser) fprintf(ctx->traceFile, "%s\n", x); }
 
 %}
 
+%code requires {
+#include "context.h"
+#include "intern.h"
+#include "location.h"
+
+/* Text of an identifier or function name token. It points into the
+ * source buffer, which outlives the AST, so it is never copied. An
+ * identifier also carries its id in ctx->identifiers. */
+struct Lexeme
+{
+    const char *text;
+    int length;
+    SymbolId symbol;
+};
+}
+
 /***********************************************************************
  *  Yacc/Bison declarations.
  *  Phase 2:
@@ -49,6 +64,11 @@ extern int yyline;        /* variable holding current line number   */
 %}
 
 %locations
+%define api.location.type {SourceSpan}
+%define api.pure full
+%define api.push-pull both    /* yyparse pulls tokens, CompileStream pushes them */
+%lex-param   {CompileContext *ctx} {yyscan_t scanner}
+%parse-param {CompileContext *ctx} {yyscan_t scanner}
 
 // TODO:Modify me to add more data types
 // Can access me from flex useing yyval
@@ -59,16 +79,49 @@ extern int yyline;        /* variable holding current line number   */
     bool as_bool;
     int as_int;
     float as_float;
-    char as_id[MAX_IDENTIFIER - 1];
+    Lexeme as_id;
 
 
 
     int vec_dimension;
-    char func_name[3];
+    Lexeme func_name;
 
     node *as_node; /* this field is only used for AST */
 }
 
+%{
+/* Locations are byte offsets, see location.h. A rule spans its first
+ * symbol to its last; an empty rule sits where the one before it ended. */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                        \
+  do {                                                         \
+    if (N) {                                                   \
+      (Current).begin = YYRHSLOC(Rhs, 1).begin;                \
+      (Current).end   = YYRHSLOC(Rhs, N).end;                  \
+    } else                                                     \
+      (Current).begin = (Current).end = YYRHSLOC(Rhs, 0).end;  \
+  } while (0)
+#define YYLOCATION_PRINT(File, Loc) print_location(File, ctx->lines, *(Loc))
+
+/* Bison only grows its stacks for location types it declares itself,
+ * so start them at the full depth, which the hand parser shares */
+#define YYMAXDEPTH PARSER_STACK_DEPTH
+#define YYINITDEPTH YYMAXDEPTH
+
+void yyerror(YYLTYPE *yylloc, CompileContext *ctx, yyscan_t scanner, const char* s); /* what to do in case of error */
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);                      /* procedure for calling lexical analyzer */
+
+/* The parser reads tokens through parser_lex, which counts them; -Tt
+ * times scanning in a pass of its own. A source with directives has
+ * had its tokens read already. */
+static int parser_lex(YYSTYPE *yylval, YYLTYPE *yylloc, CompileContext *ctx, yyscan_t scanner) {
+  int token = ctx->preprocessor ? ctx->preprocessor->next(yylval, yylloc) : yylex(yylval, yylloc, scanner);
+  if (ctx->stats && token)
+    ctx->stats->tokens++;
+  return token;
+}
+#define yylex parser_lex
+%}
+
 /*********************************************************************
  *                          TYPE DECLARATION                         *
 *********************************************************************/
@@ -89,6 +142,7 @@ extern int yyline;        /* variable holding current line number   */
 %type <as_id> ID
 %type <as_bool> CONST_TYPE
 %type <func_name> function_name
+%type <func_name> FUNC_NAME
 
 
 
@@ -142,42 +196,43 @@ extern int yyline;        /* variable holding current line number   */
  *    1. Add code to rules for construction of AST.
  ***********************************************************************/
 program
-  : scope                                                                                                           { ast = $1;
+  : scope                                                                                                           { ctx->ast = $1;
                                                                                                                      yTRACE("program: -> scope");}
   ;
 scope:
-    LEFT_CURLY declarations statements RIGHT_CURLY                                                                  { $$ = ast_allocate(SCOPE_NODE, $2, $3);
+    LEFT_CURLY declarations statements RIGHT_CURLY                                                                  { $$ = ast_allocate(ctx->arena, SCOPE_NODE, $2, $3, &@$);
                                                                                                                      yTRACE("scope: -> LEFT_CURLY declarations statements RIGHT_CURLY");}
     ;
 declarations
-    : declarations declaration                                                                                      {$$ = ast_allocate(DECLARATIONS_NODE, $1, $2);
+    : declarations declaration                                                                                      {$$ = ast_allocate(ctx->arena, DECLARATIONS_NODE, $1, $2);
                                                                                                                      yTRACE("declarations: -> declarations declaration");}
-    |                                                                                                               {$$ = ast_allocate(DECLARATIONS_NODE, nullptr, nullptr);
+    |                                                                                                               {$$ = ast_allocate(ctx->arena, DECLARATIONS_NODE, nullptr, nullptr);
                                                                                                                       yTRACE("declarations: -> epislon");}
     ;
 statements
-    : statements statement                                                                                          {$$ = ast_allocate(STATEMENTS_NODE, $1, $2);
+    : statements statement                                                                                          {$$ = ast_allocate(ctx->arena, STATEMENTS_NODE, $1, $2);
                                                                                                                      yTRACE("statements: -> statements statement");}
-    |                                                                                                               {$$ = ast_allocate(STATEMENTS_NODE, NULL, NULL);
+    |                                                                                                               {$$ = ast_allocate(ctx->arena, STATEMENTS_NODE, NULL, NULL);
                                                                                                                      yTRACE("statements: -> epislon");}
     ;
 declaration
-    : type ID SEMICOLON                                                                                             {$$ = ast_allocate(DECLARATION_NODE, $1, $2, NULL, false, &@$);
+    : type ID SEMICOLON                                                                                             {$$ = ast_allocate(ctx->arena, DECLARATION_NODE, $1, $2.text, $2.length, $2.symbol, NULL, false, &@$);
                                                                                                                      yTRACE("declaration: -> type ID SEMICOLON");}
-    | type ID EQ expression SEMICOLON                                                                               {$$ = ast_allocate(DECLARATION_NODE, $1, $2, $4, false, &@$);
+    | type ID EQ expression SEMICOLON                                                                               {$$ = ast_allocate(ctx->arena, DECLARATION_NODE, $1, $2.text, $2.length, $2.symbol, $4, false, &@$);
                                                                                                                      yTRACE("declaration: -> type ID EQ expression SEMICOLON");}
-    | CONST_TYPE type ID EQ expression SEMICOLON                                                                    {$$ = ast_allocate(DECLARATION_NODE, $2, $3, $5, true, &@$);
+    | CONST_TYPE type ID EQ expression SEMICOLON                                                                    {$$ = ast_allocate(ctx->arena, DECLARATION_NODE, $2, $3.text, $3.length, $3.symbol, $5, true, &@$);
                                                                                                                      yTRACE("declaration: -> CONST_TYPE type ID EQ expression SEMICOLON");}
     ;
 statement
-    : variable EQ expression SEMICOLON                                                                              {$$ = ast_allocate(ASSIGNMENT_NODE, $1, $3, &@$);
+    : variable EQ expression SEMICOLON                                                                              {$$ = ast_allocate(ctx->arena, ASSIGNMENT_NODE, $1, $3, &@$);
                                                                                                                      yTRACE("statement: -> variable EQ expression SEMICOLON");}
-    | IF LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement else_statement                                     {$$ = ast_allocate(IF_STATEMENT_NODE, $3, $5, $6, &@$);
+    | IF LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement else_statement                                     {$$ = ast_allocate(ctx->arena, IF_STATEMENT_NODE, $3, $5, $6, &@$);
                                                                                                                      yTRACE("statement: -> IF LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement else_statement");}
-    | WHILE LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement                             %prec FUNCTION_CALL {yTRACE("statement: -> WHILE LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement");}
-    | scope                                                                                                         {$$ = ast_allocate(NESTED_SCOPE_NODE, $1);
+    | WHILE LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement                             %prec FUNCTION_CALL {$$ = NULL;
+                                                                                                                     yTRACE("statement: -> WHILE LEFT_PARENTHESIS expression RIGHT_PARENTHESIS statement");}
+    | scope                                                                                                         {$$ = ast_allocate(ctx->arena, NESTED_SCOPE_NODE, $1);
                                                                                                                      yTRACE("statement: -> scope");}
-    | SEMICOLON                                                                                                     {$$ = ast_allocate(EMPTY_STATEMENT_NODE);
+    | SEMICOLON                                                                                                     {$$ = ast_allocate(ctx->arena, EMPTY_STATEMENT_NODE, &@$);
                                                                                                                      yTRACE("statement: -> SEMICOLON");}
     ;
 else_statement
@@ -187,93 +242,93 @@ else_statement
                                                                                                                      yTRACE("statement: -> epislon");}
     ;
 type
-    : INT_TYPE                                                                                                      {$$ = ast_allocate(TYPE_NODE, 0, yylval.vec_dimension);
+    : INT_TYPE                                                                                                      {$$ = ast_allocate(ctx->arena, TYPE_NODE, 0, yylval.vec_dimension);
                                                                                                                      yTRACE("type: -> INT_TYPE");}
-    | BOOL_TYPE                                                                                                     {$$ = ast_allocate(TYPE_NODE, 1, yylval.vec_dimension);
+    | BOOL_TYPE                                                                                                     {$$ = ast_allocate(ctx->arena, TYPE_NODE, 1, yylval.vec_dimension);
                                                                                                                      yTRACE("type: -> BOOL_TYPE");}
-    | FLOAT_TYPE                                                                                                    {$$ = ast_allocate(TYPE_NODE, 2, yylval.vec_dimension);
+    | FLOAT_TYPE                                                                                                    {$$ = ast_allocate(ctx->arena, TYPE_NODE, 2, yylval.vec_dimension);
                                                                                                                      yTRACE("type: -> FLOAT_TYPE");}
     ;
 expression
-    : constructor                                                                                                   {$$ = ast_allocate(EXPRESSION_NODE, CONSTRUCTOR_EXPRESSION, $1, &@$);
+    : constructor                                                                                                   {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, CONSTRUCTOR_EXPRESSION, $1, &@$);
                                                                                                                      yTRACE("expression: -> constructor");}
-    | function                                                                                                      {$$ = ast_allocate(EXPRESSION_NODE, FUNCTION, $1, &@$);
+    | function                                                                                                      {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, FUNCTION, $1, &@$);
                                                                                                                      yTRACE("expression: -> function");}
-    | INT                                                                                                           {$$ = ast_allocate(EXPRESSION_NODE, INT_LITERAL, yylval.as_int, &@$);
+    | INT                                                                                                           {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, INT_LITERAL, yylval.as_int, &@$);
                                                                                                                      yTRACE("expression: -> INT");}
-    | FLOAT                                                                                                         {$$ = ast_allocate(EXPRESSION_NODE, FLOAT_LITERAL, yylval.as_float, &@$);
+    | FLOAT                                                                                                         {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, FLOAT_LITERAL, yylval.as_float, &@$);
                                                                                                                      yTRACE("expression: -> FLOAT");}
-    | BOOL                                                                                                          {$$ = ast_allocate(EXPRESSION_NODE, BOOL_EXPRESSION, yylval.as_bool, &@$);
+    | BOOL                                                                                                          {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, BOOL_EXPRESSION, yylval.as_bool, &@$);
                                                                                                                      yTRACE("expression: -> BOOL");}
-    | variable                                                                                                      {$$ = ast_allocate(EXPRESSION_NODE, VARIABLE, $1, &@$);
+    | variable                                                                                                      {$$ = ast_allocate(ctx->arena, EXPRESSION_NODE, VARIABLE, $1, &@$);
                                                                                                                      yTRACE("expression: -> variable");}
-    | NOT expression                                                                            %prec UNARY         {$$ = ast_allocate(UNARY_EXPRESSION_NODE, NOT, $2, &@$);
+    | NOT expression                                                                            %prec UNARY         {$$ = ast_allocate(ctx->arena, UNARY_EXPRESSION_NODE, NOT, $2, &@$);
                                                                                                                      yTRACE("expression: -> NOT expression");}
-    | MINUS expression                                                                          %prec UNARY         {$$ = ast_allocate(UNARY_EXPRESSION_NODE, MINUS, $2, &@$);
+    | MINUS expression                                                                          %prec UNARY         {$$ = ast_allocate(ctx->arena, UNARY_EXPRESSION_NODE, MINUS, $2, &@$);
                                                                                                                      yTRACE("expression: -> NEGATE expression");}
-    | expression AND expression                                                                                     {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, AND, $3, &@$);
+    | expression AND expression                                                                                     {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, AND, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression AND expression");}
-    | expression OR expression                                                                                      {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, OR, $3, &@$);
+    | expression OR expression                                                                                      {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, OR, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression OR expression");}
-    | expression DOUBLE_EQ expression                                                                               {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, DOUBLE_EQ, $3, &@$);
+    | expression DOUBLE_EQ expression                                                                               {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, DOUBLE_EQ, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression DOUBLE_EQ expression");}
-    | expression N_EQ expression                                                                                    {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, N_EQ, $3, &@$);
+    | expression N_EQ expression                                                                                    {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, N_EQ, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression N_EQ expression");}
-    | expression SMALLER expression                                                                                 {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, SMALLER, $3, &@$);
+    | expression SMALLER expression                                                                                 {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, SMALLER, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression SMALLER expression");}
-    | expression S_EQ expression                                                                                    {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, S_EQ, $3, &@$);
+    | expression S_EQ expression                                                                                    {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, S_EQ, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression S_EQ expression");}
-    | expression GREATER expression                                                                                 {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, GREATER, $3, &@$);
+    | expression GREATER expression                                                                                 {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, GREATER, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression GREATER expression");}
-    | expression G_EQ expression                                                                                    {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, G_EQ, $3, &@$);
+    | expression G_EQ expression                                                                                    {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, G_EQ, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression G_EQ expression");}
-    | expression PLUS expression                                                                                    {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, PLUS, $3, &@$);
+    | expression PLUS expression                                                                                    {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, PLUS, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression PLUS expression");}
-    | expression MINUS expression                                                                                   {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, MINUS, $3, &@$);
+    | expression MINUS expression                                                                                   {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, MINUS, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression MINUS expression");}
-    | expression TIMES expression                                                                                   {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, TIMES, $3, &@$);
+    | expression TIMES expression                                                                                   {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, TIMES, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression TIMES experssion");}
-    | expression DIVIDE expression                                                                                  {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, DIVIDE, $3, &@$);
+    | expression DIVIDE expression                                                                                  {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, DIVIDE, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression DIVIDE expression");}
-    | expression CARET expression                                                                                   {$$= ast_allocate(BINARY_EXPRESSION_NODE, $1, CARET, $3, &@$);
+    | expression CARET expression                                                                                   {$$= ast_allocate(ctx->arena, BINARY_EXPRESSION_NODE, $1, CARET, $3, &@$);
                                                                                                                      yTRACE("expression: -> expression CARET expression");}
     | LEFT_PARENTHESIS expression RIGHT_PARENTHESIS                                                                 {$$= $2;
                                                                                                                      yTRACE("expression: -> LEFT_PARENTHESIS expression RIGHT_PARENTHESIS");}
     ;
 
 variable
-    : ID                                                                                                            {$$ = ast_allocate(IDENTIFIER_NODE, yylval.as_id, &@$); /* Will this one work tho */
+    : ID                                                                                                            {$$ = ast_allocate(ctx->arena, IDENTIFIER_NODE, $1.text, $1.length, $1.symbol, &@$);
                                                                                                                      yTRACE("variable: -> ID");}
-    | ID LEFT_BRACKET INT RIGHT_BRACKET                                                     %prec VECTOR_SUBSCRIPT  {$$ = ast_allocate(VECTOR_NODE, $1, yylval.as_int, &@$);
+    | ID LEFT_BRACKET INT RIGHT_BRACKET                                                     %prec VECTOR_SUBSCRIPT  {$$ = ast_allocate(ctx->arena, VECTOR_NODE, $1.text, $1.length, $1.symbol, yylval.as_int, &@$);
                                                                                                                      yTRACE("variable: -> ID LEFT_BRACKET INT RIGHT_BRACKET");}
     ;
 
 constructor
-    : type LEFT_PARENTHESIS arguments RIGHT_PARENTHESIS                                     %prec CONSTRUCTOR_CALL  {$$ = ast_allocate(CONSTRUCTOR_NODE, $1, $3, &@$);
+    : type LEFT_PARENTHESIS arguments RIGHT_PARENTHESIS                                     %prec CONSTRUCTOR_CALL  {$$ = ast_allocate(ctx->arena, CONSTRUCTOR_NODE, $1, $3, &@$);
                                                                                                                      yTRACE("constuctor: ->  type LEFT_PARENTHESIS arguments RIGHT_PARENTHEIS");}
     ;
 
 function
-    : function_name LEFT_PARENTHESIS arguments_opt RIGHT_PARENTHESIS                        %prec FUNCTION_CALL     {$$ = ast_allocate(FUNCTION_NODE, $1, $3, &@$);
+    : function_name LEFT_PARENTHESIS arguments_opt RIGHT_PARENTHESIS                        %prec FUNCTION_CALL     {$$ = ast_allocate(ctx->arena, FUNCTION_NODE, $1.text, $1.length, $3, &@$);
                                                                                                                      yTRACE("function: -> function_name LEFT_PARENTHESIS arguments_opt RIGHT_PARENTHESIS");}
     ;
 
 function_name
-    : FUNC_NAME                                                                                                     {strcpy($$, yylval.func_name); /* copy array content into lhs */
+    : FUNC_NAME                                                                                                     {$$ = $1;
                                                                                                                      yTRACE("function_name: -> ('dp3'|'lit'|'rsq')");}
     ;
 
 arguments_opt
     : arguments                                                                                                     {$$ = $1;
                                                                                                                      yTRACE("arguments_opt: -> arguments");}
-    |                                                                                                               {$$ = ast_allocate(ARGUMENTS_NODE, NULL, NULL);
+    |                                                                                                               {$$ = ast_allocate(ctx->arena, ARGUMENTS_NODE, NULL, NULL, &@$);
                                                                                                                      yTRACE("arguments_opt: -> epislon");}
     ;
 
 arguments
-    : arguments COMMA expression                                                                                    {$$ = ast_allocate(ARGUMENTS_NODE, $1, $3, &@$);
+    : arguments COMMA expression                                                                                    {$$ = ast_allocate(ctx->arena, ARGUMENTS_NODE, $1, $3, &@$);
                                                                                                                      yTRACE("arguments: -> arguments COMMA expression");}
-    | expression                                                                                                    {$$ = ast_allocate(ARGUMENTS_NODE, NULL, $1, &@$);
+    | expression                                                                                                    {$$ = ast_allocate(ctx->arena, ARGUMENTS_NODE, NULL, $1, &@$);
                                                                                                                      yTRACE("arguments: -> expression");}
     ;
 
@@ -284,19 +339,19 @@ arguments
  * The given yyerror function should not be touched. You may add helper
  * functions as necessary in subsequent phases.
  ***********************************************************************/
-void yyerror(const char* s) {
-  if (errorOccurred)
+void yyerror(YYLTYPE *yylloc, CompileContext *ctx, yyscan_t scanner, const char* s) {
+  if (ctx->errorOccurred)
     return;    /* Error has already been reported by scanner */
-  else
-    errorOccurred = 1;
-
-  fprintf(errorFile, "\nPARSER ERROR, LINE %d",yyline);
-  if (strcmp(s, "parse error")) {
-    if (strncmp(s, "parse error, ", 13))
-      fprintf(errorFile, ": %s\n", s);
-    else
-      fprintf(errorFile, ": %s\n", s+13);
-  } else
-    fprintf(errorFile, ": Reading token %s\n", yytname[YYTRANSLATE(yychar)]);
+
+  /* The pure parser keeps the lookahead token local to yyparse, so the
+   * old "Reading token" fallback for a bare "parse error" is gone. */
+  const char *message = strncmp(s, "parse error, ", 13) ? s : s+13;
+  /* A token of an included file is on a line of that file */
+  NodeLocation location = ctx->lines->locate(*yylloc);
+  if (ctx->errorFile && location.get_file())
+    fprintf(ctx->errorFile, "\nPARSER ERROR, LINE %d OF %s: %s\n", ctx->yyline, location.get_file(), message);
+  else if (ctx->errorFile)
+    fprintf(ctx->errorFile, "\nPARSER ERROR, LINE %d: %s\n", ctx->yyline, message);
+  ctx->add_diagnostic(Diagnostic::SYNTAX, ctx->yyline, location.get_first_col(), message, location.get_file());
 }
 
@@ -0,0 +1,66 @@
+"""Check that the hand written parser (-P) agrees with the bison one.
+
+Every source is compiled with -Da by both parsers, and the AST dump,
+the program, the error messages and the exit status have to match. A
+compile killed by a signal fails, even if the other one is too.
+The sources are basic_test, equivalence_test and any further files or
+directories given.
+
+usage: python3 equivalence.py [--compiler PATH] [source or directory ...]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+here = os.path.dirname(os.path.abspath(__file__))
+test_dirs = [os.path.join(here, "basic_test"),
+             os.path.join(here, "equivalence_test")]
+
+
+def compile_source(compiler, options, source):
+    """Return (exit status, stdout, stderr) of one compile."""
+    result = subprocess.run([compiler, "-X", "-Da"] + options + [source],
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE,
+                            universal_newlines=True, errors="replace")
+    return result.returncode, result.stdout, result.stderr
+
+
+def sources(paths):
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if os.path.isfile(os.path.join(path, name)):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler",
+                        default=os.path.join(here, "..", "compiler467"))
+    parser.add_argument("paths", nargs="*")
+    args = parser.parse_args()
+
+    failure_count = 0
+    tested = 0
+    for source in sources(test_dirs + args.paths):
+        tested += 1
+        bison = compile_source(args.compiler, [], source)
+        hand = compile_source(args.compiler, ["-P"], source)
+        if bison[0] < 0 or hand[0] < 0:
+            print("Compiler crashed on {}".format(source))
+            failure_count += 1
+        elif bison != hand:
+            print("Parsers disagree on {}".format(source))
+            failure_count += 1
+
+    print("{} sources, {} disagreements".format(tested, failure_count))
+    sys.exit(1 if failure_count else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,662 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+#include "preprocess.h"
+#include "ast.h"
+#include "parser.tab.h"
+#include "source.h"
+#include "intern.h"
+
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+
+/* Includes nest no deeper, which also ends a file including itself */
+#define MAX_INCLUDE_DEPTH 32
+
+/* Items of a scanned file that are not tokens */
+#define DIRECTIVE_ITEM (-1)
+#define ERROR_ITEM     (-2)
+
+struct Directive
+{
+    enum Kind {PP_NONE, PP_INCLUDE, PP_DEFINE, PP_UNDEF, PP_IFDEF, PP_IFNDEF, PP_ELSE, PP_ENDIF, PP_BAD};
+
+    Kind kind;
+    std::string_view operand;    /* Macro name or included path */
+    const char *message;         /* What is wrong with a BAD one */
+    uint32_t end;                /* Of its line */
+    size_t items;                /* Tokens and errors after the operand on its line */
+};
+
+static const char *const directive_names[] = {
+    "#", "#include", "#define", "#undef", "#ifdef", "#ifndef", "#else", "#endif", "#"
+};
+
+/* A token as the scanner returned it, a directive or a lexical error */
+struct PreToken
+{
+    int token;              /* Of the scanner, or DIRECTIVE_ITEM or ERROR_ITEM */
+    int line;
+    size_t index;           /* Of the directive or the error */
+    YYSTYPE value;
+    SourceSpan location;
+};
+
+struct ScannedFile
+{
+    std::string name;           /* As included, empty for the source */
+    std::string directory;      /* Its includes are looked for here */
+    SourceBuffer text;
+    std::vector<PreToken> items;    /* Ending in the end of the file, token 0 */
+    std::vector<Directive> directives;
+    std::vector<Diagnostic> errors;
+};
+
+/* An error to report when the parser reaches it */
+struct PendingError
+{
+    const char *heading;
+    Diagnostic diagnostic;
+};
+
+struct PreprocessState
+{
+    std::unique_ptr<ScannedFile> source{new ScannedFile};
+    IncludeCache own_cache;    /* When the context has none */
+    std::vector<std::shared_ptr<const ScannedFile>> included;
+    std::unordered_map<const ScannedFile *, uint32_t> bases;
+    uint32_t next_base = 0;
+
+    struct Macro
+    {
+        const ScannedFile *file;
+        size_t first, count;    /* Of the items of its body */
+    };
+    std::unordered_map<std::string_view, Macro> macros;
+    std::vector<std::string_view> expanding;    /* Macros being expanded, innermost last */
+
+    std::vector<PreToken> tokens;    /* What the parser reads */
+    std::vector<PendingError> errors;
+    size_t next = 0;
+};
+
+bool has_directives(const char *text, size_t length)
+{
+    return memchr(text, '#', length) != nullptr;
+}
+
+/***********************************************************************
+ * Scanning
+ **********************************************************************/
+static inline bool is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Read the directive whose '#' is at hash, on a line ending at eol.
+ * Returns the offset just past what it takes, its operand; the scanner
+ * finds what comes after on the line. */
+static size_t read_directive(const char *text, size_t hash, size_t eol, Directive *directive)
+{
+    size_t p = hash + 1;
+    while (p < eol && is_blank(text[p]))
+        p++;
+    size_t word = p;
+    while (p < eol && is_name_char(text[p]))
+        p++;
+    std::string_view name(text + word, p - word);
+
+    directive->kind = Directive::PP_BAD;
+    directive->message = nullptr;
+    if (name.empty())
+        directive->kind = Directive::PP_NONE;
+    else if (name == "include") {
+        while (p < eol && is_blank(text[p]))
+            p++;
+        char close = p < eol && text[p] == '"' ? '"' : p < eol && text[p] == '<' ? '>' : '\0';
+        const char *end = close ? (const char *)memchr(text + p + 1, close, eol - p - 1) : nullptr;
+        if (end == nullptr || end == text + p + 1) {
+            directive->message = "#include expects \"file\" or <file>";
+            return eol;
+        }
+        directive->kind = Directive::PP_INCLUDE;
+        directive->operand = std::string_view(text + p + 1, end - (text + p + 1));
+        return end + 1 - text;
+    } else if (name == "define" || name == "undef" || name == "ifdef" || name == "ifndef") {
+        while (p < eol && is_blank(text[p]))
+            p++;
+        size_t first = p;
+        while (p < eol && is_name_char(text[p]))
+            p++;
+        if (p == first || (text[first] >= '0' && text[first] <= '9')) {
+            directive->message = name == "define" ? "#define expects a name" :
+                                 name == "undef"  ? "#undef expects a name" :
+                                 name == "ifdef"  ? "#ifdef expects a name" : "#ifndef expects a name";
+            return eol;
+        }
+        if (name == "define" && p < eol && text[p] == '(') {
+            directive->message = "Macros with arguments are not supported";
+            return eol;
+        }
+        directive->kind = name == "define" ? Directive::PP_DEFINE :
+                          name == "undef"  ? Directive::PP_UNDEF :
+                          name == "ifdef"  ? Directive::PP_IFDEF : Directive::PP_IFNDEF;
+        directive->operand = std::string_view(text + first, p - first);
+    } else if (name == "else")
+        directive->kind = Directive::PP_ELSE;
+    else if (name == "endif")
+        directive->kind = Directive::PP_ENDIF;
+    else {
+        directive->message = "Unknown directive";
+        return eol;
+    }
+    return p;
+}
+
+/* Find the directives of text from offset on, outside comments, and
+ * blank each up to the end of its operand so the scanner passes over
+ * it. Their items go in *items, what the blanks replaced in *blanked. */
+static void find_directives(ScannedFile *file, size_t offset, int line,
+                            std::vector<PreToken> *items, std::vector<std::string> *blanked)
+{
+    char *text = file->text.get_data();
+    size_t length = file->text.get_length();
+
+    /* The first line only starts at offset if nothing but blanks is before it */
+    size_t start = offset;
+    while (start > 0 && is_blank(text[start - 1]))
+        start--;
+    bool line_start = start == 0 || text[start - 1] == '\n';
+
+    bool in_comment = false;
+    for (size_t p = offset; p < length; line++) {
+        const char *newline = (const char *)memchr(text + p, '\n', length - p);
+        size_t eol = newline ? newline - text : length;
+        size_t q = p;
+        if (!in_comment && line_start) {
+            while (q < eol && is_blank(text[q]))
+                q++;
+            if (q < eol && text[q] == '#') {
+                Directive directive;
+                size_t end = read_directive(text, q, eol, &directive);
+                directive.end = (uint32_t)eol;
+                directive.items = 0;
+                PreToken item = {DIRECTIVE_ITEM, line, file->directives.size(), {}, {(uint32_t)q, (uint32_t)end}};
+                file->directives.push_back(directive);
+                items->push_back(item);
+                blanked->push_back(std::string(text + q, end - q));
+                memset(text + q, ' ', end - q);
+                q = end;
+            }
+        }
+        for (; q < eol; q++) {
+            if (in_comment) {
+                if (text[q] == '*' && q + 1 < eol && text[q + 1] == '/') {
+                    in_comment = false;
+                    q++;
+                }
+            } else if (text[q] == '/' && q + 1 < eol && text[q + 1] == '*') {
+                in_comment = true;
+                q++;
+            }
+        }
+        p = eol + 1;
+        line_start = true;
+    }
+}
+
+/* Scan file->text from offset on, which is on the given line, into
+ * file->items. Lexical errors become items too, and scanning carries on
+ * past them, since they may lie where an #ifdef leaves out. */
+static bool scan_file(const CompileContext *ctx, ScannedFile *file, size_t offset, int line)
+{
+    std::vector<PreToken> directives;
+    std::vector<std::string> blanked;
+    find_directives(file, offset, line, &directives, &blanked);
+
+    CompileContext scan_ctx;
+    StringPool identifiers;    /* Names are interned again into each compile's pool */
+    LineTable lines(file->text.get_data(), file->text.get_length());
+    scan_ctx.errorFile    = NULL;
+    scan_ctx.traceScanner = ctx->traceScanner;
+    scan_ctx.traceFile    = ctx->traceFile;
+    scan_ctx.sourceText   = file->text.get_data();
+    scan_ctx.sourceLength = file->text.get_length();
+    scan_ctx.lines        = &lines;
+    scan_ctx.identifiers  = &identifiers;
+    if (scanner_init(&scan_ctx))
+        return false;
+    scanner_seek(&scan_ctx, offset);
+    scan_ctx.yyline = line;
+
+    size_t next_directive = 0;
+    YYSTYPE value = {};
+    SourceSpan location = {0, 0};
+    for (;;) {
+        size_t errors = scan_ctx.diagnostics.size();
+        int token = yylex(&value, &location, scan_ctx.scanner);
+        bool failed = scan_ctx.diagnostics.size() > errors;
+        bool at_end = token == 0 && !failed;
+        while (next_directive < directives.size() &&
+               (at_end || directives[next_directive].location.begin < location.begin))
+            file->items.push_back(directives[next_directive++]);
+
+        if (failed) {
+            file->items.push_back(PreToken{ERROR_ITEM, scan_ctx.diagnostics.back().line,
+                                           file->errors.size(), {}, location});
+            file->errors.push_back(scan_ctx.diagnostics.back());
+            scanner_seek(&scan_ctx, location.end);
+            continue;
+        }
+        file->items.push_back(PreToken{token, scan_ctx.yyline, 0, value, location});
+        if (at_end)
+            break;
+    }
+    /* flex leaves a NUL after the last token it read, put it back */
+    scanner_seek(&scan_ctx, offset);
+    scanner_destroy(&scan_ctx);
+
+    /* Put the directives back, for messages that show their lines */
+    char *text = file->text.get_data();
+    for (size_t i = 0; i < directives.size(); i++)
+        memcpy(text + directives[i].location.begin, blanked[i].data(), blanked[i].size());
+
+    /* What follows the operand on a directive's line is its own */
+    for (size_t i = 0; i < file->items.size(); i++) {
+        if (file->items[i].token != DIRECTIVE_ITEM)
+            continue;
+        Directive &directive = file->directives[file->items[i].index];
+        size_t j = i + 1;
+        while (file->items[j].token != 0 && file->items[j].token != DIRECTIVE_ITEM &&
+               file->items[j].location.begin < directive.end)
+            j++;
+        directive.items = j - i - 1;
+    }
+    return true;
+}
+
+/* The directory part of path, with its slash */
+static std::string directory_of(const char *path)
+{
+    const char *slash = path ? strrchr(path, '/') : nullptr;
+    return slash ? std::string(path, slash + 1 - path) : std::string();
+}
+
+/* The key of the file at path in an IncludeCache */
+static std::string real_path(const std::string &path)
+{
+    char *real = realpath(path.c_str(), NULL);
+    std::string key = real ? real : path;
+    free(real);
+    return key;
+}
+
+std::shared_ptr<const ScannedFile> IncludeCache::get(const CompileContext *ctx, const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return nullptr;
+    std::string key = real_path(path);
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto found = m_files.find(key);
+        if (found != m_files.end() && found->second.size == st.st_size &&
+            found->second.mtime.tv_sec == st.st_mtim.tv_sec && found->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            m_reused++;
+            return found->second.file;
+        }
+    }
+
+    /* Scanned outside the lock; two compiles that miss at once both scan */
+    std::shared_ptr<ScannedFile> file(new ScannedFile);
+    file->name = path;
+    file->directory = directory_of(path.c_str());
+    FILE *input = fopen(path.c_str(), "r");
+    if (input == NULL)
+        return nullptr;
+    bool loaded = file->text.load_file(input);
+    fclose(input);
+    if (!loaded || file->text.get_length() > MAX_SOURCE_LENGTH || !scan_file(ctx, file.get(), 0, 1))
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_files[key] = Entry{st.st_mtim, st.st_size, file};
+    m_scanned++;
+    return file;
+}
+
+bool IncludeCache::get_includes(const std::string &path, const struct stat &st, std::vector<std::string> *names)
+{
+    std::string key = real_path(path);
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto found = m_files.find(key);
+    if (found == m_files.end() || found->second.size != st.st_size ||
+        found->second.mtime.tv_sec != st.st_mtim.tv_sec || found->second.mtime.tv_nsec != st.st_mtim.tv_nsec)
+        return false;
+    for (const Directive &directive : found->second.file->directives)
+        if (directive.kind == Directive::PP_INCLUDE)
+            names->push_back(std::string(directive.operand));
+    return true;
+}
+
+/* Add the operands of the #include lines of text to names, in comments
+ * as well, since telling would take a scan */
+static void find_includes(const char *text, size_t length, std::vector<std::string> *names)
+{
+    for (size_t p = 0; p < length; ) {
+        const char *newline = (const char *)memchr(text + p, '\n', length - p);
+        size_t eol = newline ? newline - text : length;
+        while (p < eol && is_blank(text[p]))
+            p++;
+        if (p < eol && text[p] == '#') {
+            Directive directive;
+            read_directive(text, p, eol, &directive);
+            if (directive.kind == Directive::PP_INCLUDE)
+                names->push_back(std::string(directive.operand));
+        }
+        p = eol + 1;
+    }
+}
+
+std::string include_stamps(const CompileContext *ctx)
+{
+    struct Pending
+    {
+        std::string path;
+        int depth;
+    };
+    std::string stamps;
+    std::vector<Pending> pending;
+    std::unordered_set<std::string> seen;
+
+    std::vector<std::string> names;
+    find_includes(ctx->sourceText, ctx->sourceLength, &names);
+    std::string directory = directory_of(ctx->sourceName);
+    for (size_t i = names.size(); i-- > 0; )
+        pending.push_back(Pending{names[i][0] == '/' ? names[i] : directory + names[i], 1});
+
+    while (!pending.empty()) {
+        Pending file = pending.back();
+        pending.pop_back();
+        /* Past the depth include stops at, a file is never read */
+        if (file.depth >= MAX_INCLUDE_DEPTH || !seen.insert(file.path).second)
+            continue;
+        struct stat st;
+        if (stat(file.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            stamps += file.path + " -\n";
+            continue;
+        }
+        stamps += file.path + " " + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec) +
+                  " " + std::to_string(st.st_size) + "\n";
+
+        names.clear();
+        if (!ctx->includeCache || !ctx->includeCache->get_includes(file.path, st, &names)) {
+            SourceBuffer text;
+            FILE *input = fopen(file.path.c_str(), "r");
+            if (input == NULL)
+                continue;
+            bool loaded = text.load_file(input);
+            fclose(input);
+            if (!loaded)
+                continue;
+            find_includes(text.get_data(), text.get_length(), &names);
+        }
+        directory = directory_of(file.path.c_str());
+        for (size_t i = names.size(); i-- > 0; )
+            pending.push_back(Pending{names[i][0] == '/' ? names[i] : directory + names[i], file.depth + 1});
+    }
+    return stamps;
+}
+
+/***********************************************************************
+ * Carrying out the directives
+ **********************************************************************/
+Preprocessor::Preprocessor(CompileContext *ctx) : m_ctx(ctx), m_state(new PreprocessState)
+{
+}
+
+Preprocessor::~Preprocessor()
+{
+    delete m_state;
+}
+
+void Preprocessor::run(size_t offset, int line)
+{
+    PreprocessState *state = m_state;
+    ScannedFile *source = state->source.get();
+    source->directory = directory_of(m_ctx->sourceName);
+    state->next_base = (uint32_t)m_ctx->sourceLength + 1;
+    if (!source->text.load_text(m_ctx->sourceText, m_ctx->sourceLength) ||
+        !scan_file(m_ctx, source, offset, line)) {
+        m_state->errors.push_back(PendingError{"PREPROCESSOR", Diagnostic{Diagnostic::LEXICAL, line, 1,
+                                                                          "Unable to scan the source", ""}});
+        m_state->tokens.push_back(PreToken{ERROR_ITEM, line, 0, {}, {(uint32_t)offset, (uint32_t)offset}});
+        return;
+    }
+    expand(source, 0, 0);
+}
+
+/* Add an error at item of file, which starts at base, and end the tokens there */
+bool Preprocessor::fail(const ScannedFile *file, uint32_t base, size_t item, const char *heading,
+                        const std::string &message)
+{
+    const PreToken &at = file->items[item];
+    SourceSpan location = {at.location.begin + base, at.location.end + base};
+    Diagnostic diagnostic = {Diagnostic::LEXICAL, at.line, m_ctx->lines->locate(location).get_first_col(),
+                             message, file->name};
+    if (at.token == ERROR_ITEM) {
+        heading = "LEXICAL";
+        diagnostic = file->errors[at.index];
+        diagnostic.file = file->name;
+    }
+    m_state->tokens.push_back(PreToken{ERROR_ITEM, at.line, m_state->errors.size(), {}, location});
+    m_state->errors.push_back(PendingError{heading, diagnostic});
+    return false;
+}
+
+/* Add the tokens of file, which starts at base, carrying out its
+ * directives. False once an error ends the tokens. */
+bool Preprocessor::expand(const ScannedFile *file, uint32_t base, int depth)
+{
+    PreprocessState *state = m_state;
+    struct Conditional
+    {
+        size_t item;        /* Of its #ifdef or #ifndef */
+        bool outer;         /* The conditionals around it take their text */
+        bool taking;
+        bool in_else;
+    };
+    std::vector<Conditional> conditionals;
+
+    const std::vector<PreToken> &items = file->items;
+    for (size_t i = 0; i < items.size(); i++) {
+        const PreToken &item = items[i];
+        bool skipping = !conditionals.empty() && !conditionals.back().taking;
+        if (item.token == 0)
+            break;
+        if (item.token == ERROR_ITEM) {
+            if (skipping)
+                continue;
+            return fail(file, base, i, "LEXICAL", "");
+        }
+        if (item.token != DIRECTIVE_ITEM) {
+            if (!skipping)
+                expand_token(file, i, SourceSpan{item.location.begin + base, item.location.end + base}, item.line);
+            continue;
+        }
+
+        const Directive &directive = file->directives[item.index];
+        size_t directive_item = i;
+        i += directive.items;
+        if (skipping && directive.kind != Directive::PP_IFDEF && directive.kind != Directive::PP_IFNDEF &&
+            directive.kind != Directive::PP_ELSE && directive.kind != Directive::PP_ENDIF)
+            continue;
+        if (directive.kind == Directive::PP_BAD)
+            return fail(file, base, directive_item, "PREPROCESSOR", directive.message);
+        if (directive.kind != Directive::PP_DEFINE && directive.items > 0 && !skipping) {
+            if (items[directive_item + 1].token == ERROR_ITEM)
+                return fail(file, base, directive_item + 1, "LEXICAL", "");
+            return fail(file, base, directive_item, "PREPROCESSOR",
+                        std::string("Extra text after ") + directive_names[directive.kind]);
+        }
+
+        switch (directive.kind) {
+            case Directive::PP_IFDEF:
+            case Directive::PP_IFNDEF: {
+                bool defined = state->macros.count(directive.operand) > 0;
+                conditionals.push_back(Conditional{directive_item, !skipping,
+                                                   !skipping && defined == (directive.kind == Directive::PP_IFDEF),
+                                                   false});
+                break;
+            }
+            case Directive::PP_ELSE:
+                if (conditionals.empty())
+                    return fail(file, base, directive_item, "PREPROCESSOR", "#else without #ifdef");
+                if (conditionals.back().in_else)
+                    return fail(file, base, directive_item, "PREPROCESSOR", "#else after #else");
+                conditionals.back().taking = conditionals.back().outer && !conditionals.back().taking;
+                conditionals.back().in_else = true;
+                break;
+            case Directive::PP_ENDIF:
+                if (conditionals.empty())
+                    return fail(file, base, directive_item, "PREPROCESSOR", "#endif without #ifdef");
+                conditionals.pop_back();
+                break;
+            case Directive::PP_DEFINE:
+                for (size_t j = directive_item + 1; j <= i; j++)
+                    if (items[j].token == ERROR_ITEM)
+                        return fail(file, base, j, "LEXICAL", "");
+                state->macros[directive.operand] = PreprocessState::Macro{file, directive_item + 1, directive.items};
+                break;
+            case Directive::PP_UNDEF:
+                state->macros.erase(directive.operand);
+                break;
+            case Directive::PP_INCLUDE:
+                if (!include(file, directive_item, depth))
+                    return false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!conditionals.empty()) {
+        const Directive &directive = file->directives[items[conditionals.back().item].index];
+        return fail(file, base, conditionals.back().item, "PREPROCESSOR",
+                    std::string("Unterminated ") + directive_names[directive.kind]);
+    }
+    if (depth == 0) {
+        PreToken end = items.back();
+        end.location = SourceSpan{end.location.begin + base, end.location.end + base};
+        state->tokens.push_back(end);
+    }
+    return true;
+}
+
+/* Add the token at item of file, or the tokens of the macro it names,
+ * at location */
+void Preprocessor::expand_token(const ScannedFile *file, size_t item, SourceSpan location, int line)
+{
+    PreprocessState *state = m_state;
+    const PreToken &token = file->items[item];
+    if (token.token == ID && !state->macros.empty()) {
+        std::string_view name(token.value.as_id.text, token.value.as_id.length);
+        auto found = state->macros.find(name);
+        if (found != state->macros.end() &&
+            std::find(state->expanding.begin(), state->expanding.end(), name) == state->expanding.end()) {
+            PreprocessState::Macro macro = found->second;
+            state->expanding.push_back(name);
+            for (size_t i = macro.first; i < macro.first + macro.count; i++)
+                expand_token(macro.file, i, location, line);
+            state->expanding.pop_back();
+            return;
+        }
+    }
+
+    state->tokens.push_back(token);
+    state->tokens.back().location = location;
+    state->tokens.back().line = line;
+}
+
+/* Carry out the #include at item of file */
+bool Preprocessor::include(const ScannedFile *file, size_t item, int depth)
+{
+    PreprocessState *state = m_state;
+    uint32_t base = file == state->source.get() ? 0 : state->bases[file];
+    const Directive &directive = file->directives[file->items[item].index];
+    std::string path(directive.operand);
+    if (path[0] != '/')
+        path = file->directory + path;
+    if (depth + 1 >= MAX_INCLUDE_DEPTH)
+        return fail(file, base, item, "PREPROCESSOR", "#include nested too deeply");
+
+    IncludeCache *cache = m_ctx->includeCache ? m_ctx->includeCache : &state->own_cache;
+    std::shared_ptr<const ScannedFile> included = cache->get(m_ctx, path);
+    if (!included)
+        return fail(file, base, item, "PREPROCESSOR", "Unable to open file " + path);
+
+    /* A file keeps its offsets however often it is included */
+    auto found = state->bases.find(included.get());
+    uint32_t included_base;
+    if (found != state->bases.end())
+        included_base = found->second;
+    else {
+        size_t length = included->text.get_length();
+        if (length + 1 > MAX_SOURCE_LENGTH - state->next_base)
+            return fail(file, base, item, "PREPROCESSOR", "The source is too large");
+        included_base = state->next_base;
+        state->next_base += (uint32_t)length + 1;
+        state->bases[included.get()] = included_base;
+        state->included.push_back(included);
+        m_ctx->lines->add_file(included->name.c_str(), included->text.get_data(), length, included_base);
+    }
+    return expand(included.get(), included_base, depth + 1);
+}
+
+/***********************************************************************
+ * The parser's side
+ **********************************************************************/
+int Preprocessor::next(YYSTYPE *value, SourceSpan *location)
+{
+    PreprocessState *state = m_state;
+    PreToken &token = state->tokens[state->next];
+    *location = token.location;
+    m_ctx->yyline = token.line;
+    if (token.token == ERROR_ITEM) {
+        const PendingError &error = state->errors[token.index];
+        const Diagnostic &diagnostic = error.diagnostic;
+        if (m_ctx->errorFile && !diagnostic.file.empty())
+            fprintf(m_ctx->errorFile, "\n%s ERROR, LINE %d OF %s: %s\n", error.heading, diagnostic.line,
+                    diagnostic.file.c_str(), diagnostic.message.c_str());
+        else if (m_ctx->errorFile)
+            fprintf(m_ctx->errorFile, "\n%s ERROR, LINE %d: %s\n", error.heading, diagnostic.line,
+                    diagnostic.message.c_str());
+        m_ctx->add_diagnostic(diagnostic.phase, diagnostic.line, diagnostic.column, diagnostic.message,
+                              diagnostic.file.empty() ? nullptr : diagnostic.file.c_str());
+        token.token = 0;    /* Reported once, the end from then on */
+        return 0;
+    }
+    if (token.token == 0)
+        return 0;
+
+    /* Values are only set by the tokens that carry one, as the scanner does */
+    switch (token.token) {
+        case ID: case FUNC_NAME: case INT: case FLOAT: case BOOL:
+        case INT_TYPE: case BOOL_TYPE: case FLOAT_TYPE:
+            *value = token.value;
+            break;
+    }
+    /* Files are scanned with pools of their own */
+    if (token.token == ID)
+        value->as_id.symbol = m_ctx->identifiers->intern(std::string_view(value->as_id.text, value->as_id.length));
+    state->next++;
+    return token.token;
+}
@@ -0,0 +1,115 @@
+/***********************************************************************
+ * preprocess.h
+ *
+ * Preprocessor for sources that share snippets: #include "file" (or
+ * <file>), object-like #define and #undef, and #ifdef, #ifndef, #else
+ * and #endif. A directive is a line whose first character other than a
+ * blank is '#'.
+ *
+ * It works on tokens. Each file is scanned once, with its directive
+ * lines blanked out, into a list of its tokens with the directives in
+ * place among them. The directives are then carried out over the lists,
+ * giving the tokens the parser reads instead of the scanner's. A file's
+ * list does not depend on what includes it, so an IncludeCache keeps the
+ * lists of included files, by path and modification time, for every
+ * source of a batch to share.
+ *
+ * Locations still point into the files the tokens are in. The tokens
+ * of an included file are given offsets past the end of the source, a
+ * range for each file, which ctx->lines tells apart (see location.h).
+ * The tokens a macro stands for take the place, and the location, of
+ * its name.
+ *
+ * Errors, the scanner's as well as those of directives, are reported
+ * when the parser reaches them, as they would be without directives. A
+ * source with no '#' in it is not preprocessed at all.
+ **********************************************************************/
+
+#ifndef PREPROCESS_H_
+#define PREPROCESS_H_ 1
+
+#include <time.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "context.h"
+#include "location.h"
+
+union YYSTYPE;
+struct ScannedFile;
+struct PreprocessState;
+struct stat;
+
+/* Whether length bytes of text may hold directives */
+bool has_directives(const char *text, size_t length);
+
+/* "path mtime size" of each file that ctx->sourceText can include, a
+ * line each, and "path -" for one that can not be read; for cache keys.
+ * Every #include line counts, even one an #ifdef or a comment leaves
+ * out, and so do those of the files it names. Those files are read for
+ * their #include lines but not scanned, or taken from ctx->includeCache
+ * when it holds them unchanged. */
+std::string include_stamps(const CompileContext *ctx);
+
+/* Scanned included files, shared by the compiles of a batch. Safe to
+ * use from several threads at once. */
+class IncludeCache
+{
+  private:
+    struct Entry
+    {
+        struct timespec mtime;
+        off_t size;
+        std::shared_ptr<const ScannedFile> file;
+    };
+
+    std::mutex m_lock;
+    std::unordered_map<std::string, Entry> m_files;    /* By real path */
+    long m_scanned = 0;
+    long m_reused  = 0;
+
+  public:
+    /* The file at path, scanned unless it is cached from a file of the
+     * same modification time and size. Tokens are traced as ctx says.
+     * NULL if it can not be read. */
+    std::shared_ptr<const ScannedFile> get(const CompileContext *ctx, const std::string &path);
+
+    /* Add the operands of the #include directives of the file at path,
+     * whose stat is st, to names; false unless it is cached unchanged */
+    bool get_includes(const std::string &path, const struct stat &st, std::vector<std::string> *names);
+
+    long get_scanned() const {return m_scanned;}
+    long get_reused() const {return m_reused;}
+};
+
+class Preprocessor
+{
+  private:
+    CompileContext *m_ctx;
+    PreprocessState *m_state;
+
+    bool expand(const ScannedFile *file, uint32_t base, int depth);
+    void expand_token(const ScannedFile *file, size_t item, SourceSpan location, int line);
+    bool include(const ScannedFile *file, size_t item, int depth);
+    bool fail(const ScannedFile *file, uint32_t base, size_t item, const char *heading, const std::string &message);
+
+  public:
+    explicit Preprocessor(CompileContext *ctx);
+    ~Preprocessor();
+    Preprocessor(const Preprocessor &) = delete;
+    Preprocessor &operator=(const Preprocessor &) = delete;
+
+    /* Preprocess ctx->sourceText from offset on, which is on the given
+     * line and outside any comment, with the files it includes. These
+     * come from ctx->includeCache, or are scanned for this compile alone
+     * without one, and are added to ctx->lines. */
+    void run(size_t offset = 0, int line = 1);
+
+    /* The next token as yylex would return it, its name interned into
+     * ctx->identifiers and ctx->yyline set to its line */
+    int next(union YYSTYPE *value, SourceSpan *location);
+};
+
+#endif /* PREPROCESS_H_ */
@@ -0,0 +1,143 @@
+"""Check the preprocessor (#include, #define, #ifdef).
+
+The sources of this directory and errors/ have to give the output in
+their .out files. phong.frag, Demo2 split into a header and macros, has
+to give the program Demos/Demo2/phong.frag does. Then every source that
+compiles cleanly among the code_gen_test and Demos sources, a few
+shaders from bench/shadergen.py and any further files given, gets
+several seeded rewrites: a run of its lines moved into a header behind
+an include guard, a number replaced by a macro and a block of junk
+under an #ifdef that is never true. Each rewrite has to give the
+program of the source.
+
+usage: python3 check.py [--compiler PATH] [--runs N] [--seed S]
+                        [source ...]
+"""
+
+import argparse
+import glob
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+here = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(here, "..", "bench"))
+import shadergen
+
+NUMBER = re.compile(r"(?<![\w.])\d+\.\d+(?![\w.])")
+
+
+def compile_source(compiler, source):
+    """Return (stdout, stderr) of compiling source in its directory."""
+    result = subprocess.run([compiler, "-X", os.path.basename(source)],
+                            cwd=os.path.dirname(os.path.abspath(source)),
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE,
+                            universal_newlines=True, errors="replace")
+    return result.stdout, result.stderr
+
+
+def strip_comments(text):
+    """Return text with its comments blanked, lines kept"""
+    return re.sub(r"/\*.*?\*/", lambda m: "\n" * m.group(0).count("\n"),
+                  text, flags=re.S)
+
+
+def rewrite(rng, text):
+    """Return (main, header) of text with directives in"""
+    lines = (text if text.endswith("\n") else text + "\n").splitlines(True)
+    begin = rng.randrange(len(lines) + 1)
+    end = rng.randrange(begin, len(lines) + 1)
+    header = "#ifndef PART_H\n#define PART_H\n" + "".join(lines[begin:end]) + "\n#endif\n"
+    lines[begin:end] = ['#include "part.h"\n', '#include "part.h"\n']
+
+    junk = rng.randrange(len(lines) + 1)
+    lines[junk:junk] = ["#ifdef NEVER_DEFINED\n", "} int ; 99999 @\n", "#endif\n"]
+
+    main = "".join(lines)
+    numbers = NUMBER.findall(main + header)
+    if numbers:
+        number = rng.choice(numbers)
+        replace = lambda part: NUMBER.sub(lambda m: "NUMBER" if m.group(0) == number else m.group(0), part)
+        main = "#define NUMBER %s\n" % number + replace(main)
+        header = replace(header)
+    return main, header
+
+
+def check_outputs(compiler):
+    """Return the number of sources here whose output is not their .out"""
+    failure_count = 0
+    for source in sorted(glob.glob(os.path.join(here, "*.frag")) +
+                         glob.glob(os.path.join(here, "errors", "*.frag"))):
+        if not os.path.exists(source + ".out"):
+            continue
+        with open(source + ".out") as f:
+            recorded = f.read()
+        result = subprocess.run([compiler, "-X", os.path.basename(source)],
+                                cwd=os.path.dirname(source),
+                                stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                                stderr=subprocess.STDOUT,
+                                universal_newlines=True, errors="replace")
+        if result.stdout != recorded:
+            print("Output differs on {}".format(source))
+            failure_count += 1
+    return failure_count
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler",
+                        default=os.path.join(here, "..", "compiler467"))
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("paths", nargs="*")
+    args = parser.parse_args()
+    compiler = os.path.abspath(args.compiler)
+
+    failure_count = check_outputs(compiler)
+    if compile_source(compiler, os.path.join(here, "phong.frag")) != \
+       compile_source(compiler, os.path.join(here, "..", "Demos", "Demo2", "phong.frag")):
+        print("phong.frag differs from Demo2")
+        failure_count += 1
+
+    with tempfile.TemporaryDirectory() as directory:
+        sources = sorted(glob.glob(os.path.join(here, "..", "code_gen_test", "*.c")) +
+                         glob.glob(os.path.join(here, "..", "Demos", "*", "*.frag")))
+        for blocks in (1, 10, 100):
+            path = os.path.join(directory, "shader%d.frag" % blocks)
+            with open(path, "w") as f:
+                f.write(shadergen.shader(blocks))
+            sources.append(path)
+
+        rng = random.Random(args.seed)
+        tested = 0
+        source_path = os.path.join(directory, "source.frag")
+        main_path = os.path.join(directory, "main.frag")
+        for source in sources + args.paths:
+            with open(source, errors="replace") as f:
+                text = strip_comments(f.read())
+            with open(source_path, "w") as f:
+                f.write(text)
+            expected = compile_source(compiler, source_path)
+            if expected[1] or "Failed to compile" in expected[0]:
+                continue
+            tested += 1
+            for run in range(args.runs):
+                main_text, header = rewrite(rng, text)
+                with open(main_path, "w") as f:
+                    f.write(main_text)
+                with open(os.path.join(directory, "part.h"), "w") as f:
+                    f.write(header)
+                if compile_source(compiler, main_path) != expected:
+                    print("Rewrite {} of {} differs".format(run, source))
+                    failure_count += 1
+
+    print("{} sources rewritten, {} differences".format(tested, failure_count))
+    sys.exit(1 if failure_count else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,7 @@
+{ int x = 1; /*
+#define A
+*/ 
+#ifdef A
+ x = 2;
+#endif
+}
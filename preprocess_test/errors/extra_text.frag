@@ -0,0 +1,3 @@
+{
+#endif junk
+}
@@ -0,0 +1,3 @@
+{
+#include "nothere.h"
+}
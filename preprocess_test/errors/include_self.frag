@@ -0,0 +1 @@
+#include "include_self.frag"
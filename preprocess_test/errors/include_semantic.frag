@@ -0,0 +1,4 @@
+{
+#include "types.h"
+  int q = true;
+}
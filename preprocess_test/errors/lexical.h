@@ -0,0 +1,4 @@
+#ifdef NOPE
+int x = 99999;
+#endif
+int y = 99999;
@@ -0,0 +1,3 @@
+{
+#define F(x) x
+}
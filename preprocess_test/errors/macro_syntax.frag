@@ -0,0 +1,4 @@
+{
+#define A 1 +
+ int x = A;
+}
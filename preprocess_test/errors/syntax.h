@@ -0,0 +1 @@
+int = 3;
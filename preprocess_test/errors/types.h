@@ -0,0 +1,2 @@
+/* errors */
+bool b = 1;
@@ -0,0 +1,7 @@
+/* Normalise eyeNorm in place */
+#ifndef EYE_H
+#define EYE_H
+eyeNorm[3] = dp3(eyeNorm,eyeNorm);
+eyeNorm[3] = rsq(eyeNorm[3]);
+eyeNorm = eyeNorm * eyeNorm[3];
+#endif
@@ -0,0 +1,3 @@
+{ vec4 eyeNorm;
+#include "sub/eye.h"
+}
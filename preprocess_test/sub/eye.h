@@ -0,0 +1 @@
+#include "eye2.h"
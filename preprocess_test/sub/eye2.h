@@ -0,0 +1 @@
+eyeNorm = eyeNorm;
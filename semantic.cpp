@@ -5,6 +5,9 @@
 #include "ast.h"
 #include "common.h"
 #include "parser.tab.h"
+#include "stats.h"
+#include "trace.h"
+#include <algorithm>
 #include <vector>
 #include <sstream>
 
@@ -15,42 +18,19 @@
 //     // va_start(vl, node_location);
 //     assert(node_location);
 //     buffer << "Missing declaration for symbol " << var->id.c_str();
-//                 buffer << *var->get_node_location();
+//                 buffer << error_handler->locate(var);
 
 // }
-int get_type_dimension (const std::string &type){
-    if (type == "bvec2" || type == "ivec2" || type == "vec2")
-        return 2;
-    else if (type == "vec3" || type == "ivec3" || type == "bvec3")
-        return 3;
-    else if (type == "ivec4" || type == "bvec4" || type == "vec4")
-        return 4;
-    else
-        return 1;
-}
-
-std::string get_base_type (const std::string type)
-{
-    if (type == "bvec2" || type == "bvec3" || type == "bvec4")
-        return "bool";
-    else if (type == "vec2" || type == "vec3" || type == "vec4")
-        return "float";
-    else if (type == "ivec2" || type == "ivec3" || type == "ivec4")
-        return "int";
-    else
-        return type;
-}
-
 class ErrorMessage
 {
     private:
         std::string error_message;
-        NodeLocation *error_location;
+        SourceSpan error_location;
     public:
-        ErrorMessage(const std::string &err_msg, NodeLocation *err_loc)
+        ErrorMessage(const std::string &err_msg, SourceSpan err_loc)
             : error_message(err_msg), error_location(err_loc) {}
         std::string get_error_message() const {return error_message;}
-        NodeLocation *get_error_location() const {return error_location;}
+        SourceSpan get_error_location() const {return error_location;}
 
 };
 
@@ -58,22 +38,76 @@ class ErrorHandler
 {
     private:
         std::vector<ErrorMessage *> m_error_list;
+        CompileContext *m_ctx;
+
+        /* Echo the offending source line with the location underlined */
+        void print_source_lines(FILE *errorFile, const NodeLocation &location)
+        {
+            int line = location.get_first_line();
+            const char *start;
+            int length;
+            if (!m_ctx->lines->get_line(location.get_file(), line, &start, &length))
+                return;
+
+            int first_col = location.get_first_col();
+            int last_col = location.get_last_line() == line ? location.get_last_col() : length + 1;
+            if (first_col < 1 || first_col > length + 1)
+                return;
+            if (last_col > length + 1)
+                last_col = length + 1;
+
+            /* Keep tabs in the caret line so it lines up under the source */
+            std::string marker;
+            for (int col = 1; col < first_col; col++)
+                marker += start[col - 1] == '\t' ? '\t' : ' ';
+            marker += '^';
+            for (int col = first_col + 1; col < last_col; col++)
+                marker += '~';
+
+            fprintf(errorFile, "%5d | %.*s\n", line, length, start);
+            fprintf(errorFile, "      | %s\n", marker.c_str());
+        }
+
     public:
-        bool load_source_file(); // We want to load the input file for meaningful message output
+        ErrorHandler(CompileContext *ctx) : m_ctx(ctx) {}
+
+        /* Lines and columns of node, for messages */
+        NodeLocation locate(const Node *node) {return m_ctx->lines->locate(node->get_span());}
+
         void print_out_errors(){
-            errorOccurred = ((int)m_error_list.size() > 0) ? 1 : 0;
+            FILE *errorFile = m_ctx->errorFile;
+            m_ctx->errorOccurred = ((int)m_error_list.size() > 0) ? 1 : 0;
             int error_num = 1;
             for (ErrorMessage *err_message : m_error_list)
             {
-                fprintf(errorFile, "------------------------------------------------------------------------------------------------\n");
-                fprintf(errorFile, "Error %d: %s\n", error_num, err_message->get_error_message().c_str());
-                fprintf(errorFile, "------------------------------------------------------------------------------------------------\n");
+                NodeLocation location = m_ctx->lines->locate(err_message->get_error_location());
+                m_ctx->add_diagnostic(Diagnostic::SEMANTIC,
+                                      location.get_first_line(),
+                                      location.get_first_col(),
+                                      err_message->get_error_message(),
+                                      location.get_file());
+                if (errorFile)
+                {
+                    fprintf(errorFile, "------------------------------------------------------------------------------------------------\n");
+                    fprintf(errorFile, "Error %d: %s\n", error_num, err_message->get_error_message().c_str());
+                    print_source_lines(errorFile, location);
+                    fprintf(errorFile, "------------------------------------------------------------------------------------------------\n");
+                }
                 error_num++;
             }
 
         }
         void push_back_error_message(ErrorMessage *err_message) {m_error_list.push_back(err_message);}
 
+        /* Move the errors found so far to the end of errors */
+        void take_errors(std::vector<SemanticError> *errors) {
+            for (ErrorMessage *err_message : m_error_list) {
+                errors->push_back({err_message->get_error_message(), err_message->get_error_location()});
+                delete err_message;
+            }
+            m_error_list.clear();
+        }
+
     public:
         ~ErrorHandler() {
             for (ErrorMessage *err_msg : m_error_list)
@@ -81,7 +115,7 @@ class ErrorHandler
         }
 };
 
-class SymbolVisitor : public Visitor
+class SymbolVisitor : public TreeWalker<SymbolVisitor>
 {
     private:
         SymbolTablex m_symbol_table;
@@ -90,66 +124,68 @@ class SymbolVisitor : public Visitor
 
     public:
         SymbolVisitor(ErrorHandler *err_handler) : error_handler(err_handler) {}
+        using TreeWalker<SymbolVisitor>::enter;
+        using TreeWalker<SymbolVisitor>::leave;
+
+        /* Start inside the outermost scope, with its first count declarations made */
+        void enter_outermost_scope(const NodeList<Declaration *> &declarations, size_t count)
+        {
+            m_symbol_table.enter_scope();
+            for (size_t i = 0; i < count; i++)
+                m_symbol_table.create_symbol(declarations[i]);
+        }
 
     public:
-        virtual void visit(Scope *scope)
+        bool enter(Scope *scope)
         {
             m_symbol_table.enter_scope();
-            scope->declarations->visit(*this);
-            scope->statements->visit(*this);
+            return true;
+        }
+        void leave(Scope *scope)
+        {
             m_symbol_table.exit_scope();
         }
 
-        virtual void visit(Declaration *decl)
+        /* After the initial value, which cannot see the declaration */
+        void leave(Declaration *decl)
         {
-            decl->type->visit(*this);
-            if (decl->initial_val != nullptr)
-            {
-                decl->initial_val->visit(*this);
-            }
-
             Declaration *temp = m_symbol_table.create_symbol(decl);
             if (temp)
             {
-                assert(temp->get_node_location());
-                assert(decl->get_node_location());
                 buffer << "Redeclaration of symbol " << temp->id;
-                buffer << " " << *decl->get_node_location(); /* Node location should all be set for declarations */
-                buffer << ". The original Declaration is " << *temp->get_node_location();
-                ErrorMessage *err_msg = new ErrorMessage(buffer.str(), temp->get_node_location());
+                buffer << " " << error_handler->locate(decl); /* Node location should all be set for declarations */
+                buffer << ". The original Declaration is " << error_handler->locate(temp);
+                ErrorMessage *err_msg = new ErrorMessage(buffer.str(), temp->get_span());
                 error_handler->push_back_error_message(err_msg);
                 buffer.str(""); // Clear out the buffer
-                decl->type = new Type("ANY_TYPE");
+                decl->set_is_redeclared(true);
             }
         }
 
-        virtual void visit(IdentifierNode *var)
+        void leave(IdentifierNode *var)
         {
-            Declaration *declaration = m_symbol_table.find_symbol(var->id);
+            Declaration *declaration = m_symbol_table.find_symbol(var->symbol);
             if (declaration == nullptr){
-                assert(var->get_node_location());
                 buffer << "Missing declaration for symbol " << var->id;
-                buffer << " " << *var->get_node_location();
-                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), var->get_node_location()));
+                buffer << " " << error_handler->locate(var);
+                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), var->get_span()));
                 buffer.str(""); // Clear out the buffer;
-                var->set_id_type(new Type("ANY_TYPE"));
             }
             else {
                 var->set_declaration(declaration);
             }
         }
 
-        virtual void visit(VectorVariable *vec_var)
+        void leave(VectorVariable *vec_var)
         {
-            Declaration *declaration = m_symbol_table.find_symbol(vec_var->id);
+            Declaration *declaration = m_symbol_table.find_symbol(vec_var->symbol);
 
             if (declaration == nullptr){
-                assert(vec_var->get_node_location());
                 buffer << "Missing declaration for symbol " << vec_var->id;
-                buffer << " " << *vec_var->get_node_location();
-                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), vec_var->get_node_location()));
+                buffer << " " << error_handler->locate(vec_var);
+                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), vec_var->get_span()));
                 buffer.str("");
-                vec_var->set_id_type(new Type("ANY_TYPE"));
+                vec_var->set_id_type(TypeDesc());
             }
             else {
                 vec_var->set_declaration(declaration);
@@ -157,64 +193,62 @@ class SymbolVisitor : public Visitor
         }
 };
 
-class PostOrderVisitor : public Visitor
+class PostOrderVisitor : public TreeWalker<PostOrderVisitor>
 {
     /* Add a class member to track all of the semantic errors */
     private:
         int if_else_scope_counter = 0;
-        ExpressionVisitor expression_visitor;
         std::stringstream buffer;
         ErrorHandler *error_handler = nullptr;
 
     public:
         PostOrderVisitor(ErrorHandler *err_handler) : error_handler(err_handler) {}
-        void push_message_into_handler(const std::string &message, NodeLocation *node_location) {
-            assert(node_location);
+        using TreeWalker<PostOrderVisitor>::enter;
+        using TreeWalker<PostOrderVisitor>::leave;
+        void push_message_into_handler(const std::string &message, Node *node) {
             buffer << message;
-            buffer << *node_location;
-            error_handler->push_back_error_message(new ErrorMessage(buffer.str(), node_location));
+            buffer << error_handler->locate(node);
+            error_handler->push_back_error_message(new ErrorMessage(buffer.str(), node->get_span()));
             buffer.str("");
         }
 
     public:
 
-        virtual void visit(Declaration *decl){
-            if (decl->type == nullptr || decl->type->type_name == "ANY_TYPE") /* Any type means an error in symbol table anslysis, and we return it */
-                return;
+        bool enter(Declaration *decl){
+            if (decl->get_type().is_any()) /* Any type means an error in symbol table anslysis, and we return it */
+                return false;
 
             if (decl->initial_val == nullptr)  /* We don't need to check for no initalized declarations */
-                return;
+                return false;
 
-            /* First do a type inference */
-            decl->initial_val->visit(*this);
+            return true;    /* First do a type inference of the initial value */
+        }
 
-            if (decl->initial_val->get_expression_type() == "ANY_TYPE")
+        void leave(Declaration *decl){
+            if (decl->initial_val->get_expression_type().is_any())
                 return;
             
-            if (decl->type->type_name != decl->initial_val->get_expression_type()) /* Declaration type mismatch */
+            if (decl->get_type() != decl->initial_val->get_expression_type()) /* Declaration type mismatch */
             {
-                std::string message  = "Type mismatch for this declaration, the LHS variable " + decl->id +
-                                        " expected a " + decl->type->type_name + " type but got a " + decl->initial_val->get_expression_type() + " type\n\t ";
-                push_message_into_handler(message, decl->get_node_location());
+                std::string message  = "Type mismatch for this declaration, the LHS variable " + std::string(decl->id) +
+                                        " expected a " + decl->get_type().get_name() + " type but got a " + decl->initial_val->get_expression_type().get_name() + " type\n\t ";
+                push_message_into_handler(message, decl);
                 /* decl->type->type_name = "ANY_TYPE"; */ /* Since an error occurred, let's set it to error type .. */
             }
 
-            /* Then we want to get its correspondent expression type */
-            decl->initial_val->visit(expression_visitor);
-
-            /* We achieve that by using a visitor which only stops at the immediate next level */
-            int expression_instance_type = expression_visitor.get_expression_instance_type();
+            /* Then we want to get its correspondent expression class */
+            NodeTag initial_tag = decl->initial_val->get_tag();
             if (decl->get_is_const()) {
                 bool is_valid = false;
                 /* Literal initialization */
-                if (expression_instance_type == FLOAT_LITERAL || expression_instance_type == BOOL_EXPRESSION ||
-                    expression_instance_type == INT_LITERAL)
+                if (initial_tag == FLOAT_LITERAL_TAG || initial_tag == BOOL_LITERAL_TAG ||
+                    initial_tag == INT_LITERAL_TAG)
                     is_valid = true;
 
                 /* Uniform variable */
-                else if (expression_instance_type == VARIABLE)
+                else if (initial_tag == VARIABLE_EXPRESSION_TAG)
                 {
-                    VariableExpression *ve = reinterpret_cast<VariableExpression*>(decl->initial_val); /* It is safe since we already know the expression type */
+                    VariableExpression *ve = static_cast<VariableExpression*>(decl->initial_val); /* It is safe since we already know the expression class */
                     Declaration *variable_decl = ve->id_node->get_declaration();
                     if (variable_decl->get_is_read_only() && variable_decl->get_is_const())
                         is_valid = true;
@@ -222,7 +256,7 @@ class PostOrderVisitor : public Visitor
                         is_valid = false;
                 }
 
-                else if (expression_instance_type ==  CONSTRUCTOR_EXPRESSION)
+                else if (initial_tag == CONSTRUCTOR_EXPRESSION_TAG)
                 {
                     if (!decl->initial_val->get_is_const())
                         is_valid = false;
@@ -232,45 +266,39 @@ class PostOrderVisitor : public Visitor
 
                 /* Push error messages into handler */
                 if(!is_valid) {
-                    std::string message = "const qualified variable " + decl->id + " must be initalized with a literal value or"
+                    std::string message = "const qualified variable " + std::string(decl->id) + " must be initalized with a literal value or"
                                           " a uniform variable, or a const constructor expression ";
-                    push_message_into_handler(message, decl->get_node_location());
+                    push_message_into_handler(message, decl);
                 }
             }
         }
 
-        virtual void visit(VectorVariable *vv){
-            if (vv->get_id_type() == nullptr || vv->get_id_type()->type_name == "ANY_TYPE")
+        void leave(VectorVariable *vv){
+            TypeDesc type = vv->get_id_type();
+            if (type.is_any())
                 return; /* We already reported errors on symbol table creation */
-            std::string type_name = vv->get_id_type()->type_name;
 
-            int vec_dimension = get_type_dimension(type_name) - 1; /* array index is always one less than dimension */
+            int vec_dimension = type.get_dimension() - 1; /* array index is always one less than dimension */
 
             if (vv->vector_index > vec_dimension || vv->vector_index < 0) {
-                /* Asserted here, since location must be set */
-                assert(vv->get_node_location());
-                assert(vv->get_declaration()->get_node_location());
-
                 /* Push error messages into handler */
                 buffer << "vector index out of bounds (vector: " << vv->id << ", index: " << vv->vector_index << ", bound: 0-" << vec_dimension << ")";
-                buffer << " " << *vv->get_node_location();
-                buffer << "\n\t " << "The declaration of the vector " << vv->id << " is " << *vv->get_declaration()->get_node_location();
-                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), vv->get_node_location()));
+                buffer << " " << error_handler->locate(vv);
+                buffer << "\n\t " << "The declaration of the vector " << vv->id << " is " << error_handler->locate(vv->get_declaration());
+                error_handler->push_back_error_message(new ErrorMessage(buffer.str(), vv->get_span()));
                 buffer.str("");
 
-                vv->set_id_type(new Type("ANY_TYPE")); /* Since it is not valid, it is ok.. to leak a little i guess :) */
+                vv->set_id_type(TypeDesc());
                 return;
             }
-            std::string base_type = get_base_type(type_name);
-            vv->set_id_type(new Type(base_type)); /* Set the vector variable's type into base type */
+            vv->set_id_type(type.get_element_type()); /* Set the vector variable's type into base type */
         }
 
-        virtual void visit(ConstructorExpression *ce){
-            ce->constructor->visit(*this);
-            std::string type = ce->constructor->type->type_name;
-            std::string base_type = get_base_type (ce->constructor->type->type_name);
-            std::vector<Expression *> expression_list = ce->constructor->args->get_expression_list();
-            int type_dimension = get_type_dimension (type);
+        void leave(ConstructorExpression *ce){
+            TypeDesc type = ce->constructor->type->desc;
+            TypeDesc base_type = type.get_element_type();
+            const NodeList<Expression *> &expression_list = ce->constructor->args->get_expression_list();
+            int type_dimension = type.get_dimension();
             int num_of_expressions = (int)expression_list.size();
 
             bool is_const_constructor = true;
@@ -279,18 +307,17 @@ class PostOrderVisitor : public Visitor
                 /* Push error messages into handler */
                 std::string message = "Error: number of arguments (" + std::to_string(num_of_expressions) + ")"
                                       " doesn't match type dimension (" + std::to_string(type_dimension) + ") ";
-                push_message_into_handler(message, ce->get_node_location());
+                push_message_into_handler(message, ce);
                 return; /* We might want to have early returns, as, we don't want to report too many errors ?\n */
             }
             // check type
             for (Expression *expr : expression_list){
-                std::string arg_type = expr->get_expression_type();
-                if (arg_type == "ANY_TYPE")
+                TypeDesc arg_type = expr->get_expression_type();
+                if (arg_type.is_any())
                     return;     /* We directly return because we saw an error */
                 if (arg_type != base_type){
-                    assert(expr->get_node_location());
-                    buffer << "argument type (" << arg_type << ")  and constructor type (" << base_type << ") mismatch ";
-                    buffer << " " << *expr->get_node_location() << "\n\t ";
+                    buffer << "argument type (" << arg_type.get_name() << ")  and constructor type (" << base_type.get_name() << ") mismatch ";
+                    buffer << " " << error_handler->locate(expr) << "\n\t ";
                 }
                 if (!expr->get_is_const())
                     is_const_constructor = false;
@@ -299,7 +326,7 @@ class PostOrderVisitor : public Visitor
             /* Push error messages into handler */
             if (buffer.str() != "") {
                 std::string message = "The Constructor Expression is ";
-                push_message_into_handler(message, ce->get_node_location());
+                push_message_into_handler(message, ce);
                 return;
             }
             if (is_const_constructor) /* This means constructor itself is a constant constructor expression */
@@ -307,105 +334,100 @@ class PostOrderVisitor : public Visitor
             ce->set_expression_type(type);
         }
 
-        virtual void visit(FunctionExpression *fe){
-            fe->function->visit(*this);
-
-            std::string function_name = fe->function->function_name;
-            std::vector<Expression *> args = fe->function->arguments->get_expression_list();
+        void leave(FunctionExpression *fe){
+            std::string_view function_name = fe->function->function_name;
+            const NodeList<Expression *> &args = fe->function->arguments->get_expression_list();
 
             int args_size = (int)args.size();
 
             if (function_name == "rsq"){
                 if (args_size != 1){
                     std::string message = "rsq function has " + std::to_string(args_size) + " argument (only 1 allowed) ";
-                    push_message_into_handler(message, fe->get_node_location());
+                    push_message_into_handler(message, fe);
                     return;
                 }
-                std::string type = args[0]->get_expression_type();
-                if (!(type == "int" || type == "float")){
-                    std::string message = "rsq function has " + type + " type as argument (only int/float allowed) ";
-                    push_message_into_handler(message, fe->get_node_location());
+                TypeDesc type = args[0]->get_expression_type();
+                if (!(type == TypeDesc(TypeDesc::INT_BASE, 1) || type == TypeDesc(TypeDesc::FLOAT_BASE, 1))){
+                    std::string message = "rsq function has " + type.get_name() + " type as argument (only int/float allowed) ";
+                    push_message_into_handler(message, fe);
                     return;
                 }
 
-                fe->set_expression_type("float");
+                fe->set_expression_type(TypeDesc(TypeDesc::FLOAT_BASE, 1));
             }
             if (function_name == "dp3"){
                 if (args_size != 2){
                     std::string message = "dp3 function has " + std::to_string(args_size) + " argument (only 2 allowed)";
-                    push_message_into_handler(message, fe->get_node_location());
+                    push_message_into_handler(message, fe);
                     return;
                 }
-                std::string type_1 = args[0]->get_expression_type();
-                std::string type_2 = args[1]->get_expression_type();
-                if (!  ((type_1 == "vec3" && type_2 == "vec3") ||
-                        (type_1 == "vec4" && type_2 == "vec4") ||
-                        (type_1 == "ivec3" && type_2 == "ivec3") ||
-                        (type_1 == "ivec4" && type_2 == "ivec4")))
+                TypeDesc type_1 = args[0]->get_expression_type();
+                TypeDesc type_2 = args[1]->get_expression_type();
+                /* vec3, vec4, ivec3 or ivec4, the same for both */
+                if (!  (type_1 == type_2 && type_1.get_dimension() >= 3 &&
+                        (type_1.get_base() == TypeDesc::FLOAT_BASE || type_1.get_base() == TypeDesc::INT_BASE)))
                 {
-                    std::string message =  "dp3 function has " + type_1 + ", " + type_2 + " type as arguments (both args must be vec3/vec4/ivec3/ivec4) ";
-                    push_message_into_handler(message, fe->get_node_location());
+                    std::string message =  "dp3 function has " + type_1.get_name() + ", " + type_2.get_name() + " type as arguments (both args must be vec3/vec4/ivec3/ivec4) ";
+                    push_message_into_handler(message, fe);
                     return;
                 }
-                fe->set_expression_type("float");
+                fe->set_expression_type(TypeDesc(TypeDesc::FLOAT_BASE, 1));
             }
             if (function_name == "lit"){
                 if (args_size != 1){
                     std::string message = "lit function has " + std::to_string(args_size) +  "argument (only 1 allowed) ";
-                    push_message_into_handler(message, fe->get_node_location());
+                    push_message_into_handler(message, fe);
                     return;
                 }
                 for(int i=0; i<(int)args.size(); i++){
-                    std::string type = args[i]->get_expression_type();
-                    if (type != "vec4"){
-                        std::string message = "lit function has " + type + " type as argument (only vec4 allowed) ";
-                        push_message_into_handler(message, fe->get_node_location());
+                    TypeDesc type = args[i]->get_expression_type();
+                    if (type != TypeDesc(TypeDesc::FLOAT_BASE, 4)){
+                        std::string message = "lit function has " + type.get_name() + " type as argument (only vec4 allowed) ";
+                        push_message_into_handler(message, fe);
                         return;
                     }
                 }
-                fe->set_expression_type("vec4");
+                fe->set_expression_type(TypeDesc(TypeDesc::FLOAT_BASE, 4));
             }
         }
 
-        virtual void visit(FloatLiteralExpression *fle){
-            fle->set_expression_type("float");
+        void leave(FloatLiteralExpression *fle){
+            fle->set_expression_type(TypeDesc(TypeDesc::FLOAT_BASE, 1));
         }
-        virtual void visit(BoolLiteralExpression *ble){
-            ble->set_expression_type("bool");
+        void leave(BoolLiteralExpression *ble){
+            ble->set_expression_type(TypeDesc(TypeDesc::BOOL_BASE, 1));
         }
 
-        virtual void visit(IntLiteralExpression *ile){
-            ile->set_expression_type("int");
+        void leave(IntLiteralExpression *ile){
+            ile->set_expression_type(TypeDesc(TypeDesc::INT_BASE, 1));
         }
 
-        virtual void visit(UnaryExpression *ue){
+        void leave(UnaryExpression *ue){
             /* Set types accordingly */
-            ue->right_expression->visit(*this);
-
-            std::string type = ue->right_expression->get_expression_type();
-            if (type == "ANY_TYPE") /* We reported earlier for any type errors */
+            TypeDesc type = ue->right_expression->get_expression_type();
+            if (type.is_any()) /* We reported earlier for any type errors */
                 return;
 
             /* Do Operator checking */
             int operator_type = ue->operator_type;
-            std::string base_type = get_base_type(type);
+            TypeDesc::Base base_type = type.get_base();
             std::string message;
             switch (operator_type) {
                 case NOT:
                 {
-                    if (base_type !=  "bool") {
+                    if (base_type != TypeDesc::BOOL_BASE) {
                         message = "Logical operators only work for boolean types ";
-                        push_message_into_handler(message, ue->get_node_location());
-                        type = "ANY_TYPE";
+                        push_message_into_handler(message, ue);
+                        type = TypeDesc();
                     }
                     break;
                 }
                 case MINUS:
                 {
-                    if (base_type == "bool") {
+                    if (base_type == TypeDesc::BOOL_BASE) {
                         message = "Arithmatic operators only work for operator types";
-                        push_message_into_handler(message, ue->get_node_location());
-                        type = "ANY_TYPE";
+                        push_message_into_handler(message, ue);
+                        type = TypeDesc();
                     }
                     break;
                 }
@@ -414,51 +436,49 @@ class PostOrderVisitor : public Visitor
         }
 
 
-        virtual void visit(BinaryExpression *be){
-            be->left_expression->visit(*this);
-            be->right_expression->visit(*this);
-
-            std::string lhs_expr_type = be->left_expression->get_expression_type();
-            std::string rhs_expr_type = be->right_expression->get_expression_type();
+        void leave(BinaryExpression *be){
+            TypeDesc lhs_expr_type = be->left_expression->get_expression_type();
+            TypeDesc rhs_expr_type = be->right_expression->get_expression_type();
             std::string message;
 
 
             /* goes back to the caller, with any type as default */
-            if (lhs_expr_type == "ANY_TYPE" || rhs_expr_type == "ANY_TYPE")
+            if (lhs_expr_type.is_any() || rhs_expr_type.is_any())
                 return;
 
-            std::string lhs_base_type = get_base_type(lhs_expr_type);
-            std::string rhs_base_type = get_base_type(rhs_expr_type);
+            TypeDesc::Base lhs_base_type = lhs_expr_type.get_base();
+            TypeDesc::Base rhs_base_type = rhs_expr_type.get_base();
             if (lhs_base_type != rhs_base_type){
-                std::string message = "Both operands of a binary operator must have exactly same base type, LHS base type is " + lhs_base_type +
-                                     " and RHS base type is " + rhs_base_type + " ";
-                push_message_into_handler(message, be->get_node_location());
+                std::string message = "Both operands of a binary operator must have exactly same base type, LHS base type is " +
+                                      lhs_expr_type.get_element_type().get_name() + " and RHS base type is " +
+                                      rhs_expr_type.get_element_type().get_name() + " ";
+                push_message_into_handler(message, be);
                 return;
             }
 
             int operator_type = be->operator_type;
-            int lhs_vec_dimen = get_type_dimension(lhs_expr_type);
-            int rhs_vec_dimen = get_type_dimension(rhs_expr_type);
+            int lhs_vec_dimen = lhs_expr_type.get_dimension();
+            int rhs_vec_dimen = rhs_expr_type.get_dimension();
 
             /* Declare flag variables here which will be used in the follwoing */
-            bool is_arithmetic = (lhs_base_type !="bool" && rhs_base_type !="bool");
+            bool is_arithmetic = (lhs_base_type != TypeDesc::BOOL_BASE && rhs_base_type != TypeDesc::BOOL_BASE);
             bool is_logical = !is_arithmetic;
             bool matching_dimen = lhs_vec_dimen == rhs_vec_dimen;
             bool is_lhs_scalar = lhs_vec_dimen == 1;
             bool is_rhs_scalar = rhs_vec_dimen == 1;
 
             /* ret_type to capture result */
-            std::string ret_type = "ANY_TYPE";
+            TypeDesc ret_type;
 
             if (operator_type == AND || operator_type == OR){ /* Early returns */
                 if (is_arithmetic)  {
                     message = " Logical operators only work for boolean types";
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                 }
                 if (!matching_dimen) {
                     message = "The expression dimension mismatches, one(lhs) is" + std::to_string(lhs_vec_dimen) + ",  and the other is " + std::to_string(rhs_vec_dimen);
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                 }
                 ret_type = lhs_expr_type; /* Either left or right expression is a match */
@@ -468,7 +488,7 @@ class PostOrderVisitor : public Visitor
 
             if (is_logical) {
                 message = "Arithmetic operators only work for arithmetic types ";
-                push_message_into_handler(message, be->get_node_location());
+                push_message_into_handler(message, be);
                 return;
             }
 
@@ -476,7 +496,7 @@ class PostOrderVisitor : public Visitor
             if (operator_type == PLUS || operator_type == MINUS) {
                 if (!matching_dimen) {
                     message = "The expression dimension mismatches, one(lhs) is " + std::to_string(lhs_vec_dimen) + ",  and the other is " + std::to_string(rhs_vec_dimen) + " ";
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                 }
                 ret_type = lhs_expr_type; /* LHS DIM = RHS DIM and both scalars and vectors work */
@@ -492,7 +512,7 @@ class PostOrderVisitor : public Visitor
                 else { /* vv => v */
                     if (!matching_dimen) {
                         message = "The expression dimension mismatches, one(lhs) is " + std::to_string(lhs_vec_dimen) + ",  and the other is " + std::to_string(rhs_vec_dimen) + " ";
-                        push_message_into_handler(message, be->get_node_location());
+                        push_message_into_handler(message, be);
                         return;
                     }
                     ret_type = lhs_expr_type; /* Both lhs and rhs works */
@@ -502,7 +522,7 @@ class PostOrderVisitor : public Visitor
             else if (operator_type == CARET || operator_type == DIVIDE) {
                 if (!is_lhs_scalar || !is_rhs_scalar) {
                     message = "Divide and Caret operator only works on scalars ";
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                }
                 ret_type = lhs_expr_type;
@@ -514,67 +534,60 @@ class PostOrderVisitor : public Visitor
                 if (!is_lhs_scalar || !is_rhs_scalar) {
 
                     message= "<, <=, >, >= operators only works on scalars ";
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                }
 
-                ret_type = "bool";
+                ret_type = TypeDesc(TypeDesc::BOOL_BASE, 1);
             }
 
             else if (operator_type == DOUBLE_EQ || operator_type == N_EQ)
             {
                 if (!matching_dimen) {
                     message = "The expression dimension mismatches, one(lhs) is " + std::to_string(lhs_vec_dimen) + ",  and the other is " + std::to_string(rhs_vec_dimen) + " ";
-                    push_message_into_handler(message, be->get_node_location());
+                    push_message_into_handler(message, be);
                     return;
                 }
-                ret_type = "bool";
+                ret_type = TypeDesc(TypeDesc::BOOL_BASE, 1);
             }
 
             else {
                 message = "Unknown binary operator type ";
-                push_message_into_handler(message, be->get_node_location());
+                push_message_into_handler(message, be);
                 return;
             }
 
             be->set_expression_type(ret_type);
         }
 
-        virtual void visit(VariableExpression *ve){
-            ve->id_node->visit(*this);
-
+        void leave(VariableExpression *ve){
             Declaration *declaration = ve->id_node->get_declaration();
 
             if (declaration && declaration->get_is_write_only()) {
-                std::string message = "Variable " + declaration->id + " has Result type class and is write only ";
+                std::string message = "Variable " + std::string(declaration->id) + " has Result type class and is write only ";
                 /* Push error messages into handler */
-                push_message_into_handler(message, ve->get_node_location());
+                push_message_into_handler(message, ve);
                 return;
             }
 
-            Type *variable_type = ve->id_node->get_id_type(); /* Note: due to the nature of parser, id_node exists by default */
-            if (variable_type != nullptr){
-                ve->set_expression_type(variable_type->type_name);
+            if (ve->id_node->has_id_type()){ /* Note: due to the nature of parser, id_node exists by default */
+                ve->set_expression_type(ve->id_node->get_id_type());
                 if (declaration && declaration->get_is_const ()) /* We only handle the trivial case for variable, whether the declaration is const or not */
                    ve->set_is_const(true);
             }
         }
 
-        virtual void visit(AssignStatement *assign_stmt){
-            /* Visit the members to set the inference types */
-            assign_stmt->variable->visit(*this);
-            assign_stmt->expression->visit(*this);
-
-            std::string rhs_type = assign_stmt->expression->get_expression_type ();
-            Type *temp_type = assign_stmt->variable->get_id_type();
-            std::string lhs_type =  temp_type ? temp_type->type_name : "ANY_TYPE";
+        /* The members are visited first to set the inference types */
+        void leave(AssignStatement *assign_stmt){
+            TypeDesc rhs_type = assign_stmt->expression->get_expression_type ();
+            TypeDesc lhs_type = assign_stmt->variable->get_id_type();
 
-            if (rhs_type == "ANY_TYPE" || lhs_type == "ANY_TYPE")
+            if (rhs_type.is_any() || lhs_type.is_any())
                 return;
 
             if (rhs_type != lhs_type) {
-                std::string message = "Can not assign a different type expression to a variable, Expected: " + lhs_type + " But got: " + rhs_type + " ";
-                push_message_into_handler(message, assign_stmt->get_node_location());
+                std::string message = "Can not assign a different type expression to a variable, Expected: " + lhs_type.get_name() + " But got: " + rhs_type.get_name() + " ";
+                push_message_into_handler(message, assign_stmt);
                 return;
             }
 
@@ -584,45 +597,41 @@ class PostOrderVisitor : public Visitor
                 if (variable_declaration) {
                     std::string message;
                     if (variable_declaration->get_is_const()) {
-                        if (variable_declaration->get_node_location()) {// Means it is a normal defined constant variable
-                            assert(assign_stmt->get_node_location());
+                        if (!variable_declaration->get_is_predefined()) {// Means it is a normal defined constant variable
                             buffer << "const qualified variable " << variable_declaration->id << " can not be re-assigned, ";
-                            buffer << "Its declaration is " << *variable_declaration->get_node_location() << "\n\t ";
-                            buffer << "The Assign Statament is " << *assign_stmt->get_node_location();
-                            error_handler->push_back_error_message(new ErrorMessage(buffer.str(), assign_stmt->get_node_location()));
+                            buffer << "Its declaration is " << error_handler->locate(variable_declaration) << "\n\t ";
+                            buffer << "The Assign Statament is " << error_handler->locate(assign_stmt);
+                            error_handler->push_back_error_message(new ErrorMessage(buffer.str(), assign_stmt->get_span()));
                             buffer.str("");
                             return;
                         }
                         else
-                            message = "Uniform type classes Variable " + assign_stmt->variable->id + " is const qualified, and can not be re-assigned ";
+                            message = "Uniform type classes Variable " + std::string(assign_stmt->variable->id) + " is const qualified, and can not be re-assigned ";
                     }
                     else if(variable_declaration->get_is_read_only())
-                        message = "Can not assign to a read only variable " + variable_declaration->id + " ";
+                        message = "Can not assign to a read only variable " + std::string(variable_declaration->id) + " ";
                     else if(if_else_scope_counter != 0 && variable_declaration->get_is_write_only())
-                        message = "Variable " + variable_declaration->id + " with Result type classes can not be assigned anywhere in the scope of an if or else statement ";
+                        message = "Variable " + std::string(variable_declaration->id) + " with Result type classes can not be assigned anywhere in the scope of an if or else statement ";
 
                     if (message != "")
-                        push_message_into_handler(message, assign_stmt->get_node_location());
+                        push_message_into_handler(message, assign_stmt);
                     return;
                 }
             }
         }
 
-        virtual void visit(IfStatement *if_statement) {
-            /* You perform type inference by visiting other ones first */
-            if_statement->expression->visit(*this);
+        /* The condition is counted in the if as well, it holds no assignment */
+        bool enter(IfStatement *if_statement) {
             if_else_scope_counter++;
-            if_statement->statement->visit(*this);
+            return true;
+        }
+
+        void leave(IfStatement *if_statement) {
             if_else_scope_counter--;
-            if (if_statement->else_statement){
-                if_else_scope_counter++;
-                if_statement->else_statement->visit(*this);
-                if_else_scope_counter--;
-            }
-            if (if_statement->expression->get_expression_type() != "bool")
+            if (if_statement->expression->get_expression_type() != TypeDesc(TypeDesc::BOOL_BASE, 1))
             {
                 std::string message = "Condition for if statement has to be a type of boolean ";
-                push_message_into_handler(message, if_statement->expression->get_node_location());
+                push_message_into_handler(message, if_statement->expression);
             }
 
         }
@@ -630,11 +639,16 @@ class PostOrderVisitor : public Visitor
 
 class PredefinedVariableVisitor : public Visitor
 {
-    public:
-        virtual void visit(Scope *scope){
-            scope->declarations->visit(*this); /* We only need to visit declarations to push content in */
+    private:
+        /* The predefined declarations never change, so they are built once per process
+         * and shared (read only) by every compile of a batch */
+        static const std::vector<Declaration *> &get_predefined_declarations()
+        {
+            static const std::vector<Declaration *> predefined_declarations = create_predefined_declarations();
+            return predefined_declarations;
         }
-        virtual void visit(Declarations *decls)
+
+        static std::vector<Declaration *> create_predefined_declarations()
         {
             /* We have the following predefined variables
             result vec4 gl_FragColor ;
@@ -651,18 +665,25 @@ class PredefinedVariableVisitor : public Visitor
             uniform vec4 env2;
             uniform vec4 env3;*/
 
+            /* Their ids are interned up front by every StringPool, see intern.h. They
+             * live in an arena of their own, as long as the process. */
+            static Arena arena;
+            auto declare = [](TypeDesc type, PredefinedName name, bool is_const) {
+                return new (&arena) Declaration(new (&arena) Type(type), predefined_names[name], name, nullptr, is_const);
+            };
+
             /* Result predefined variables */
-            Declaration *gl_FragColor = new Declaration(new Type("vec4"), "gl_FragColor", nullptr, false);
-            Declaration *gl_FragDepth = new Declaration(new Type("bool"), "gl_FragDepth", nullptr, false);
+            Declaration *gl_FragColor = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_FRAGCOLOR, false);
+            Declaration *gl_FragDepth = declare(TypeDesc(TypeDesc::BOOL_BASE, 1), PREDEFINED_GL_FRAGDEPTH, false);
             gl_FragColor->set_is_write_only(true); /* Result type classes are all write only */
             gl_FragDepth->set_is_write_only(true);
 
             /* Attribute Predefined variables */
-            Declaration *gl_FragCoord = new Declaration(new Type("vec4"), "gl_FragCoord", nullptr, false);
-            Declaration *gl_TexCoord = new Declaration(new Type("vec4"), "gl_TexCoord", nullptr, false);
-            Declaration *gl_Color = new Declaration(new Type("vec4"), "gl_Color", nullptr, false);
-            Declaration *gl_Secondary = new Declaration(new Type("vec4"), "gl_Secondary", nullptr, false);
-            Declaration *gl_FogFradCoord = new Declaration(new Type("vec4"), "gl_FogFradCoord", nullptr, false);
+            Declaration *gl_FragCoord = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_FRAGCOORD, false);
+            Declaration *gl_TexCoord = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_TEXCOORD, false);
+            Declaration *gl_Color = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_COLOR, false);
+            Declaration *gl_Secondary = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_SECONDARY, false);
+            Declaration *gl_FogFradCoord = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_FOGFRADCOORD, false);
             gl_FragCoord->set_is_read_only(true);
             gl_TexCoord->set_is_read_only(true);
             gl_Color->set_is_read_only(true);
@@ -671,12 +692,12 @@ class PredefinedVariableVisitor : public Visitor
 
 
             /* Uniform Predefined variables */
-            Declaration *gl_Light_Half = new Declaration(new Type("vec4"), "gl_Light_Half", nullptr, true);
-            Declaration *gl_Light_Ambient = new Declaration(new Type("vec4"), "gl_Light_Ambient", nullptr, true);
-            Declaration *gl_Material_Shininess = new Declaration(new Type("vec4"), "gl_Material_Shininess", nullptr, true);
-            Declaration *env1 = new Declaration(new Type("vec4"), "env1", nullptr, true);
-            Declaration *env2 = new Declaration(new Type("vec4"), "env2", nullptr, true);
-            Declaration *env3 = new Declaration(new Type("vec4"), "env3", nullptr, true);
+            Declaration *gl_Light_Half = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_LIGHT_HALF, true);
+            Declaration *gl_Light_Ambient = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_LIGHT_AMBIENT, true);
+            Declaration *gl_Material_Shininess = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_GL_MATERIAL_SHININESS, true);
+            Declaration *env1 = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_ENV1, true);
+            Declaration *env2 = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_ENV2, true);
+            Declaration *env3 = declare(TypeDesc(TypeDesc::FLOAT_BASE, 4), PREDEFINED_ENV3, true);
             gl_Light_Half->set_is_read_only(true);
             gl_Light_Ambient->set_is_read_only(true);
             gl_Material_Shininess->set_is_read_only(true);
@@ -684,42 +705,147 @@ class PredefinedVariableVisitor : public Visitor
             env2->set_is_read_only(true);
             env3->set_is_read_only(true);
 
+            std::vector<Declaration *> predefined_declarations = {gl_FragColor, gl_FragDepth, gl_FragCoord, gl_TexCoord,
+                                                                  gl_Color, gl_Secondary, gl_FogFradCoord, gl_Light_Half,
+                                                                  gl_Light_Ambient, gl_Material_Shininess, env1, env2, env3};
+            for (Declaration *decl : predefined_declarations)
+                decl->set_is_predefined(true); /* Owned by this table, not by the AST they are pushed into */
+            return predefined_declarations;
+        }
+
+    public:
+        virtual void visit(Scope *scope){
+            scope->declarations->visit(*this); /* We only need to visit declarations to push content in */
+        }
+        virtual void visit(Declarations *decls)
+        {
             /* We now push all of them into our ast node, in this case, it is the declarations */
-            decls->push_front_declaration(gl_FragColor);
-            decls->push_front_declaration(gl_FragDepth);
-            decls->push_front_declaration(gl_FragCoord);
-            decls->push_front_declaration(gl_TexCoord);
-            decls->push_front_declaration(gl_Color);
-            decls->push_front_declaration(gl_Secondary);
-            decls->push_front_declaration(gl_FogFradCoord);
-            decls->push_front_declaration(gl_Light_Half);
-            decls->push_front_declaration(gl_Light_Ambient);
-            decls->push_front_declaration(gl_Material_Shininess);
-            decls->push_front_declaration(env1);
-            decls->push_front_declaration(env2);
-            decls->push_front_declaration(env3);
+            for (Declaration *decl : get_predefined_declarations())
+                decls->push_front_declaration(decl);
         }
 };
 
 
-int semantic_check(node * ast)
+int semantic_check(CompileContext *ctx)
 {
-
+    TraceSpan span(ctx->traceLog, "semantic", "phase");
+    node *ast = ctx->ast;
     PredefinedVariableVisitor predefined_visitor;
-    ErrorHandler error_handler;
+    ErrorHandler error_handler(ctx);
     SymbolVisitor symbol_visitor(&error_handler);
     PostOrderVisitor postorder_visitor(&error_handler);
 
     /* This creates predefined variables, and load the source file into the scope */
-    ast->visit(predefined_visitor);
+    {
+        PhaseTimer timer(ctx->stats, PHASE_PREDEFINED);
+        TraceSpan span(ctx->traceLog, "PredefinedVariableVisitor", "visitor");
+        ast->visit(predefined_visitor);
+    }
 
     /* This performs construction of symbol table, and scope checking */
-    ast->visit(symbol_visitor);
+    {
+        PhaseTimer timer(ctx->stats, PHASE_SYMBOL);
+        TraceSpan span(ctx->traceLog, "SymbolVisitor", "visitor");
+        symbol_visitor.walk(ast);
+    }
 
     /* This performs type inference and Type checking */
-    ast->visit(postorder_visitor);
+    {
+        PhaseTimer timer(ctx->stats, PHASE_TYPECHECK);
+        TraceSpan span(ctx->traceLog, "PostOrderVisitor", "visitor");
+        postorder_visitor.walk(ast);
+    }
 
     /* This section prints out the errors collected overall, including line numbers */
+    TraceSpan report_span(ctx->traceLog, "report errors", "phase");
     error_handler.print_out_errors();
     return 0;
 }
+
+/* Undoes what checking left in a part and collects the names in it */
+class PartVisitor : public TreeWalker<PartVisitor>
+{
+    private:
+        std::vector<SymbolId> *m_symbols;
+
+        void clear(Expression *expression) {
+            expression->set_expression_type(TypeDesc());
+            expression->set_is_const(false);
+            expression->clear_result_register_name();
+        }
+
+    public:
+        PartVisitor(std::vector<SymbolId> *symbols) : m_symbols(symbols) {}
+        using TreeWalker<PartVisitor>::enter;
+
+        bool enter(Declaration *decl) {
+            decl->set_is_redeclared(false);
+            m_symbols->push_back(decl->symbol);
+            return true;
+        }
+        bool enter(IdentifierNode *var) {
+            var->set_declaration(nullptr);
+            m_symbols->push_back(var->symbol);
+            return true;
+        }
+        bool enter(VectorVariable *vec_var) {
+            vec_var->set_declaration(nullptr);
+            vec_var->clear_id_type();
+            m_symbols->push_back(vec_var->symbol);
+            return true;
+        }
+
+        bool enter(ConstructorExpression *ce) {clear(ce); return true;}
+        bool enter(FloatLiteralExpression *fle) {clear(fle); return true;}
+        bool enter(BoolLiteralExpression *ble) {clear(ble); return true;}
+        bool enter(IntLiteralExpression *ile) {clear(ile); return true;}
+        bool enter(UnaryExpression *ue) {clear(ue); return true;}
+        bool enter(BinaryExpression *be) {clear(be); return true;}
+        bool enter(VariableExpression *ve) {clear(ve); return true;}
+        bool enter(FunctionExpression *fe) {clear(fe); return true;}
+};
+
+void semantic_predefine(Scope *program)
+{
+    PredefinedVariableVisitor predefined_visitor;
+    program->visit(predefined_visitor);
+}
+
+void semantic_check_part(CompileContext *ctx, Scope *program, bool is_declaration, size_t index,
+                         PartCheck *check)
+{
+    const NodeList<Declaration *> &declarations = program->declarations->declaration_list;
+    Node *part = is_declaration ? (Node *)declarations[index]
+                                : (Node *)program->statements->get_statement_list()[index];
+
+    check->symbols.clear();
+    PartVisitor part_visitor(&check->symbols);
+    part_visitor.walk(part);
+    std::sort(check->symbols.begin(), check->symbols.end());
+    check->symbols.erase(std::unique(check->symbols.begin(), check->symbols.end()), check->symbols.end());
+
+    /* The outermost scope as the symbol table pass has it on reaching the part */
+    ErrorHandler error_handler(ctx);
+    SymbolVisitor symbol_visitor(&error_handler);
+    symbol_visitor.enter_outermost_scope(declarations, is_declaration ? index : declarations.size());
+    symbol_visitor.walk(part);
+    check->symbol_errors.clear();
+    error_handler.take_errors(&check->symbol_errors);
+
+    PostOrderVisitor postorder_visitor(&error_handler);
+    postorder_visitor.walk(part);
+    check->type_errors.clear();
+    error_handler.take_errors(&check->type_errors);
+}
+
+void semantic_report(CompileContext *ctx, const std::vector<const PartCheck *> &checks)
+{
+    ErrorHandler error_handler(ctx);
+    for (const PartCheck *check : checks)
+        for (const SemanticError &error : check->symbol_errors)
+            error_handler.push_back_error_message(new ErrorMessage(error.message, error.span));
+    for (const PartCheck *check : checks)
+        for (const SemanticError &error : check->type_errors)
+            error_handler.push_back_error_message(new ErrorMessage(error.message, error.span));
+    error_handler.print_out_errors();
+}
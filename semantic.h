@@ -1,8 +1,43 @@
 #ifndef SEMANTIC_H_
 #define SEMANTIC_H_ 1
+#include <string>
+#include <vector>
 #include "ast.h"
+#include "context.h"
 
-int semantic_check(node * ast);
+int semantic_check(CompileContext *ctx);
 
-#endif /* SEMANTIC_H_ */
+/***********************************************************************
+ * Checking one part of a program at a time, for CompileSession. The
+ * parts are the declarations and statements of the outermost scope.
+ * semantic_check reports the errors of the symbol table pass over every
+ * part, then the type errors of every part; semantic_report puts the
+ * errors of separately checked parts back in that order.
+ **********************************************************************/
+struct SemanticError {
+    std::string message;
+    SourceSpan span;
+};
+
+/* What checking one part found */
+struct PartCheck {
+    std::vector<SemanticError> symbol_errors;
+    std::vector<SemanticError> type_errors;
+    std::vector<SymbolId> symbols;    /* Declared or used in the part, sorted */
+};
+
+/* Add the predefined variables to the outermost scope of program, as
+ * semantic_check does first */
+void semantic_predefine(Scope *program);
 
+/* Check the index-th declaration, or statement, of program's outermost
+ * scope, with the declarations before it in scope. What an earlier
+ * check left in the part is cleared first. */
+void semantic_check_part(CompileContext *ctx, Scope *program, bool is_declaration, size_t index,
+                         PartCheck *check);
+
+/* Report the errors of checks, the parts in program order, as
+ * semantic_check would have */
+void semantic_report(CompileContext *ctx, const std::vector<const PartCheck *> &checks);
+
+#endif /* SEMANTIC_H_ */
@@ -0,0 +1,134 @@
+"""Check that compiling edits (-W) gives what compiling the result does.
+
+Each source, the tests under this directory and of code_gen_test, a few
+shaders from bench/shadergen.py and any further files given, gets
+several runs of random edits: statements and declarations copied from
+elsewhere in it, lines deleted, names changed, stray braces and comment
+openers. The program and the errors after the last edit have to be the
+ones a compile of the edited text from scratch gives. The edits are
+seeded, so a failure can be repeated.
+
+usage: python3 edits.py [--compiler PATH] [--runs N] [--edits N]
+                        [--seed S] [source ...]
+"""
+
+import argparse
+import glob
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+here = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(here, "..", "bench"))
+import shadergen
+
+NAMES = ["a", "b", "x", "tint", "gain", "coeff", "shade", "gl_FragColor",
+         "env1", "undeclared"]
+STATEMENTS = ["\n{ int a = 1; }", "\nfloat x = 2.0;", "\nx = x + 1.0;",
+              "\nif (true) { shade = tint; } else x = 1;", "\n;",
+              "\nvec4 tint = vec4(1.0, 2.0, 3.0, 4.0);", "\na = b;"]
+FRAGMENTS = ["{", "}", ";", " ", "\n", "/*", "*/", "int", "1", "+", "("]
+
+
+def random_edit(rng, text):
+    """Return (offset, removed, inserted) of one edit of text"""
+    kind = rng.choice([0, 0, 1, 2, 2, 3, 3, 4, 4, 5, 6])
+    if kind == 0:    # Copy a line from elsewhere
+        lines = text.splitlines(True)
+        offset = sum(len(line) for line in lines[:rng.randrange(len(lines) + 1)])
+        return offset, 0, rng.choice(lines) if lines else "\n"
+    if kind == 1:    # Delete a line
+        starts = [0] + [m.end() for m in re.finditer("\n", text)]
+        begin = rng.choice(starts)
+        end = text.find("\n", begin)
+        return begin, (len(text) if end < 0 else end + 1) - begin, ""
+    if kind == 2:    # Change a name
+        names = list(re.finditer(r"[A-Za-z_]\w*", text))
+        if names:
+            name = rng.choice(names)
+            return name.start(), name.end() - name.start(), rng.choice(NAMES)
+    if kind == 3:    # Change a number
+        numbers = list(re.finditer(r"\d+(\.\d*)?", text))
+        if numbers:
+            number = rng.choice(numbers)
+            return number.start(), number.end() - number.start(), \
+                str(rng.choice([0, 1, 2, 3, 4, 0.5, 2.5]))
+    if kind == 4:    # Insert a statement or declaration
+        ends = [m.end() for m in re.finditer("[;{}]", text)]
+        if ends:
+            return rng.choice(ends), 0, rng.choice(STATEMENTS)
+    if kind == 5:    # Insert a fragment
+        return rng.randrange(len(text) + 1), 0, rng.choice(FRAGMENTS)
+    offset = rng.randrange(len(text) + 1)    # Cut a little
+    return offset, rng.randrange(min(8, len(text) - offset) + 1), ""
+
+
+def run(compiler, options, source):
+    """Return (stdout, stderr) of one compile"""
+    result = subprocess.run([compiler, "-X"] + options + [source],
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, errors="replace",
+                            universal_newlines=True)
+    return result.stdout, result.stderr
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--compiler",
+                        default=os.path.join(here, "..", "compiler467"))
+    parser.add_argument("--runs", type=int, default=4)
+    parser.add_argument("--edits", type=int, default=6)
+    parser.add_argument("--seed", type=int, default=467)
+    parser.add_argument("paths", nargs="*")
+    args = parser.parse_args()
+
+    sources = sorted(glob.glob(os.path.join(here, "**", "*.c"), recursive=True))
+    sources += sorted(glob.glob(os.path.join(here, "..", "code_gen_test", "*.c")))
+    rng = random.Random(args.seed)
+    failure_count = 0
+    edit_count = 0
+    incremental = 0
+    with tempfile.TemporaryDirectory() as directory:
+        for blocks in (1, 10, 100):
+            path = os.path.join(directory, "shader%d.frag" % blocks)
+            with open(path, "w") as f:
+                f.write(shadergen.shader(blocks))
+            sources.append(path)
+
+        edited = os.path.join(directory, "edited")
+        edit_file = os.path.join(directory, "edits")
+        trace_file = os.path.join(directory, "trace")
+        for source in sources + args.paths:
+            with open(source, "r", encoding="latin-1", newline="") as f:
+                original = f.read()
+            for _ in range(args.runs):
+                text = original
+                with open(edit_file, "w", encoding="latin-1", newline="") as f:
+                    for _ in range(args.edits):
+                        offset, removed, inserted = random_edit(rng, text)
+                        f.write("%d %d %d\n%s" % (offset, removed, len(inserted), inserted))
+                        text = text[:offset] + inserted + text[offset + removed:]
+                with open(edited, "w", encoding="latin-1", newline="") as f:
+                    f.write(text)
+
+                expected = run(args.compiler, [], edited)
+                got = run(args.compiler, ["-W", edit_file, "-Tt", "-R", trace_file], source)
+                if got != expected:
+                    print("Edits of {} differ, seed {}".format(source, args.seed))
+                    failure_count += 1
+                with open(trace_file) as f:
+                    for line in f:
+                        if line.startswith("EDIT"):
+                            edit_count += 1
+                            incremental += "(all)" not in line
+
+    print("{} edits, {} parsed in part, {} differences".format(
+        edit_count, incremental, failure_count))
+    sys.exit(1 if failure_count else 0)
+
+
+if __name__ == "__main__":
+    main()
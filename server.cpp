@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <thread>
+#include "server.h"
+#include "cache.h"
+#include "preprocess.h"
+
+/* Largest source accepted, so a confused client can not exhaust memory */
+#define MAX_REQUEST_BYTES (64 * 1024 * 1024)
+
+static bool write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = read(fd, data, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static void put_u32(std::string *buffer, uint32_t value)
+{
+    buffer->append((const char *)&value, sizeof(value));
+}
+
+static bool read_u32(int fd, uint32_t *value)
+{
+    return read_all(fd, (char *)value, sizeof(*value));
+}
+
+static bool read_string(int fd, std::string *text)
+{
+    uint32_t length;
+    if (!read_u32(fd, &length) || length > MAX_REQUEST_BYTES)
+        return false;
+    text->resize(length);
+    return length == 0 || read_all(fd, &(*text)[0], length);
+}
+
+bool send_request(int fd, const char *source, size_t length)
+{
+    std::string buffer;
+    buffer.reserve(sizeof(uint32_t) + length);
+    put_u32(&buffer, (uint32_t)length);
+    buffer.append(source, length);
+    return write_all(fd, buffer.data(), buffer.size());
+}
+
+bool receive_request(int fd, std::string *source)
+{
+    return read_string(fd, source);
+}
+
+bool send_response(int fd, const CompileResult &result)
+{
+    /* Build the whole response first so it goes out in one write */
+    std::string buffer;
+    put_u32(&buffer, result.success ? 1 : 0);
+    put_u32(&buffer, (uint32_t)result.program.size());
+    buffer += result.program;
+    put_u32(&buffer, (uint32_t)result.diagnostics.size());
+    for (const Diagnostic &diagnostic : result.diagnostics) {
+        put_u32(&buffer, (uint32_t)diagnostic.phase);
+        put_u32(&buffer, (uint32_t)diagnostic.line);
+        put_u32(&buffer, (uint32_t)diagnostic.column);
+        put_u32(&buffer, (uint32_t)diagnostic.message.size());
+        buffer += diagnostic.message;
+        put_u32(&buffer, (uint32_t)diagnostic.file.size());
+        buffer += diagnostic.file;
+    }
+    return write_all(fd, buffer.data(), buffer.size());
+}
+
+bool receive_response(int fd, CompileResult *result)
+{
+    uint32_t success, count;
+    if (!read_u32(fd, &success) || !read_string(fd, &result->program) || !read_u32(fd, &count))
+        return false;
+    result->success = success != 0;
+    result->diagnostics.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t phase, line, column;
+        Diagnostic diagnostic;
+        if (!read_u32(fd, &phase) || !read_u32(fd, &line) || !read_u32(fd, &column) ||
+            !read_string(fd, &diagnostic.message) || !read_string(fd, &diagnostic.file))
+            return false;
+        diagnostic.phase = (Diagnostic::Phase)phase;
+        diagnostic.line = (int)line;
+        diagnostic.column = (int)column;
+        result->diagnostics.push_back(diagnostic);
+    }
+    return true;
+}
+
+static bool make_address(const char *socket_path, struct sockaddr_un *address)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path))
+        return false;
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+int connect_to_server(const char *socket_path)
+{
+    struct sockaddr_un address;
+    if (!make_address(socket_path, &address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void serve_connection(int fd, CompileCache *cache, IncludeCache *includes)
+{
+    std::string source;
+    while (receive_request(fd, &source)) {
+        CompileResult result = compile_shader(source.data(), source.size(), cache, includes);
+        if (!send_response(fd, result))
+            break;
+    }
+    close(fd);
+}
+
+int serve(const char *socket_path, CompileCache *cache, FILE *error_file)
+{
+    struct sockaddr_un address;
+    if (!make_address(socket_path, &address)) {
+        fprintf(error_file, "Socket path %s is too long\n", socket_path);
+        return 1;
+    }
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(error_file, "Unable to create socket: %s\n", strerror(errno));
+        return 1;
+    }
+    unlink(socket_path); /* A stale socket from an earlier server */
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0) {
+        fprintf(error_file, "Unable to listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+
+    /* A client that goes away mid response must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Warm up the builtin declarations and name map before the first
+     * request, so it is as fast as the rest */
+    static const char warm_up[] = "{ gl_FragColor = gl_Color; }";
+    compile_shader(warm_up, sizeof(warm_up) - 1);
+
+    /* Included files are read once and shared by every connection */
+    IncludeCache includes;
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(error_file, "Unable to accept a connection: %s\n", strerror(errno));
+            break;
+        }
+        std::thread(serve_connection, fd, cache, &includes).detach();
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    return 1;
+}
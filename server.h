@@ -0,0 +1,39 @@
+/***********************************************************************
+ * server.h
+ *
+ * Compile server. "compiler467 --serve socket" stays resident and
+ * answers compile requests over a Unix domain socket, so the builtin
+ * declarations, the name map, the compile cache and included files stay
+ * warm between requests. Included paths are relative to the server's
+ * working directory. Every connection is served by its own thread and may send
+ * any number of requests.
+ *
+ * Wire format, all integers 32 bit in host order (the socket is local):
+ *   request   length, source bytes
+ *   response  success, program length, program bytes, diagnostic count,
+ *             then per diagnostic: phase, line, column, message length,
+ *             message bytes, file length, file bytes
+ **********************************************************************/
+
+#ifndef SERVER_H_
+#define SERVER_H_ 1
+
+#include <string>
+#include "compile.h"
+
+class CompileCache;
+
+/* Serve until killed. Returns 1 if the socket can not be set up. */
+int serve(const char *socket_path, CompileCache *cache, FILE *error_file);
+
+/* Connect to a server, returns the socket or -1 */
+int connect_to_server(const char *socket_path);
+
+/* Framing, shared by the server and its clients. All return false once
+ * the peer has gone away. */
+bool send_request(int fd, const char *source, size_t length);
+bool receive_request(int fd, std::string *source);
+bool send_response(int fd, const CompileResult &result);
+bool receive_response(int fd, CompileResult *result);
+
+#endif /* SERVER_H_ */
@@ -0,0 +1,500 @@
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include "session.h"
+#include "ast.h"
+#include "arena.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "source.h"
+#include "intern.h"
+#include "location.h"
+#include "handparse.h"
+#include "preprocess.h"
+
+struct SessionState
+{
+    std::unique_ptr<SourceBuffer> source{new SourceBuffer};
+    LineTable lines{nullptr, 0};
+    StringPool identifiers;    /* Kept for the whole session, the AST holds its ids */
+    Scope *program = nullptr;  /* NULL until the source parses */
+
+    /* The tree, and the parts of it edits replaced, until the next whole
+     * compile; compiled_bytes of it were in use after the last one */
+    Arena arena;
+    size_t compiled_bytes = 0;
+
+    /* Of a source with directives, which is always compiled whole. Kept
+     * for the messages, which may show lines of the included files. */
+    std::unique_ptr<Preprocessor> preprocessor;
+
+    /* What checking each declaration and statement of the outermost
+     * scope found, in the order of the program's lists */
+    std::vector<PartCheck> declaration_checks;
+    std::vector<PartCheck> statement_checks;
+};
+
+/* A scope an edit lies within, and the states bison's stack holds
+ * below it */
+struct ScopeLevel
+{
+    Scope *scope;
+    int stack_depth;
+};
+
+/* Finds the scopes whose braces hold the bytes begin to end, outermost first */
+class ScopeFinder : public Visitor
+{
+    private:
+        size_t m_begin, m_end;
+        int m_stack_depth = 1;    /* Bison's first state */
+
+        bool holds(const Node *node) {
+            SourceSpan span = node->get_span();
+            return span.begin <= m_begin && m_end <= span.end;
+        }
+
+        /* Visit a statement that has states more of bison's stack below it */
+        void visit_at(Statement *statement, int states) {
+            m_stack_depth += states;
+            statement->visit(*this);
+            m_stack_depth -= states;
+        }
+
+    public:
+        std::vector<ScopeLevel> scopes;
+
+        ScopeFinder(size_t begin, size_t end) : m_begin(begin), m_end(end) {}
+
+        virtual void visit(Scope *scope) {
+            SourceSpan span = scope->get_span();
+            if (m_begin <= span.begin || m_end >= span.end)
+                return;
+            scopes.push_back({scope, m_stack_depth});
+            for (Statement *statement : scope->statements->get_statement_list())
+                if (holds(statement)) {
+                    visit_at(statement, STACK_BEFORE_STATEMENT);
+                    break;
+                }
+        }
+        virtual void visit(NestedScope *ns) {
+            ns->scope->visit(*this);
+        }
+        virtual void visit(IfStatement *if_statement) {
+            if (holds(if_statement->statement))
+                visit_at(if_statement->statement, STACK_BEFORE_IF_BODY);
+            else if (if_statement->else_statement && holds(if_statement->else_statement))
+                visit_at(if_statement->else_statement, STACK_BEFORE_ELSE_BODY);
+        }
+        virtual void visit(AssignStatement *as_stmt) {}
+};
+
+/* Moves the spans at or past from by delta, for the nodes an edit left
+ * in place, and points names at text that outlives the source they were
+ * parsed from */
+class RebaseVisitor : public TreeWalker<RebaseVisitor>
+{
+    private:
+        size_t m_from;
+        ptrdiff_t m_delta;
+        const StringPool *m_identifiers;
+
+        void move(Node *node) {
+            SourceSpan span = node->get_span();
+            if (span.begin >= m_from)
+                span.begin += m_delta;
+            if (span.end >= m_from)
+                span.end += m_delta;
+            node->set_span(span);
+        }
+
+    public:
+        RebaseVisitor(size_t from, ptrdiff_t delta, const StringPool *identifiers) :
+            m_from(from), m_delta(delta), m_identifiers(identifiers) {}
+
+        /* Every node but the lists */
+        template <class T> bool enter(T *node) {move(node); return true;}
+        bool enter(Declarations *decls) {return true;}
+        bool enter(Statements *stmts) {return true;}
+
+        bool enter(Declaration *decl) {
+            if (decl->get_is_predefined())
+                return false;
+            move(decl);
+            decl->id = m_identifiers->get_name(decl->symbol);
+            return true;
+        }
+
+        /* The scanner only knows these three */
+        bool enter(Function *func) {
+            static const char *const function_names[] = {"lit", "dp3", "rsq"};
+            move(func);
+            for (const char *name : function_names)
+                if (func->function_name == name)
+                    func->function_name = name;
+            return true;
+        }
+        bool enter(IdentifierNode *var) {
+            move(var);
+            var->id = m_identifiers->get_name(var->symbol);
+            return true;
+        }
+        bool enter(VectorVariable *vec_var) {
+            move(vec_var);
+            vec_var->id = m_identifiers->get_name(vec_var->symbol);
+            return true;
+        }
+};
+
+/* Whether the sorted a and b share an element */
+static bool intersects(const std::vector<SymbolId> &a, const std::vector<SymbolId> &b)
+{
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end()) {
+        if (*i < *j)
+            i++;
+        else if (*j < *i)
+            j++;
+        else
+            return true;
+    }
+    return false;
+}
+
+static bool has_errors(const PartCheck &check)
+{
+    return !check.symbol_errors.empty() || !check.type_errors.empty();
+}
+
+CompileSession::CompileSession(CompileContext *ctx) : m_ctx(ctx), m_state(new SessionState)
+{
+}
+
+CompileSession::~CompileSession()
+{
+    delete m_state;
+}
+
+const char *CompileSession::get_text() const
+{
+    return m_state->source->get_data();
+}
+
+size_t CompileSession::get_length() const
+{
+    return m_state->source->get_length();
+}
+
+/* Point ctx at the session's source for one call */
+void CompileSession::begin()
+{
+    m_ctx->errorOccurred = FALSE;
+    m_ctx->ast = NULL;
+    m_ctx->diagnostics.clear();
+    m_ctx->sourceText = m_state->source->get_data();
+    m_ctx->sourceLength = m_state->source->get_length();
+    m_state->lines.reset(m_ctx->sourceText, m_ctx->sourceLength);
+    m_ctx->lines = &m_state->lines;
+    m_ctx->identifiers = &m_state->identifiers;
+    m_ctx->arena = &m_state->arena;
+}
+
+void CompileSession::end()
+{
+    m_ctx->sourceText = nullptr;
+    m_ctx->sourceLength = 0;
+    m_ctx->lines = nullptr;
+    m_ctx->identifiers = nullptr;
+    m_ctx->arena = nullptr;
+}
+
+int CompileSession::compile(const char *text, size_t length)
+{
+    std::unique_ptr<SourceBuffer> source(new SourceBuffer);
+    if (length > MAX_SOURCE_LENGTH || !source->load_text(text, length)) {
+        if (m_ctx->errorFile)
+            fprintf(m_ctx->errorFile, "The source is too large\n");
+        return 1;
+    }
+    /* The old tree views the old text until it is released */
+    m_state->program = nullptr;
+    m_state->arena.reset();
+    m_state->source.swap(source);
+
+    begin();
+    int failed = compile_all();
+    end();
+    return failed;
+}
+
+int CompileSession::edit(size_t offset, size_t removed, const char *text, size_t length)
+{
+    const char *old_text = m_state->source->get_data();
+    size_t old_length = m_state->source->get_length();
+    offset = std::min(offset, old_length);
+    removed = std::min(removed, old_length - offset);
+    if (length > MAX_SOURCE_LENGTH - (old_length - removed)) {
+        if (m_ctx->errorFile)
+            fprintf(m_ctx->errorFile, "The source is too large\n");
+        return 1;
+    }
+
+    std::string edited;
+    edited.reserve(old_length - removed + length);
+    edited.append(old_text ? old_text : "", offset);
+    edited.append(text, length);
+    if (old_text)
+        edited.append(old_text + offset + removed, old_length - offset - removed);
+
+    /* Kept until the tree no longer views it */
+    std::unique_ptr<SourceBuffer> source(new SourceBuffer);
+    if (!source->load_text(edited.data(), edited.size())) {
+        if (m_ctx->errorFile)
+            fprintf(m_ctx->errorFile, "Unable to read the source\n");
+        return 1;
+    }
+    m_state->source.swap(source);
+
+    begin();
+    bool in_part = m_state->program && !m_state->preprocessor && !has_directives(m_ctx->sourceText, m_ctx->sourceLength) &&
+                   m_state->arena.get_used() <= 2 * m_state->compiled_bytes + Arena::FIRST_CHUNK_SIZE;
+    int failed = in_part && reparse(offset, removed, length) ? finish() : compile_all();
+    end();
+    return failed;
+}
+
+/* Parse and check the whole source */
+int CompileSession::compile_all()
+{
+    SessionState *state = m_state;
+    state->program = nullptr;
+    state->arena.reset();
+    state->declaration_checks.clear();
+    state->statement_checks.clear();
+    m_work = SessionWork();
+    m_work.reparsed_all = true;
+    m_work.parsed_bytes = m_ctx->sourceLength;
+
+    if (scanner_init(m_ctx)) {
+        if (m_ctx->errorFile)
+            fprintf(m_ctx->errorFile, "Unable to initialize the scanner\n");
+        return 1;
+    }
+    state->preprocessor.reset();
+    if (has_directives(m_ctx->sourceText, m_ctx->sourceLength)) {
+        state->preprocessor.reset(new Preprocessor(m_ctx));
+        state->preprocessor->run();
+        m_ctx->preprocessor = state->preprocessor.get();
+    }
+    int parsed = hand_parse(m_ctx);
+    m_ctx->preprocessor = nullptr;
+    scanner_seek(m_ctx, 0);    /* Put back the NUL flex leaves after the last token */
+    scanner_destroy(m_ctx);
+    /* The source goes with the next edit, the names stay */
+    state->identifiers.own_names();
+    state->compiled_bytes = state->arena.get_used();
+    if (parsed)
+        return 1;
+
+    state->program = (Scope *)m_ctx->ast;
+    m_ctx->ast = NULL;
+    RebaseVisitor rebase_visitor(0, 0, &state->identifiers);
+    rebase_visitor.walk(state->program);
+
+    semantic_predefine(state->program);
+    state->declaration_checks.resize(state->program->declarations->declaration_list.size());
+    state->statement_checks.resize(state->program->statements->get_statement_list().size());
+    for (size_t i = 0; i < state->declaration_checks.size(); i++)
+        semantic_check_part(m_ctx, state->program, true, i, &state->declaration_checks[i]);
+    for (size_t i = 0; i < state->statement_checks.size(); i++)
+        semantic_check_part(m_ctx, state->program, false, i, &state->statement_checks[i]);
+    m_work.parts = m_work.checked_parts = state->declaration_checks.size() + state->statement_checks.size();
+    return finish();
+}
+
+/***********************************************************************
+ * Parse the edit of removed bytes at offset into length new ones again,
+ * trying the innermost scope around it first. In a scope the
+ * declarations and statements that end before the edit and those that
+ * begin after it stay; the text between them is parsed in their place.
+ * That is only taken when it ends exactly where the first of the later
+ * ones begins, so scanning it did not run into them. Returns false if
+ * not even the outermost scope would do.
+ **********************************************************************/
+bool CompileSession::reparse(size_t offset, size_t removed, size_t length)
+{
+    SessionState *state = m_state;
+    m_work = SessionWork();
+    size_t edit_end = offset + removed;
+    ptrdiff_t delta = (ptrdiff_t)length - (ptrdiff_t)removed;
+
+    ScopeFinder finder(offset, edit_end);
+    state->program->visit(finder);
+    if (finder.scopes.empty() || scanner_init(m_ctx))
+        return false;
+
+    std::vector<Declaration *> declarations;
+    std::vector<Statement *> statements;
+    Scope *scope = nullptr;
+    size_t first_declaration = 0, declaration_count = 0;
+    size_t first_statement = 0, statement_count = 0;
+    for (size_t level = finder.scopes.size(); level-- > 0 && scope == nullptr; ) {
+        Scope *candidate = finder.scopes[level].scope;
+        const NodeList<Declaration *> &old_declarations = candidate->declarations->declaration_list;
+        const NodeList<Statement *> &old_statements = candidate->statements->get_statement_list();
+
+        /* The items of the scope, declarations then statements */
+        std::vector<Node *> items;
+        size_t predefined = 0;
+        for (Declaration *decl : old_declarations) {
+            if (decl->get_is_predefined())
+                predefined++;
+            else
+                items.push_back(decl);
+        }
+        size_t declaration_items = items.size();
+        items.insert(items.end(), old_statements.begin(), old_statements.end());
+
+        /* Touching counts as changed, the edit may join onto a token */
+        size_t before = 0;
+        while (before < items.size() && items[before]->get_span().end < offset)
+            before++;
+        size_t after = before;
+        while (after < items.size() && items[after]->get_span().begin <= edit_end)
+            after++;
+
+        SourceSpan scope_span = candidate->get_span();
+        size_t begin = before > 0 ? items[before - 1]->get_span().end : scope_span.begin + 1;
+        size_t end = (after < items.size() ? items[after]->get_span().begin : scope_span.end - 1) + delta;
+        bool declarations_allowed = before <= declaration_items;
+        bool statements_allowed = after >= declaration_items;
+
+        m_work.parsed_bytes += end - begin;
+        if (hand_parse_items(m_ctx, begin, end, finder.scopes[level].stack_depth,
+                             declarations_allowed, statements_allowed, &declarations, &statements))
+            continue;
+
+        scope = candidate;
+        first_declaration = predefined + std::min(before, declaration_items);
+        declaration_count = predefined + std::min(after, declaration_items) - first_declaration;
+        first_statement = std::max(before, declaration_items) - declaration_items;
+        statement_count = std::max(after, declaration_items) - declaration_items - first_statement;
+    }
+    scanner_destroy(m_ctx);
+    if (scope == nullptr)
+        return false;
+
+    /* What the outermost scope declared, and now declares, in the edit */
+    bool outermost = scope == state->program;
+    std::vector<SymbolId> changed;
+    if (outermost) {
+        for (size_t i = first_declaration; i < first_declaration + declaration_count; i++)
+            changed.push_back(scope->declarations->declaration_list[i]->symbol);
+        for (Declaration *decl : declarations)
+            changed.push_back(decl->symbol);
+        std::sort(changed.begin(), changed.end());
+    }
+
+    scope->declarations->replace_declarations(first_declaration, declaration_count, {});
+    scope->statements->replace_statements(first_statement, statement_count, {});
+    RebaseVisitor rebase_visitor(edit_end, delta, &state->identifiers);
+    rebase_visitor.walk(state->program);
+
+    state->identifiers.own_names();
+    RebaseVisitor names_visitor(0, 0, &state->identifiers);
+    for (Declaration *decl : declarations)
+        names_visitor.walk(decl);
+    for (Statement *statement : statements)
+        names_visitor.walk(statement);
+    scope->declarations->replace_declarations(first_declaration, 0, declarations);
+    scope->statements->replace_statements(first_statement, 0, statements);
+
+    /* Which parts of the outermost scope to check again */
+    std::vector<bool> declarations_affected, statements_affected;
+    if (outermost) {
+        auto &checks = state->declaration_checks;
+        checks.erase(checks.begin() + first_declaration, checks.begin() + first_declaration + declaration_count);
+        checks.insert(checks.begin() + first_declaration, declarations.size(), PartCheck());
+        declarations_affected.assign(checks.size(), false);
+        std::fill_n(declarations_affected.begin() + first_declaration, declarations.size(), true);
+
+        auto &statement_checks = state->statement_checks;
+        statement_checks.erase(statement_checks.begin() + first_statement,
+                               statement_checks.begin() + first_statement + statement_count);
+        statement_checks.insert(statement_checks.begin() + first_statement, statements.size(), PartCheck());
+        statements_affected.assign(statement_checks.size(), false);
+        std::fill_n(statements_affected.begin() + first_statement, statements.size(), true);
+    } else {
+        declarations_affected.assign(state->declaration_checks.size(), false);
+        statements_affected.assign(state->statement_checks.size(), false);
+    }
+
+    const NodeList<Declaration *> &root_declarations = state->program->declarations->declaration_list;
+    const NodeList<Statement *> &root_statements = state->program->statements->get_statement_list();
+    for (size_t i = 0; i < root_declarations.size(); i++) {
+        const PartCheck &check = state->declaration_checks[i];
+        if (intersects(check.symbols, changed) ||
+            (has_errors(check) && root_declarations[i]->get_span().begin >= offset))
+            declarations_affected[i] = true;
+    }
+    for (size_t i = 0; i < root_statements.size(); i++) {
+        const PartCheck &check = state->statement_checks[i];
+        SourceSpan span = root_statements[i]->get_span();
+        if (intersects(check.symbols, changed) || (has_errors(check) && span.begin >= offset) ||
+            (!outermost && span.begin <= offset && offset + length <= span.end))
+            statements_affected[i] = true;
+    }
+
+    m_work.reparsed_all = false;
+    m_work.checked_parts = 0;
+    m_work.parts = root_declarations.size() + root_statements.size();
+    for (size_t i = 0; i < root_declarations.size(); i++)
+        if (declarations_affected[i]) {
+            semantic_check_part(m_ctx, state->program, true, i, &state->declaration_checks[i]);
+            m_work.checked_parts++;
+        }
+    for (size_t i = 0; i < root_statements.size(); i++)
+        if (statements_affected[i]) {
+            semantic_check_part(m_ctx, state->program, false, i, &state->statement_checks[i]);
+            m_work.checked_parts++;
+        }
+    return true;
+}
+
+/* Report the errors of every part, and generate code if there were none */
+int CompileSession::finish()
+{
+    std::vector<const PartCheck *> checks;
+    for (const PartCheck &check : m_state->declaration_checks)
+        checks.push_back(&check);
+    for (const PartCheck &check : m_state->statement_checks)
+        checks.push_back(&check);
+    semantic_report(m_ctx, checks);
+
+    if (m_ctx->errorOccurred) {
+        if (m_ctx->outputFile)
+            fprintf(m_ctx->outputFile, "Failed to compile\n");
+        return 1;
+    }
+    m_ctx->ast = m_state->program;
+    genCode(m_ctx);
+    m_ctx->ast = NULL;
+    return 0;
+}
+
+ShaderSession::ShaderSession() : m_session(&m_ctx)
+{
+    m_ctx.outputText = &m_program;
+}
+
+CompileResult ShaderSession::result(int failed)
+{
+    CompileResult result;
+    result.success = failed == 0 && m_ctx.diagnostics.empty();
+    if (result.success)
+        result.program.swap(m_program);
+    m_program.clear();
+    result.diagnostics.swap(m_ctx.diagnostics);
+    return result;
+}
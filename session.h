@@ -0,0 +1,97 @@
+/***********************************************************************
+ * session.h
+ *
+ * Incremental compiles of a source that is edited between compiles, as
+ * in an editor. A CompileSession keeps the AST and the semantic check of
+ * the last compile. An edit scans and parses again only the smallest
+ * scope around the changed bytes, from the declaration or statement
+ * before them to the one after; the rest of the tree is kept and moved
+ * along by the change in length. Only the declarations and statements
+ * of the outermost scope the edit can affect are checked again: the one
+ * it is in, those that name what it declared or declares, and those
+ * with errors after it, whose messages give lines that may have moved.
+ * Code is still generated for the whole program.
+ *
+ * Whatever was edited, the result is what compileSource would give for
+ * the source as it stands. An edit that can not be parsed on its own,
+ * say one that opens a comment or unbalances the braces, compiles the
+ * whole source again, as does any edit of a source with directives (see
+ * preprocess.h). So does an edit once the parts edits replaced, which
+ * stay in the tree's arena, take up as much of it as the tree itself.
+ **********************************************************************/
+
+#ifndef SESSION_H_
+#define SESSION_H_ 1
+
+#include "context.h"
+#include "compile.h"
+
+struct SessionState;
+
+/* How much of the source the last compile or edit went over */
+struct SessionWork
+{
+    bool   reparsed_all  = false;   /* The whole source was parsed */
+    size_t parsed_bytes  = 0;
+    size_t checked_parts = 0;       /* Declarations and statements of the outermost scope */
+    size_t parts         = 0;
+};
+
+/* ctx is set up as for compileSource, less its input fields. Each call
+ * reports as one compile would: its errors and program go to ctx's
+ * sinks, and ctx->diagnostics holds the errors of that call only. The
+ * session always uses the hand written parser. */
+class CompileSession
+{
+  private:
+    CompileContext *m_ctx;
+    SessionState *m_state;
+    SessionWork m_work;
+
+    void begin();
+    void end();
+    int compile_all();
+    bool reparse(size_t offset, size_t removed, size_t length);
+    int finish();
+
+  public:
+    explicit CompileSession(CompileContext *ctx);
+    ~CompileSession();
+    CompileSession(const CompileSession &) = delete;
+    CompileSession &operator=(const CompileSession &) = delete;
+
+    /* Compile length bytes of text from scratch. Returns 0 when the
+     * program compiled, 1 otherwise. */
+    int compile(const char *text, size_t length);
+
+    /* Replace the removed bytes at offset of the source with length
+     * bytes of text, and compile the result. Returns what compile does. */
+    int edit(size_t offset, size_t removed, const char *text, size_t length);
+
+    const char *get_text() const;
+    size_t get_length() const;
+    const SessionWork &get_work() const {return m_work;}
+};
+
+/* CompileSession for programs that link the compiler in. Nothing is
+ * printed, each call returns what compile_shader would have for the
+ * source as it then stands. */
+class ShaderSession
+{
+  private:
+    QuietContext m_ctx;
+    std::string m_program;
+    CompileSession m_session;
+
+    CompileResult result(int failed);
+
+  public:
+    ShaderSession();
+
+    CompileResult compile(const char *text, size_t length) {return result(m_session.compile(text, length));}
+    CompileResult edit(size_t offset, size_t removed, const char *text, size_t length) {
+        return result(m_session.edit(offset, removed, text, length));
+    }
+};
+
+#endif /* SESSION_H_ */
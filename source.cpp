@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+
+/* flex needs the text to end in two NULs */
+#define SOURCE_PADDING 2
+
+void SourceBuffer::release()
+{
+    if (m_mapped_length)
+        munmap(m_data, m_mapped_length);
+    else
+        free(m_data);
+    for (char *block : m_retired)
+        free(block);
+    m_retired.clear();
+    m_data = nullptr;
+    m_length = 0;
+    m_mapped_length = 0;
+    m_capacity = 0;
+}
+
+bool SourceBuffer::load_file(FILE *file)
+{
+    release();
+
+    /* Map a regular file read from its start, as long as the padding fits
+     * in the zero filled tail of its last page */
+    struct stat st;
+    int fd = fileno(file);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        ftell(file) == 0) {
+        size_t length = st.st_size;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        if (length % page != 0 && page - length % page >= SOURCE_PADDING) {
+            void *map = mmap(NULL, length + SOURCE_PADDING, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                m_data = (char *)map;
+                m_length = length;
+                m_mapped_length = length + SOURCE_PADDING;
+                return true;
+            }
+        }
+    }
+
+    /* Otherwise read it, in one go when the size is known */
+    size_t capacity = (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+                          ? (size_t)st.st_size + SOURCE_PADDING : BUFSIZ;
+    m_data = (char *)malloc(capacity);
+    if (m_data == nullptr)
+        return false;
+    for (;;) {
+        if (m_length + SOURCE_PADDING == capacity) {
+            /* Full: grow only if there is more to come */
+            int c = fgetc(file);
+            if (c == EOF)
+                break;
+            ungetc(c, file);
+            capacity *= 2;
+            char *grown = (char *)realloc(m_data, capacity);
+            if (grown == nullptr) {
+                release();
+                return false;
+            }
+            m_data = grown;
+        }
+        size_t n = fread(m_data + m_length, 1, capacity - m_length - SOURCE_PADDING, file);
+        m_length += n;
+        if (n == 0 || feof(file) || ferror(file))
+            break;
+    }
+    memset(m_data + m_length, 0, SOURCE_PADDING);
+    m_capacity = capacity;
+    return !ferror(file);
+}
+
+bool SourceBuffer::load_text(const char *text, size_t length)
+{
+    release();
+    m_data = (char *)malloc(length + SOURCE_PADDING);
+    if (m_data == nullptr)
+        return false;
+    memcpy(m_data, text, length);
+    memset(m_data + length, 0, SOURCE_PADDING);
+    m_length = length;
+    m_capacity = length + SOURCE_PADDING;
+    return true;
+}
+
+bool SourceBuffer::append(const char *text, size_t length)
+{
+    if (m_mapped_length)
+        return false;
+    size_t needed = m_length + length + SOURCE_PADDING;
+    if (needed > m_capacity) {
+        /* Move to a block twice the size, never realloc: the text read
+         * so far is still referenced from the old one */
+        size_t capacity = m_capacity ? m_capacity : BUFSIZ;
+        while (capacity < needed)
+            capacity *= 2;
+        char *grown = (char *)malloc(capacity);
+        if (grown == nullptr)
+            return false;
+        if (m_data) {
+            memcpy(grown, m_data, m_length);
+            m_retired.push_back(m_data);
+        }
+        m_data = grown;
+        m_capacity = capacity;
+    }
+    if (length)
+        memcpy(m_data + m_length, text, length);
+    m_length += length;
+    memset(m_data + m_length, 0, SOURCE_PADDING);
+    return true;
+}
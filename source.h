@@ -0,0 +1,54 @@
+/***********************************************************************
+ * source.h
+ *
+ * The text of the program being compiled, read once and shared by the
+ * scanner, the source dump and diagnostics. Regular files are memory
+ * mapped; anything else is read into one buffer. Either way the text is
+ * followed by two NUL bytes so flex can scan it in place with
+ * yy_scan_buffer, which also means the buffer is writable (a private
+ * mapping is copied on write, never written back to the file).
+ *
+ * A source that arrives in pieces is appended to the buffer as it comes.
+ * Tokens point into the text, so when the buffer has to grow the old
+ * block is kept until the buffer is released.
+ **********************************************************************/
+
+#ifndef SOURCE_H_
+#define SOURCE_H_ 1
+
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+
+class SourceBuffer
+{
+  private:
+    char  *m_data = nullptr;
+    size_t m_length = 0;
+    size_t m_mapped_length = 0;   /* Non zero when m_data is a mapping */
+    size_t m_capacity = 0;        /* Bytes allocated at m_data when it is not */
+    std::vector<char *> m_retired;    /* Blocks m_data has moved out of */
+
+    void release();
+
+  public:
+    SourceBuffer() {}
+    ~SourceBuffer() {release();}
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+    /* Load the rest of file. Returns false if it could not be read. */
+    bool load_file(FILE *file);
+
+    /* Load a copy of length bytes of text */
+    bool load_text(const char *text, size_t length);
+
+    /* Add a copy of length bytes of text at the end. Returns false if
+     * it does not fit in memory, or the buffer is a mapped file. */
+    bool append(const char *text, size_t length);
+
+    char  *get_data() const {return m_data;}
+    size_t get_length() const {return m_length;}
+};
+
+#endif /* SOURCE_H_ */
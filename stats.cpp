@@ -0,0 +1,20 @@
+#include "stats.h"
+
+static const char *phase_names[PHASE_COUNT] = {
+    "scan", "parse", "predefined", "symbol", "typecheck", "flatten", "codegen", "free"
+};
+
+void CompileStats::print(FILE *trace_file) const
+{
+    double total_wall = 0, total_cpu = 0;
+
+    fprintf(trace_file, "TIMING %-12s %10s %10s\n", "phase", "wall ms", "cpu ms");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(trace_file, "TIMING %-12s %10.3f %10.3f\n", phase_names[phase], wall_ms[phase], cpu_ms[phase]);
+        total_wall += wall_ms[phase];
+        total_cpu  += cpu_ms[phase];
+    }
+    fprintf(trace_file, "TIMING %-12s %10.3f %10.3f\n", "total", total_wall, total_cpu);
+    fprintf(trace_file, "COUNTS %ld tokens, %ld nodes, %ld instructions\n", tokens, nodes, instructions);
+    fprintf(trace_file, "ARENA  %ld bytes in %ld chunks\n", arena_bytes, arena_chunks);
+}
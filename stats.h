@@ -0,0 +1,76 @@
+/***********************************************************************
+ * stats.h
+ *
+ * Per-phase timing and counters of one compile, reported by -Tt. Phases
+ * are timed with a PhaseTimer around the phase's work; when the context
+ * has no CompileStats the timer does nothing.
+ **********************************************************************/
+
+#ifndef STATS_H_
+#define STATS_H_ 1
+
+#include <stdio.h>
+#include <time.h>
+
+enum CompilePhase
+{
+    PHASE_SCAN,
+    PHASE_PARSE,
+    PHASE_PREDEFINED,
+    PHASE_SYMBOL,
+    PHASE_TYPECHECK,
+    PHASE_FLATTEN,
+    PHASE_CODEGEN,
+    PHASE_FREE,
+    PHASE_COUNT
+};
+
+class CompileStats
+{
+  public:
+    double wall_ms[PHASE_COUNT] = {0};
+    double cpu_ms[PHASE_COUNT]  = {0};
+
+    long tokens       = 0;
+    long nodes        = 0;
+    long instructions = 0;
+
+    /* What the AST took of its arena */
+    long arena_bytes  = 0;
+    long arena_chunks = 0;
+
+    /* Write the report, one line per phase then the counters */
+    void print(FILE *trace_file) const;
+};
+
+class PhaseTimer
+{
+  private:
+    CompileStats *m_stats;
+    CompilePhase m_phase;
+    struct timespec m_wall_start;
+    struct timespec m_cpu_start;
+
+  public:
+    PhaseTimer(CompileStats *stats, CompilePhase phase) : m_stats(stats), m_phase(phase) {
+        if (m_stats) {
+            clock_gettime(CLOCK_MONOTONIC, &m_wall_start);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &m_cpu_start);
+        }
+    }
+    ~PhaseTimer() {
+        if (m_stats) {
+            struct timespec wall_end, cpu_end;
+            clock_gettime(CLOCK_MONOTONIC, &wall_end);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+            m_stats->wall_ms[m_phase] += elapsed_ms(m_wall_start, wall_end);
+            m_stats->cpu_ms[m_phase]  += elapsed_ms(m_cpu_start, cpu_end);
+        }
+    }
+
+    static double elapsed_ms(const struct timespec &start, const struct timespec &end) {
+        return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    }
+};
+
+#endif /* STATS_H_ */
@@ -9,7 +9,8 @@
 
 class SymbolTablex {
     private:
-        std::forward_list<std::unordered_map<std::string, Declaration*>> symbol_table;
+        /* Keyed by the interned ids of the declared names */
+        std::forward_list<std::unordered_map<SymbolId, Declaration*>> symbol_table;
 
     public:
         Declaration* create_symbol(Declaration* decl){
@@ -18,11 +19,10 @@ class SymbolTablex {
             //     return true;
             // }
             auto &current_map = symbol_table.front();
-            if (current_map.count(decl->id) > 0){
-                return current_map.find(decl->id)->second;
+            auto inserted = current_map.emplace(decl->symbol, decl);
+            if (!inserted.second){
+                return inserted.first->second;
             }
-
-            current_map.emplace(decl->id, decl);
             return NULL;
         }
 
@@ -33,7 +33,7 @@ class SymbolTablex {
             symbol_table.pop_front();
         }
 
-        Declaration *find_symbol(const std::string &id){
+        Declaration *find_symbol(SymbolId id){
             for (const auto &current_map : symbol_table){
                 auto fit = current_map.find(id);
                 if (fit != current_map.end())
@@ -0,0 +1,57 @@
+#include <thread>
+#include "threadpool.h"
+
+WorkStealingPool::WorkStealingPool(int worker_count)
+    : m_worker_count(worker_count > 0 ? worker_count : 1), m_queues(m_worker_count)
+{
+}
+
+bool WorkStealingPool::pop_own_job(int worker, int *job_index)
+{
+    WorkQueue &queue = m_queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.jobs.empty())
+        return false;
+    *job_index = queue.jobs.front();
+    queue.jobs.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal_job(int thief, int *job_index)
+{
+    /* Visit the other workers starting after the thief, so thieves spread out */
+    for (int i = 1; i < m_worker_count; i++) {
+        WorkQueue &victim = m_queues[(thief + i) % m_worker_count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.jobs.empty())
+            continue;
+        *job_index = victim.jobs.back(); /* Take from the opposite end to the owner */
+        victim.jobs.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::work(int worker, const Job &job)
+{
+    int job_index;
+    /* No jobs are added while running, so once both our queue and every
+     * victim are empty there is nothing left for this worker */
+    while (pop_own_job(worker, &job_index) || steal_job(worker, &job_index))
+        job(job_index);
+}
+
+void WorkStealingPool::run(int job_count, const Job &job)
+{
+    /* Deal the jobs out round robin, so all workers start on the earliest
+     * jobs and in-order consumers of the results see progress early */
+    for (int i = 0; i < job_count; i++)
+        m_queues[i % m_worker_count].jobs.push_back(i);
+
+    std::vector<std::thread> threads;
+    for (int worker = 1; worker < m_worker_count; worker++)
+        threads.emplace_back(&WorkStealingPool::work, this, worker, std::cref(job));
+    work(0, job);
+    for (std::thread &thread : threads)
+        thread.join();
+}
@@ -0,0 +1,48 @@
+/***********************************************************************
+ * threadpool.h
+ *
+ * A small work-stealing pool used to compile the sources of a batch in
+ * parallel. Every worker owns a deque of job indices: it takes work from
+ * the front of its own deque and, once that is empty, steals from the
+ * back of another worker's deque. Jobs of very different sizes are thus
+ * balanced without any up-front partitioning.
+ **********************************************************************/
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_ 1
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class WorkStealingPool
+{
+  public:
+    typedef std::function<void(int)> Job;
+
+  private:
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<int> jobs;
+    };
+
+    int m_worker_count;
+    std::vector<WorkQueue> m_queues;
+
+    bool pop_own_job(int worker, int *job_index);
+    bool steal_job(int thief, int *job_index);
+    void work(int worker, const Job &job);
+
+  public:
+    explicit WorkStealingPool(int worker_count);
+
+    int get_worker_count() const {return m_worker_count;}
+
+    /* Runs job(0) .. job(job_count - 1) on the workers, the calling thread
+     * being worker 0. Returns once every job has finished. */
+    void run(int job_count, const Job &job);
+};
+
+#endif /* THREADPOOL_H_ */
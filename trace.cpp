@@ -0,0 +1,60 @@
+#include <atomic>
+#include "trace.h"
+
+void TraceLog::add_event(const char *name, const char *category, double start_us, double end_us,
+                         const std::string &args)
+{
+    Event event = {name, category, start_us, end_us - start_us, thread_id(), args};
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_events.push_back(event);
+}
+
+void TraceLog::write(FILE *trace_file)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    int threads = 1;
+    for (const Event &event : m_events)
+        if (event.thread >= threads)
+            threads = event.thread + 1;
+
+    fprintf(trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(trace_file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"compiler467\"}}");
+    for (int thread = 0; thread < threads; thread++)
+        fprintf(trace_file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s %d\"}}",
+                thread, thread == 0 ? "main" : "worker", thread);
+    for (const Event &event : m_events)
+        fprintf(trace_file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                "\"pid\": 1, \"tid\": %d, \"args\": {%s}}",
+                event.name, event.category, event.start_us, event.duration_us, event.thread,
+                event.args.c_str());
+    fprintf(trace_file, "\n]}\n");
+}
+
+int TraceLog::thread_id()
+{
+    static std::atomic<int> next_id(0);
+    thread_local int id = next_id++;
+    return id;
+}
+
+std::string TraceLog::quote(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':  quoted += "\\\""; break;
+            case '\\': quoted += "\\\\"; break;
+            case '\n': quoted += "\\n"; break;
+            case '\t': quoted += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    quoted += escape;
+                } else
+                    quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
@@ -0,0 +1,80 @@
+/***********************************************************************
+ * trace.h
+ *
+ * Timeline of a compiler run in the Chrome trace-event format, loadable
+ * in chrome://tracing or Perfetto. Work is recorded as complete ("X")
+ * events by TraceSpan objects held in scope; spans that run inside one
+ * another on a thread show up nested. With no TraceLog a span does
+ * nothing but test a pointer, so tracing costs nothing when disabled.
+ **********************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_ 1
+
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TraceLog
+{
+  private:
+    struct Event
+    {
+        const char *name;
+        const char *category;
+        double start_us;
+        double duration_us;
+        int thread;
+        std::string args;   /* JSON object body, may be empty */
+    };
+
+    std::chrono::steady_clock::time_point m_origin;
+    std::mutex m_lock;
+    std::vector<Event> m_events;
+
+  public:
+    /* Create the log on the main thread, which then gets thread id 0 */
+    TraceLog() : m_origin(std::chrono::steady_clock::now()) {thread_id();}
+
+    double now_us() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_origin).count();
+    }
+
+    void add_event(const char *name, const char *category, double start_us, double end_us,
+                   const std::string &args);
+
+    /* Writes {"traceEvents": [...]} */
+    void write(FILE *trace_file);
+
+    /* Small, stable id of the calling thread */
+    static int thread_id();
+
+    /* A JSON string literal holding text */
+    static std::string quote(const std::string &text);
+};
+
+class TraceSpan
+{
+  private:
+    TraceLog *m_log;
+    const char *m_name;
+    const char *m_category;
+    double m_start_us = 0;
+
+  public:
+    std::string args;   /* Optional JSON object body, e.g. "\"file\": \"a.frag\"" */
+
+    TraceSpan(TraceLog *log, const char *name, const char *category) :
+        m_log(log), m_name(name), m_category(category) {
+        if (m_log)
+            m_start_us = m_log->now_us();
+    }
+    ~TraceSpan() {
+        if (m_log)
+            m_log->add_event(m_name, m_category, m_start_us, m_log->now_us(), args);
+    }
+};
+
+#endif /* TRACE_H_ */
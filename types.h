@@ -0,0 +1,57 @@
+/***********************************************************************
+ * types.h
+ *
+ * The types of MiniGLSL as the compiler carries them: a base type and a
+ * dimension, 1 for scalars, in two bytes. The parsers make them from the
+ * base and dimension of a type token, the semantic checks compare them
+ * and take them apart, and code generation reads constructor types off
+ * them, so no pass compares or copies type names. A name is only made
+ * for a message or a dump.
+ **********************************************************************/
+
+#ifndef TYPES_H_
+#define TYPES_H_ 1
+
+#include <stdint.h>
+#include <string>
+
+class TypeDesc
+{
+  public:
+    /* In the order the parsers number base types in, ANY_BASE last; the
+     * names of the tokens are taken */
+    enum Base : uint8_t
+    {
+        INT_BASE,
+        BOOL_BASE,
+        FLOAT_BASE,
+        ANY_BASE,    /* ANY_TYPE, what an expression with an error reported has */
+    };
+
+  private:
+    Base m_base;
+    uint8_t m_dimension;    /* 1 to 4, 1 for ANY */
+
+  public:
+    constexpr TypeDesc() : m_base(ANY_BASE), m_dimension(1) {}
+    constexpr TypeDesc(Base base, int dimension) : m_base(base), m_dimension((uint8_t)dimension) {}
+
+    Base get_base() const {return m_base;}
+    int get_dimension() const {return m_dimension;}
+    bool is_any() const {return m_base == ANY_BASE;}
+
+    /* The type of an element of a vector, a scalar's own type */
+    TypeDesc get_element_type() const {return TypeDesc(m_base, 1);}
+
+    /* "ivec3" or "ANY_TYPE", as messages and dumps spell it */
+    const std::string &get_name() const {
+        static const std::string names[] = {"int", "ivec2", "ivec3", "ivec4", "bool", "bvec2", "bvec3", "bvec4",
+                                            "float", "vec2", "vec3", "vec4", "ANY_TYPE"};
+        return names[m_base * 4 + m_dimension - 1];
+    }
+
+    bool operator==(TypeDesc other) const {return m_base == other.m_base && m_dimension == other.m_dimension;}
+    bool operator!=(TypeDesc other) const {return !(*this == other);}
+};
+
+#endif /* TYPES_H_ */